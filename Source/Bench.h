@@ -0,0 +1,141 @@
+/* Bench.h
+ * Small helpers shared by the benchmarks in ShazamBench.cpp: a stopwatch,
+ * latency percentiles and command line parsing.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <vector>
+#include <string>
+#include <sstream>
+#include <algorithm>
+#include <cstdlib>
+#include <cstdio>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+class Stopwatch
+{
+private:
+	chrono::steady_clock::time_point start;
+
+public:
+	Stopwatch(){ reset(); }
+
+	void reset(){ start = chrono::steady_clock::now(); }
+
+	/* Microseconds since the last reset() */
+	double elapsedUs()
+	{
+		return chrono::duration<double, micro>( chrono::steady_clock::now() - start ).count();
+	}
+
+	double elapsedMs(){ return elapsedUs() / 1000.0; }
+};
+
+/* Summary of a set of latency samples (all in microseconds) */
+class LatencyStats
+{
+public:
+	double mean, p50, p95, p99, max, total;
+	size_t count;
+
+	LatencyStats(){ mean = p50 = p95 = p99 = max = total = 0; count = 0; }
+
+	/* Sorts samples in place */
+	LatencyStats( vector<double>& samples )
+	{
+		mean = p50 = p95 = p99 = max = total = 0;
+		count = samples.size();
+		if( samples.empty() )
+			return;
+
+		sort( samples.begin(), samples.end() );
+		for( size_t i = 0; i < samples.size(); i++ )
+			total += samples[i];
+
+		mean = total / count;
+		p50 = percentile( samples, 0.50 );
+		p95 = percentile( samples, 0.95 );
+		p99 = percentile( samples, 0.99 );
+		max = samples.back();
+	}
+
+	/* Nearest rank percentile of already sorted samples, p in [0,1] */
+	static double percentile( const vector<double>& sorted, double p )
+	{
+		size_t rank = (size_t)( p * sorted.size() + 0.5 );
+		if( rank < 1 )
+			rank = 1;
+		if( rank > sorted.size() )
+			rank = sorted.size();
+		return sorted[rank - 1];
+	}
+};
+
+/* Looks for "--name value" in argv, returns def if it is missing */
+string argValue( int argc, char **argv, const string& name, const string& def )
+{
+	for( int i = 1; i + 1 < argc; i++ )
+		if( name == argv[i] )
+			return argv[i + 1];
+	return def;
+}
+
+int argInt( int argc, char **argv, const string& name, int def )
+{
+	string v = argValue( argc, argv, name, "" );
+	return v.empty() ? def : atoi( v.c_str() );
+}
+
+bool argFlag( int argc, char **argv, const string& name )
+{
+	for( int i = 1; i < argc; i++ )
+		if( name == argv[i] )
+			return true;
+	return false;
+}
+
+/* Splits "100,200,400" into {100, 200, 400} */
+vector<int> argIntList( int argc, char **argv, const string& name, const string& def )
+{
+	vector<int> list;
+	stringstream ss( argValue( argc, argv, name, def ) );
+	string item;
+	while( getline( ss, item, ',' ) )
+		if( !item.empty() )
+			list.push_back( atoi( item.c_str() ) );
+	return list;
+}
+
+/* Makes sure a data directory ends with a path separator */
+string dataDirArg( int argc, char **argv )
+{
+	string dir = argValue( argc, argv, "--data", "" );
+	if( !dir.empty() && dir[dir.size() - 1] != '/' && dir[dir.size() - 1] != '\\' )
+		dir += '/';
+	return dir;
+}
+
+/* Asks the OS to forget its cached copy of a file so the next read is cold.
+   Only does something on POSIX systems, returns false if it couldn't. */
+bool dropFileCache( const string& path )
+{
+#if !defined(_WIN32) && defined(POSIX_FADV_DONTNEED)
+	int fd = open( path.c_str(), O_RDONLY );
+	if( fd < 0 )
+		return false;
+	fdatasync( fd );
+	bool ok = posix_fadvise( fd, 0, 0, POSIX_FADV_DONTNEED ) == 0;
+	close( fd );
+	return ok;
+#else
+	return false;
+#endif
+}
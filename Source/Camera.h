@@ -18,18 +18,17 @@
    - Added accel*() functions that add a more spaceship kind of feel to the camera
    - Modification: Made it so yaw/pitch/roll & move do NOT update the modelviewmatrix...
      this must be done by calling the update() method
+   
+   The camera itself no longer talks to OpenGL; see applyView() and
+   applyProjection() in Renderer.h for loading it into the GL matrices.
    _____________________________________________________________________________
 */
 
-#include <windows.h>  
-#include <gl/Gl.h>
-#include <gl/Glu.h>
-#include "glut.h"
 #include <cmath>
 #include <iostream>
 using namespace std;
 
-#include "Vector3.h" // definitions for Point3 and Vector3
+#include "VecMath.h" // definitions for Vec3
 
 #ifndef CAMERA
 #define CAMERA
@@ -42,16 +41,16 @@ using namespace std;
 	public:
 		Camera(){ setDefault(); }
 
-		Camera(Point3 position,    // position position
-				Point3 look,  // the "look at" point
-				Vector3 up,  // the up direction
+		Camera(Vec3 position,    // position position
+				Vec3 look,  // the "look at" point
+				Vec3 up,  // the up direction
 				float vAng,                  // viewing angle
 				float asp,                // aspect ratio
 				float nearD,                  // near plane distance
 				float farD);                 // far plane distance
 		// Constructs a camera object with default view volume settings.
 
-		void set(Point3 position, Point3 look, Vector3 up); 
+		void set(Vec3 position, Vec3 look, Vec3 up); 
 		// Repositions and aims this camera using the new position position, the
 		// look vector, and the up vector.
 
@@ -79,14 +78,19 @@ using namespace std;
 		// y, and z coordinates of the position repectively. The camera orientation
 		// is not changed.
 
-		void moveTo(Point3 pt);
+		void moveTo(Vec3 pt);
 		// Repositions the camera to the point pt (in world coordinates)
 		// without changing its uvn orientation.
 
-		Point3 getPosition();
+		void setBetween(Camera& from, Camera& to, float t);
+		// Places and aims this camera t of the way (0 to 1) from one camera
+		// to another, for drawing between two simulation ticks. The shape
+		// and velocities are left alone.
+
+		Vec3 getPosition();
 		// Returns the current position position.
 
-		Vector3 getLookDirection();
+		Vec3 getLookDirection();
 		// Returns a unit vector in the direction the camera's heading (aim).
 
 
@@ -117,33 +121,34 @@ using namespace std;
 		/* Sets the camera to the default position/look/up */
 		void setDefault();
 
-		void setLookAt(Point3 look);
-
-		void applyShape();
+		void setLookAt(Vec3 look);
 
 		/* Modify just the near plane */
 		void setNearPlane( double nn ){ nearDist = nn; };
 
-		Vector3 getUpVector();
+		Vec3 getUpVector();
 
 		float getAcceleration(){ return acceleration; }
 
 		float getVelocity(){ return velocity; }
 
-		Vector3 getLookVelocity(){ return lookVelocity; }
+		Vec3 getLookVelocity(){ return lookVelocity; }
+
+		void getModelViewMatrix(float m[16]);
+		// Fills m (column-major, as OpenGL expects) with the view matrix for
+		// the camera's current position and uvn orientation.
 
-		Point3  position;
+		Vec3  position;
 	private:
-		Vector3 u, v, n;
+		Vec3 u, v, n;
 
 		float acceleration, velocity; /* movement vel and accel */
-		Vector3 lookAccel; /* roll, pitch, yaw accel */
-		Vector3 lookVelocity;
+		Vec3 lookAccel; /* roll, pitch, yaw accel */
+		Vec3 lookVelocity;
 
 		double  viewAngle, aspect, nearDist, farDist; // view volume shape
 
-		void setModelViewMatrix(); 
-		// Loads the modelview matrix with camera settings.
+		void orthonormalize();
 	};
 
 //______________________________________________________________________________
@@ -151,21 +156,17 @@ using namespace std;
 //                             Camera Implementation
 //______________________________________________________________________________
 
-	void Camera::setModelViewMatrix()
+	void Camera::getModelViewMatrix(float m[16])
 	{ 
-		float m[16];
-		Vector3 eVec(position.x, position.y, position.z); // a vector version of position 
-		m[0] =  u.x; m[4] =  u.y; m[8]  =  u.z;  m[12] = -eVec.dot(u);
-		m[1] =  v.x; m[5] =  v.y; m[9]  =  v.z;  m[13] = -eVec.dot(v);
-		m[2] =  n.x; m[6] =  n.y; m[10] =  n.z;  m[14] = -eVec.dot(n);
+		m[0] =  u.x; m[4] =  u.y; m[8]  =  u.z;  m[12] = -position.dot(u);
+		m[1] =  v.x; m[5] =  v.y; m[9]  =  v.z;  m[13] = -position.dot(v);
+		m[2] =  n.x; m[6] =  n.y; m[10] =  n.z;  m[14] = -position.dot(n);
 		m[3] =  0;   m[7] =  0;   m[11] =  0;    m[15] = 1.0;
-		glMatrixMode(GL_MODELVIEW);
-		glLoadMatrixf(m); // load OpenGLs modelview matrix
 	}
 
 //..............................................................................
 
-Camera::Camera(Point3 position, Point3 look, Vector3 up,
+Camera::Camera(Vec3 position, Vec3 look, Vec3 up,
 				float vAng, float asp, float nearD, float farD)
 {
 	set(position, look, up);
@@ -174,17 +175,16 @@ Camera::Camera(Point3 position, Point3 look, Vector3 up,
 
 //..............................................................................
 
-void Camera::set(Point3 position, Point3 look, Vector3 up)
+void Camera::set(Vec3 position, Vec3 look, Vec3 up)
 {	
 	this->position.set(position); // store the given position position
 	n.set(position.x - look.x, position.y - look.y, position.z - look.z); // make n
 	u.set(up.cross(n)); // make u = up X n
 	n.normalize(); u.normalize(); // make n and u unit length
 	v.set(n.cross(u));  // make v =  n X u
-	setModelViewMatrix(); // tell OpenGL 
 }
 
-void Camera::setLookAt( Point3 lookAt )
+void Camera::setLookAt( Vec3 lookAt )
 {
 	set( position, lookAt, v );
 }
@@ -193,22 +193,12 @@ void Camera::setLookAt( Point3 lookAt )
 
 void Camera::setShape(float vAng, float asp, float nearD, float farD)
 {
-	glMatrixMode(GL_PROJECTION);
-	glLoadIdentity();
-	gluPerspective(vAng, asp, nearD, farD);
 	viewAngle = vAng;
 	aspect = asp;
 	nearDist = nearD;
 	farDist = farD;
 }
 
-void Camera::applyShape()
-{
-	glMatrixMode(GL_PROJECTION);
-	glLoadIdentity();
-	gluPerspective( viewAngle, aspect, nearDist, farDist );
-}
-
 //..............................................................................
 
 void Camera::getShape(float& vAng, float& asp, float& nearD, float& farD)
@@ -223,9 +213,9 @@ void Camera::getShape(float& vAng, float& asp, float& nearD, float& farD)
 
 void Camera::roll(float angle)
 {
-	float cs = cos(PI/180 * angle);
-	float sn = sin(PI/180 * angle);
-	Vector3 t = u; // save old u
+	float cs = cosf((float)RADIANS_PER_DEGREE * angle);
+	float sn = sinf((float)RADIANS_PER_DEGREE * angle);
+	Vec3 t = u; // save old u
 	u.set(cs*t.x + sn*v.x, cs*t.y + sn*v.y, cs*t.z + sn*v.z);
 	v.set(-sn*t.x + cs*v.x, -sn*t.y + cs*v.y, -sn*t.z + cs*v.z);
 	//setModelViewMatrix(); /* Removed nov 26 2008 by Phil */
@@ -235,9 +225,9 @@ void Camera::roll(float angle)
 
 void Camera::pitch(float angle)
 {
-	float cs = cos(PI/180 * angle);
-	float sn = sin(PI/180 * angle);
-	Vector3 t = n; // save old n
+	float cs = cosf((float)RADIANS_PER_DEGREE * angle);
+	float sn = sinf((float)RADIANS_PER_DEGREE * angle);
+	Vec3 t = n; // save old n
 	n.set(cs*t.x - sn*v.x, cs*t.y - sn*v.y, cs*t.z - sn*v.z);
 	v.set(sn*t.x + cs*v.x, sn*t.y + cs*v.y, sn*t.z + cs*v.z);
 	//setModelViewMatrix(); /* Removed nov 26 2008 by Phil */
@@ -247,9 +237,9 @@ void Camera::pitch(float angle)
 
 void Camera::yaw(float angle)
 {
-	float cs = cos(PI/180 * angle);
-	float sn = sin(PI/180 * angle);
-	Vector3 t = u; // save old u
+	float cs = cosf((float)RADIANS_PER_DEGREE * angle);
+	float sn = sinf((float)RADIANS_PER_DEGREE * angle);
+	Vec3 t = u; // save old u
 	u.set(cs*t.x - sn*n.x, cs*t.y - sn*n.y, cs*t.z - sn*n.z);
 	n.set(sn*t.x + cs*n.x, sn*t.y + cs*n.y, sn*t.z + cs*n.z);
 	//setModelViewMatrix(); /* Removed nov 26 2008 by Phil */
@@ -267,22 +257,21 @@ void Camera::move(float delU, float delV, float delN)
 
 //..............................................................................
 
-void Camera::moveTo(Point3 pt)
+void Camera::moveTo(Vec3 pt)
 {
 	position = pt;
-	setModelViewMatrix();
 }
 
 //..............................................................................
 
-Point3 Camera::getPosition()
+Vec3 Camera::getPosition()
 {
 	return position;
 }
 
 //..............................................................................
 
-Vector3 Camera::getLookDirection()
+Vec3 Camera::getLookDirection()
 {
 	return -n;
 }
@@ -297,16 +286,41 @@ void Camera::update()
 	roll( lookVelocity.x );
 	pitch( lookVelocity.y );
 	yaw( lookVelocity.z );
+	orthonormalize();
+}
 
-	//setShape( viewAngle, aspect,  nearDist, farDist );
-	setModelViewMatrix();
+void Camera::setBetween(Camera& from, Camera& to, float t)
+{
+	position = from.position + (to.position - from.position) * t;
+
+	/* Blend the aim and up, then square them up again. A turn too sharp to
+	   blend (the aim flipping round in one tick) just takes the later one. */
+	Vec3 blendN = from.n + (to.n - from.n) * t;
+	Vec3 blendV = from.v + (to.v - from.v) * t;
+	if( blendN.lengthSq() < 1e-6f || blendV.lengthSq() < 1e-6f )
+	{
+		u = to.u; v = to.v; n = to.n;
+		return;
+	}
+	n = blendN;
+	v = blendV;
+	orthonormalize();
+}
+
+/* Rounding in roll/pitch/yaw slowly skews u, v and n; square them back up */
+void Camera::orthonormalize()
+{
+	n.normalize();
+	u = v.cross(n);
+	u.normalize();
+	v = n.cross(u);
 }
 
 void Camera::setDefault()
 {
-	Point3 position = Point3(0.0,0.0,1.0);    // position position
-	Point3 look = Point3(0.0,0.0,0.0);  // the "look at" point
-	Vector3 up = Vector3(0.0,1.0,0.0);  // the up direction
+	Vec3 position = Vec3(0.0,0.0,1.0);    // position position
+	Vec3 look = Vec3(0.0,0.0,0.0);  // the "look at" point
+	Vec3 up = Vec3(0.0,1.0,0.0);  // the up direction
 	float vAng = 30.0;                  // viewing angle
 	float asp = 4.0/3.0;                // aspect ratio
 	float nearD = 0.01;                  // near plane distance
@@ -319,8 +333,8 @@ void Camera::setDefault()
 	velocity = 0.0f;
 	acceleration = 0.0f;
 
-	lookVelocity = Vector3(0,0,0);
-	lookAccel = Vector3(0,0,0);
+	lookVelocity = Vec3(0,0,0);
+	lookAccel = Vec3(0,0,0);
 }
 
 void Camera::accelForward( float amt )
@@ -374,13 +388,13 @@ void Camera::accelYaw( float amt )
 
 void Camera::stopMoving()
 {
-	lookAccel = Vector3( 0,0,0 );
-	lookVelocity = Vector3( 0,0,0 );
+	lookAccel = Vec3( 0,0,0 );
+	lookVelocity = Vec3( 0,0,0 );
 	acceleration = 0;
 	velocity = 0;
 }
 
-Vector3 Camera::getUpVector()
+Vec3 Camera::getUpVector()
 {
 	return u;
 }
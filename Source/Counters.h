@@ -0,0 +1,266 @@
+/* Counters.h
+ * Per-frame counts of the work a frame did (collision pairs tested,
+ * objects drawn and culled, vertices sent to GL, heap allocations, ...),
+ * to graph over long sessions next to the profiler's timings. A subsystem
+ * declares a Counter with a name next to the code doing the work and bumps
+ * it there; every Counter is listed in the one registry, Counters::shared().
+ *
+ * endFrame() closes a frame: each count becomes the last frame's value and
+ * starts again from zero, and with a stream open the frame is written out
+ * as a CSV row or a JSON line. The game ends a frame after drawing it,
+ * ShazamBench after each tick. Gauges (fuel, entities left) hold their
+ * value from frame to frame rather than counting up.
+ *
+ * Counting is one relaxed atomic add, so jobs can count from any thread.
+ * Heap allocations and bytes are counted by replacing operator new, which
+ * building with SHAZAM_NO_ALLOC_COUNT leaves alone.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+using namespace std;
+
+#define MAX_COUNTERS 64
+
+enum CounterFormat { COUNTERS_CSV = 0, COUNTERS_JSON };
+
+/* Every allocation since the program started, see operator new below */
+atomic<long long> heapAllocations( 0 );
+atomic<long long> heapBytesAllocated( 0 );
+
+#ifndef SHAZAM_NO_ALLOC_COUNT
+void *operator new( size_t size )
+{
+	heapAllocations.fetch_add( 1, memory_order_relaxed );
+	heapBytesAllocated.fetch_add( (long long)size, memory_order_relaxed );
+	void *p = malloc( size ? size : 1 );
+	if( !p )
+		throw bad_alloc();
+	return p;
+}
+
+/* Kept out of line under GCC, which otherwise sees the free() of memory
+   from new at every inlined delete and warns of a mismatch */
+#ifdef __GNUC__
+__attribute__(( noinline ))
+#endif
+void operator delete( void *p ) throw()
+{
+	free( p );
+}
+#endif
+
+class Counters
+{
+private:
+	struct Slot
+	{
+		const char *name;
+		bool gauge;
+		atomic<long long> value; /* the frame so far */
+		long long last;          /* the last finished frame */
+	};
+
+	mutex lock;                  /* guards adding slots */
+	Slot slots[MAX_COUNTERS];
+	Slot spare;                  /* where counters past MAX_COUNTERS count */
+	atomic<int> numSlots;
+	long long frames;
+
+	int allocSlot, allocBytesSlot;
+	long long allocsSeen, allocBytesSeen;
+
+	FILE *stream;
+	CounterFormat format;
+	int columns;                 /* slots in the CSV header, -1 before it is written */
+
+	Counters( const Counters& );
+	Counters& operator=( const Counters& );
+
+	void writeFrame( int n )
+	{
+		if( format == COUNTERS_CSV )
+		{
+			if( columns < 0 )
+			{
+				columns = n;
+				fprintf( stream, "frame" );
+				for( int i = 0; i < columns; i++ )
+					fprintf( stream, ",%s", slots[i].name );
+				fprintf( stream, "\n" );
+			}
+			/* Counters added after the header have no column */
+			fprintf( stream, "%lld", frames );
+			for( int i = 0; i < columns; i++ )
+				fprintf( stream, ",%lld", slots[i].last );
+			fprintf( stream, "\n" );
+		}
+		else
+		{
+			fprintf( stream, "{\"frame\":%lld", frames );
+			for( int i = 0; i < n; i++ )
+				fprintf( stream, ",\"%s\":%lld", slots[i].name, slots[i].last );
+			fprintf( stream, "}\n" );
+		}
+	}
+
+public:
+	Counters() : numSlots( 0 )
+	{
+		frames = 0;
+		stream = NULL;
+		format = COUNTERS_CSV;
+		columns = -1;
+		spare.name = "spare";
+		spare.gauge = false;
+		spare.value = 0;
+		spare.last = 0;
+
+		allocSlot = allocBytesSlot = -1;
+		allocsSeen = allocBytesSeen = 0;
+#ifndef SHAZAM_NO_ALLOC_COUNT
+		allocSlot = add( "heap allocations", false );
+		allocBytesSlot = add( "heap bytes allocated", false );
+		allocsSeen = heapAllocations.load();
+		allocBytesSeen = heapBytesAllocated.load();
+#endif
+	}
+
+	~Counters(){ closeStream(); }
+
+	static Counters& shared()
+	{
+		static Counters counters;
+		return counters;
+	}
+
+	/* The slot counting under name, made if there is none yet. Names must
+	   be string literals (only the pointer is kept) and should not hold
+	   commas or quotes, they head CSV columns and name JSON fields. */
+	int add( const char *name, bool gauge )
+	{
+		lock_guard<mutex> guard( lock );
+		int n = numSlots.load();
+		for( int i = 0; i < n; i++ )
+			if( strcmp( slots[i].name, name ) == 0 )
+				return i;
+		if( n == MAX_COUNTERS )
+			return -1;
+		slots[n].name = name;
+		slots[n].gauge = gauge;
+		slots[n].value = 0;
+		slots[n].last = 0;
+		numSlots.store( n + 1, memory_order_release );
+		return n;
+	}
+
+	/* Where slot i's value is kept, the spare for -1 */
+	atomic<long long>& valueOf( int i ){ return i < 0 ? spare.value : slots[i].value; }
+
+	int size(){ return numSlots.load( memory_order_acquire ); }
+	const char *getName( int i ){ return slots[i].name; }
+
+	/* The last finished frame's value of slot i */
+	long long getLast( int i ){ return i < 0 ? 0 : slots[i].last; }
+
+	/* getLast() by name, 0 if nothing counts under it */
+	long long getLast( const char *name )
+	{
+		int n = size();
+		for( int i = 0; i < n; i++ )
+			if( strcmp( slots[i].name, name ) == 0 )
+				return slots[i].last;
+		return 0;
+	}
+
+	long long getFrames(){ return frames; }
+
+	/* Closes the frame: counts become last frame's values and start again
+	   from zero, and the frame goes to the stream if one is open. Call it
+	   from one thread, once nothing is counting into the frame. */
+	void endFrame()
+	{
+		long long allocs = heapAllocations.load( memory_order_relaxed );
+		long long bytes = heapBytesAllocated.load( memory_order_relaxed );
+		if( allocSlot >= 0 )
+		{
+			slots[allocSlot].value.fetch_add( allocs - allocsSeen, memory_order_relaxed );
+			slots[allocBytesSlot].value.fetch_add( bytes - allocBytesSeen, memory_order_relaxed );
+		}
+		allocsSeen = allocs;
+		allocBytesSeen = bytes;
+
+		int n = size();
+		for( int i = 0; i < n; i++ )
+			slots[i].last = slots[i].gauge ? slots[i].value.load( memory_order_relaxed )
+				: slots[i].value.exchange( 0, memory_order_relaxed );
+		spare.value = 0;
+		frames++;
+
+		if( stream )
+			writeFrame( n );
+	}
+
+	/* Writes every frame from now on to path, as CSV (a header row, then a
+	   row a frame) or as JSON lines (an object a frame). False if the file
+	   could not be opened. */
+	bool openStream( const string& path, CounterFormat f )
+	{
+		closeStream();
+		stream = fopen( path.c_str(), "w" );
+		format = f;
+		columns = -1;
+		return stream != NULL;
+	}
+
+	/* openStream() with the format picked from the extension, .json and
+	   .jsonl are JSON lines and anything else is CSV */
+	bool openStream( const string& path )
+	{
+		size_t dot = path.find_last_of( '.' );
+		string ext = dot == string::npos ? "" : path.substr( dot );
+		return openStream( path, ext == ".json" || ext == ".jsonl" ? COUNTERS_JSON : COUNTERS_CSV );
+	}
+
+	void closeStream()
+	{
+		if( stream )
+			fclose( stream );
+		stream = NULL;
+	}
+
+	bool isStreaming(){ return stream != NULL; }
+};
+
+/* A named count, declared where the work is done:
+     Counter countPairsTested( "collision pairs tested" );
+     ...
+     countPairsTested.add( candidates ); */
+class Counter
+{
+private:
+	int slot;
+	atomic<long long> *value;
+
+public:
+	/* A gauge keeps its value from frame to frame, set() it */
+	Counter( const char *name, bool gauge = false )
+	{
+		slot = Counters::shared().add( name, gauge );
+		value = &Counters::shared().valueOf( slot );
+	}
+
+	void add( long long n = 1 ){ value->fetch_add( n, memory_order_relaxed ); }
+	void set( long long v ){ value->store( v, memory_order_relaxed ); }
+
+	/* The last finished frame's value */
+	long long get(){ return Counters::shared().getLast( slot ); }
+};
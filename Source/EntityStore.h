@@ -0,0 +1,282 @@
+/* EntityStore.h
+ * The bad guys and power ups, kept column by column: one packed array per
+ * property, entity i being entry i of every column. Each system walks only
+ * the columns it needs (turning touches rotation and spin, culling position
+ * and radius, collision position and scale) instead of dragging a whole
+ * Object, Camera basis and all, through the cache for every entity.
+ *
+ * Entities are placed like Objects (see Placement). Removal is swap-and-pop,
+ * so the last entity takes the removed one's index. Indices are only good
+ * until the next add() or remove(); anything that holds on to an entity
+ * longer keeps an EntityHandle, which finds it wherever it has moved and
+ * reports it gone once it has been removed.
+ */
+
+#pragma once
+
+#include "Object.h"
+#include "SphereSet.h"
+
+#define NUM_SPINS	6 /* ways generate() picks from for an entity to turn, see EntityStore::spinFor() */
+
+/* A lasting reference to an entity: a slot that follows it through
+   swap-and-pop, and the generation the slot was on when it was handed out.
+   Removing the entity moves the slot on a generation, so old handles stop
+   matching even after the slot is reused. The default handle is never valid. */
+struct EntityHandle
+{
+	unsigned slot, generation;
+
+	EntityHandle() : slot( 0 ), generation( 0 ) {}
+	EntityHandle( unsigned s, unsigned g ) : slot( s ), generation( g ) {}
+
+	bool isNull() const { return generation == 0; }
+	bool operator==( const EntityHandle& h ) const { return slot == h.slot && generation == h.generation; }
+	bool operator!=( const EntityHandle& h ) const { return !(*this == h); }
+};
+
+class EntityStore
+{
+private:
+	vector<MeshHandle> meshes;      /* what the mesh column indexes */
+	int counts[NUM_OBJECT_TYPES];
+	bool hitBoxesVisible;
+
+	/* Handle slots: where each slot's entity is (-1 when free) and the slot's
+	   generation, odd while in use. Free slots are reused last in, first out. */
+	vector<int> slotIndex;
+	vector<unsigned> slotGeneration;
+	vector<unsigned> freeSlots;
+
+	/* A free slot (or a new one) pointed at index, moved on to an in-use generation */
+	unsigned takeSlot( int index )
+	{
+		unsigned s;
+		if( freeSlots.empty() )
+		{
+			s = (unsigned)slotIndex.size();
+			slotIndex.push_back( -1 );
+			slotGeneration.push_back( 0 );
+		}
+		else
+		{
+			s = freeSlots.back();
+			freeSlots.pop_back();
+		}
+		slotIndex[s] = index;
+		slotGeneration[s]++;
+		return s;
+	}
+
+	/* Where Object::getCenter() would be for meshId placed at pos */
+	Vec3 meshCenter( int meshId, const Vec3& pos )
+	{
+		VNCMesh *m = meshes[meshId].get();
+		return m ? pos + m->getCenter() : pos;
+	}
+
+	/* Moves s on to a free generation, which no handle has */
+	void freeSlot( unsigned s )
+	{
+		slotIndex[s] = -1;
+		slotGeneration[s]++;
+		freeSlots.push_back( s );
+	}
+
+	/* Moves entity i, its collision sphere with it. Private: Universe::move()
+	   calls it and moves the entity in the broad phase too. */
+	void setPosition( int i, const Vec3& pos )
+	{
+		position[i] = pos;
+		spheres.set( i, meshCenter( mesh[i], pos ), scale[i].x );
+		bounds.set( i, pos, radius[i] );
+	}
+
+	/* Resizes entity i, its bounding radius and collision sphere with it.
+	   Private for the same reason, see Universe::resize(). */
+	void setScale( int i, const Vec3& scl )
+	{
+		scale[i] = scl;
+		radius[i] = getPlacement( i ).getBoundingRadius( getMesh( i ) );
+		spheres.r[i] = scl.x;
+		bounds.r[i] = radius[i];
+	}
+
+	friend class Universe;
+
+public:
+	/* The columns, all size() long. Rotation, spin, mesh and type can be
+	   changed freely. Position and scale only change through Universe::move()
+	   and Universe::resize(), since radius, the sphere sets and the broad phase follow
+	   them, and entities are only added and removed through add() and remove(). */
+	vector<Vec3> position;
+	vector<Vec3> rotation;          /* degrees about x, then y, then z */
+	vector<Vec3> scale;
+	vector<float> radius;           /* Placement::getBoundingRadius(), follows scale */
+	vector<unsigned short> mesh;    /* index into the meshes added with addMesh() */
+	vector<unsigned char> type;     /* OBJECT_TYPE */
+	vector<Vec3> spin;              /* degrees it turns each tick about x, y and z */
+	vector<unsigned> slot;          /* the handle slot that points at it */
+	SphereSet spheres;              /* collision spheres, getCenter() and getCollisionRadius() */
+	SphereSet bounds;               /* position and radius, what the broad phase tests against */
+
+	EntityStore()
+	{
+		hitBoxesVisible = false;
+		clear();
+	}
+
+	/* Drops every entity (their handles go stale), the meshes stay */
+	void clear()
+	{
+		for( int i = 0; i < size(); i++ )
+			freeSlot( slot[i] );
+		position.clear(); rotation.clear(); scale.clear(); radius.clear();
+		mesh.clear(); type.clear(); spin.clear(); slot.clear(); spheres.clear(); bounds.clear();
+		for( int t = 0; t < NUM_OBJECT_TYPES; t++ )
+			counts[t] = 0;
+	}
+
+	void reserve( int n )
+	{
+		position.reserve( n ); rotation.reserve( n ); scale.reserve( n ); radius.reserve( n );
+		mesh.reserve( n ); type.reserve( n ); spin.reserve( n ); slot.reserve( n ); spheres.reserve( n ); bounds.reserve( n );
+	}
+
+	/* Id for the mesh column, the same id for the same mesh */
+	int addMesh( const MeshHandle& h )
+	{
+		for( size_t i = 0; i < meshes.size(); i++ )
+			if( meshes[i] == h )
+				return (int)i;
+		meshes.push_back( h );
+		return (int)meshes.size() - 1;
+	}
+
+	/* NULL while it is still loading */
+	VNCMesh *getMesh( int i ){ return meshes[mesh[i]].get(); }
+	const MeshHandle& getMeshHandle( int i ){ return meshes[mesh[i]]; }
+
+	/* Adds an entity and returns its index. The mesh should have loaded,
+	   the bounding radius is worked out here. */
+	int add( OBJECT_TYPE t, int meshId, const Vec3& pos, const Vec3& rot, const Vec3& scl, const Vec3& spinRate = Vec3() )
+	{
+		position.push_back( pos );
+		rotation.push_back( rot );
+		scale.push_back( scl );
+		mesh.push_back( (unsigned short)meshId );
+		type.push_back( (unsigned char)t );
+		spin.push_back( spinRate );
+		slot.push_back( takeSlot( size() - 1 ) );
+		spheres.add( meshCenter( meshId, pos ), scl.x );
+		radius.push_back( Placement( pos, rot, scl ).getBoundingRadius( meshes[meshId].get() ) );
+		bounds.add( pos, radius.back() );
+		counts[t]++;
+		return size() - 1;
+	}
+
+	/* Swap-and-pop: the last entity moves into i, i's handles go stale */
+	void remove( int i )
+	{
+		int last = size() - 1;
+		counts[type[i]]--;
+		freeSlot( slot[i] );
+		if( i != last )
+		{
+			position[i] = position[last]; rotation[i] = rotation[last]; scale[i] = scale[last];
+			radius[i] = radius[last]; mesh[i] = mesh[last]; type[i] = type[last]; spin[i] = spin[last];
+			slot[i] = slot[last];
+			slotIndex[slot[i]] = i;
+		}
+		position.pop_back(); rotation.pop_back(); scale.pop_back(); radius.pop_back();
+		mesh.pop_back(); type.pop_back(); spin.pop_back(); slot.pop_back();
+		spheres.remove( i );
+		bounds.remove( i );
+	}
+
+	/* A handle to entity i that stays good until it is removed */
+	EntityHandle getHandle( int i ){ return EntityHandle( slot[i], slotGeneration[slot[i]] ); }
+
+	/* Where h's entity is now, -1 if it has been removed */
+	int indexOf( EntityHandle h )
+	{
+		if( h.slot >= slotGeneration.size() || slotGeneration[h.slot] != h.generation )
+			return -1;
+		return slotIndex[h.slot];
+	}
+
+	bool isAlive( EntityHandle h ){ return indexOf( h ) >= 0; }
+
+	int size(){ return (int)position.size(); }
+	int count( OBJECT_TYPE t ){ return counts[t]; }
+
+	/* Lowest index of type t, -1 if there are none */
+	int first( OBJECT_TYPE t )
+	{
+		if( counts[t] == 0 )
+			return -1;
+		for( int i = 0; i < size(); i++ )
+			if( type[i] == t )
+				return i;
+		return -1;
+	}
+
+	Placement getPlacement( int i ){ return Placement( position[i], rotation[i], scale[i] ); }
+
+	/* Entity i's rotation alpha of the way (0 to 1) from the tick before the
+	   last one to the last one. The spin is the whole of a tick's turn, so
+	   this is the rotation with (1 - alpha) of it taken back off. */
+	Vec3 getRotationBetweenTicks( int i, float alpha ){ return rotation[i] + spin[i] * (alpha - 1.0f); }
+	Placement getPlacementBetweenTicks( int i, float alpha )
+	{
+		return Placement( position[i], getRotationBetweenTicks( i, alpha ), scale[i] );
+	}
+
+	/* What Object::getCenter() and getRadius() were: the collision sphere */
+	Vec3 getCenter( int i ){ return spheres.getCenter( i ); }
+	float getCollisionRadius( int i ){ return spheres.r[i]; }
+
+	bool touchesSphere( int i, Vec3 c, float r ){ return getPlacement( i ).touchesSphere( getMesh( i ), c, r ); }
+	bool raycast( int i, Vec3 origin, Vec3 dir, float maxT, float& t ){ return getPlacement( i ).raycast( getMesh( i ), origin, dir, maxT, t ); }
+	void getModelMatrix( int i, Mat4& out ){ getPlacement( i ).getModelMatrix( out ); }
+	void getModelMatrix( int i, float alpha, Mat4& out ){ getPlacementBetweenTicks( i, alpha ).getModelMatrix( out ); }
+	int selectLOD( int i, Vec3 eye, float pixelsAtUnit, float maxPixelError )
+	{
+		return getPlacement( i ).selectLOD( getMesh( i ), radius[i], eye, pixelsAtUnit, maxPixelError );
+	}
+
+	/* One of the NUM_SPINS ways the game's entities turn (a rate for the
+	   spin column). They used to be cases of a switch in Object. */
+	static Vec3 spinFor( int which )
+	{
+		static const Vec3 spins[NUM_SPINS] = {
+			Vec3( 2.0f, 0, 0 ), Vec3( 0, 1.0f, 0 ), Vec3( 0, 0, 1.5f ),
+			Vec3( 0.67f, 1.3f, 0 ), Vec3( 0.75f, 0, 1.1f ), Vec3( 0, 3.0f, 0 ) };
+		return spins[(unsigned)which % NUM_SPINS];
+	}
+
+	/* Turns every entity a tick's worth. The rotation and spin columns are
+	   each one run of floats (Vec3 has no padding), so this is one
+	   branch-free pass over them, kept within [0, 360). */
+	void updateRotations(){ updateRotations( 0, size() ); }
+
+	/* updateRotations() for entities [first, last) only, which runs on
+	   different ranges can do at the same time */
+	void updateRotations( int first, int last )
+	{
+		static_assert( sizeof(Vec3) == 3 * sizeof(float), "Vec3 columns are read as plain floats" );
+		if( first >= last )
+			return;
+		addWrapDegrees( &rotation[first].x, &spin[first].x, 3 * (last - first) );
+	}
+
+	void toggleHitBoxes(){ hitBoxesVisible = !hitBoxesVisible; }
+	bool getHitBoxesVisible(){ return hitBoxesVisible; }
+
+	/* Bytes of column and handle slot data each entity takes */
+	static int bytesPerEntity()
+	{
+		return (int)(4 * sizeof(Vec3) + sizeof(float) + sizeof(unsigned short) + sizeof(unsigned char)
+			+ 2 * sizeof(unsigned) + sizeof(int) + 2 * 4 * sizeof(float)); /* two sphere sets */
+	}
+};
@@ -14,6 +14,7 @@
  */
 
 #include "glut.h"
+#include "Counters.h"
 #include <string>
 
 using namespace std;
@@ -31,6 +32,8 @@ const void* HELVETICA_10 = GLUT_BITMAP_HELVETICA_10;
 const void* HELVETICA_12 = GLUT_BITMAP_HELVETICA_12;
 const void* HELVETICA_18 = GLUT_BITMAP_HELVETICA_18;
 
+Counter countCharsDrawn( "font characters drawn" );
+
 class Font
 {
 public:
@@ -49,6 +52,9 @@ public:
 	void draw(float x, float y, string str);
 	// Displays the string str at screen position (x,y).
 
+	void draw(float x, float y, const char *str);
+	// Displays the C string str at screen position (x,y), without copying it.
+
 private:
 	void* currentFont; // address of the current font
 };
@@ -63,6 +69,7 @@ void Font::draw(float x, float y, unsigned char ch)
 	//glutSetCursor(GLUT_CURSOR_NONE);
 	glRasterPos2f(x, y);
 	glutBitmapCharacter(currentFont, ch);
+	countCharsDrawn.add();
 	glFlush();
 	//glutSetCursor(GLUT_CURSOR_TEXT);
 }
@@ -73,8 +80,19 @@ void Font::draw(float x, float y, string str)
 	glRasterPos2f(x, y);
 	for (int k = 0; k < int(str.size()); k++)
 		glutBitmapCharacter(currentFont, str[k]);
+	countCharsDrawn.add(str.size());
 	glFlush();
 	//glutSetCursor(GLUT_CURSOR_TEXT);
 }
 
+void Font::draw(float x, float y, const char *str)
+{
+	glRasterPos2f(x, y);
+	int k = 0;
+	for (; str[k]; k++)
+		glutBitmapCharacter(currentFont, str[k]);
+	countCharsDrawn.add(k);
+	glFlush();
+}
+
 #endif
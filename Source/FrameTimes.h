@@ -0,0 +1,66 @@
+/* FrameTimes.h
+ * The last FRAME_WINDOW timings of something done once a frame (the whole
+ * frame, its ticks, its drawing), for the frame time overlay. The window is
+ * kept twice in fixed arrays: as a ring in arrival order for the sparkline,
+ * and sorted for the percentiles. Adding a sample moves the sorted copy
+ * along by at most a window's worth of floats to take the oldest out and
+ * put the newest in, so percentiles are a lookup and nothing allocates.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstring>
+
+using namespace std;
+
+#define FRAME_WINDOW 240 /* samples kept, four seconds at 60 frames a second */
+
+class FrameTimes
+{
+private:
+	float samples[FRAME_WINDOW]; /* a ring, the newest just before next */
+	float sorted[FRAME_WINDOW];  /* the same count samples in order */
+	int next, count;
+
+public:
+	FrameTimes(){ clear(); }
+
+	void clear(){ next = count = 0; }
+
+	void add( float ms )
+	{
+		if( count == FRAME_WINDOW )
+		{
+			/* The oldest is about to be overwritten */
+			float *old = lower_bound( sorted, sorted + count, samples[next] );
+			memmove( old, old + 1, (sorted + count - old - 1) * sizeof(float) );
+			count--;
+		}
+		float *at = upper_bound( sorted, sorted + count, ms );
+		memmove( at + 1, at, (sorted + count - at) * sizeof(float) );
+		*at = ms;
+		count++;
+
+		samples[next] = ms;
+		next = (next + 1) % FRAME_WINDOW;
+	}
+
+	int size() const { return count; }
+
+	/* The sample age frames back, 0 for the newest */
+	float get( int age ) const { return samples[(next - 1 - age + 2 * FRAME_WINDOW) % FRAME_WINDOW]; }
+
+	/* Nearest rank percentile of the window, p in [0,1], 0 while empty
+	   (the same ranks as LatencyStats in Bench.h) */
+	float percentile( float p ) const
+	{
+		if( count == 0 )
+			return 0;
+		int rank = (int)(p * count + 0.5f);
+		rank = rank < 1 ? 1 : (rank > count ? count : rank);
+		return sorted[rank - 1];
+	}
+
+	float getMax() const { return count ? sorted[count - 1] : 0; }
+};
@@ -0,0 +1,95 @@
+/* Frustum.h
+ * The six planes of what a Camera sees, for skipping things that are off
+ * screen before they are handed to GL. The planes come out of the same
+ * projection * view matrix Renderer::applyProjection()/applyView() load
+ * (gluPerspective of the camera's shape times its view matrix), so the
+ * culling agrees with GL's clipping. No GL in here, the headless benchmarks
+ * use it too.
+ */
+
+#pragma once
+
+#include "Camera.h"
+
+enum FRUSTUM_PLANE { FRUSTUM_LEFT = 0, FRUSTUM_RIGHT, FRUSTUM_BOTTOM, FRUSTUM_TOP, FRUSTUM_NEAR, FRUSTUM_FAR };
+
+class Frustum
+{
+private:
+	/* a*x + b*y + c*z + d >= 0 inside, (a, b, c) unit length and pointing in */
+	double plane[6][4];
+
+public:
+	Frustum()
+	{
+		/* Sees everything until set() */
+		for( int p = 0; p < 6; p++ )
+		{
+			plane[p][0] = plane[p][1] = plane[p][2] = 0;
+			plane[p][3] = 1;
+		}
+	}
+
+	void set( Camera& cam )
+	{
+		float vAng, asp, nearD, farD;
+		cam.getShape( vAng, asp, nearD, farD );
+		float view[16];
+		cam.getModelViewMatrix( view );
+
+		/* gluPerspective, row major */
+		double f = 1.0 / tan( vAng * RADIANS_PER_DEGREE / 2 );
+		double proj[4][4] = {
+			{ f / asp, 0, 0, 0 },
+			{ 0, f, 0, 0 },
+			{ 0, 0, (farD + nearD) / (nearD - farD), 2.0 * farD * nearD / (nearD - farD) },
+			{ 0, 0, -1, 0 } };
+
+		/* clip = proj * view (view is column major) */
+		double clip[4][4];
+		for( int r = 0; r < 4; r++ )
+			for( int c = 0; c < 4; c++ )
+				clip[r][c] = proj[r][0]*view[4*c] + proj[r][1]*view[4*c + 1]
+					+ proj[r][2]*view[4*c + 2] + proj[r][3]*view[4*c + 3];
+
+		/* Each plane is the w row plus or minus the x, y or z row */
+		for( int p = 0; p < 6; p++ )
+		{
+			int row = p / 2;
+			double sign = (p % 2) ? -1.0 : 1.0;
+			for( int k = 0; k < 4; k++ )
+				plane[p][k] = clip[3][k] + sign * clip[row][k];
+
+			double len = sqrt( plane[p][0]*plane[p][0] + plane[p][1]*plane[p][1] + plane[p][2]*plane[p][2] );
+			if( len > 0 )
+				for( int k = 0; k < 4; k++ )
+					plane[p][k] /= len;
+		}
+	}
+
+	/* False only if the sphere is entirely outside */
+	bool sphereVisible( Vec3 c, double r ) const
+	{
+		for( int p = 0; p < 6; p++ )
+			if( plane[p][0]*c.x + plane[p][1]*c.y + plane[p][2]*c.z + plane[p][3] < -r )
+				return false;
+		return true;
+	}
+
+	/* False only if the box is entirely outside one plane */
+	bool boxVisible( const float lo[3], const float hi[3] ) const
+	{
+		for( int p = 0; p < 6; p++ )
+		{
+			/* The corner furthest along the plane's normal */
+			double x = plane[p][0] >= 0 ? hi[0] : lo[0];
+			double y = plane[p][1] >= 0 ? hi[1] : lo[1];
+			double z = plane[p][2] >= 0 ? hi[2] : lo[2];
+			if( plane[p][0]*x + plane[p][1]*y + plane[p][2]*z + plane[p][3] < 0 )
+				return false;
+		}
+		return true;
+	}
+
+	const double *getPlane( int p ) const { return plane[p]; }
+};
@@ -0,0 +1,46 @@
+/* InstanceBatch.h
+ * Many copies of one MeshBatch in a frame. The renderer collects one
+ * modelview matrix per copy (the instance buffer), then binds the mesh's
+ * arrays once and draws every copy with just a glLoadMatrixf() and a
+ * glDrawElements(), in place of drawObject()'s matrix stack work and array
+ * setup per object.
+ *
+ * GL 1.1 has no instanced draw call, and the fixed pipeline cannot read a
+ * per-instance matrix from an array. Expanding the copies into one big
+ * world space vertex array on the CPU was tried and lost to this under
+ * Mesa's software rasterizer, which transforms vertices faster than we
+ * can copy them.
+ */
+
+#pragma once
+
+#include "MeshBatch.h"
+#include "VecMath.h"
+
+class InstanceBatch
+{
+private:
+	const MeshBatch *mesh;
+	vector<Mat4> instances;
+
+public:
+	InstanceBatch(){ mesh = NULL; }
+	InstanceBatch( const MeshBatch& m ){ mesh = &m; }
+
+	/* Drops the copies but keeps the buffer for the next frame */
+	void clear(){ instances.clear(); }
+
+	/* Adds a copy at view * model */
+	void add( const Mat4& view, const Mat4& model )
+	{
+		instances.push_back( Mat4() );
+		Mat4::mul( view, model, instances.back() );
+	}
+
+	/* Adds a copy at an already multiplied modelview */
+	void add( const Mat4& modelview ){ instances.push_back( modelview ); }
+
+	const MeshBatch *getMesh() const { return mesh; }
+	int getNumInstances() const { return (int)instances.size(); }
+	const float *getMatrix( int i ) const { return instances[i].m; }
+};
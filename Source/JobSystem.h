@@ -0,0 +1,318 @@
+/* JobSystem.h
+ * A work-stealing thread pool for splitting a tick's work across cores.
+ * Every thread has its own deque of jobs: it pushes and pops at the back
+ * (the newest, cache-warm work) and, when it runs dry, steals from the
+ * front of someone else's (the oldest, usually the biggest pieces). The
+ * thread that hands out work is one of the pool and helps while it waits,
+ * so a pool of one thread runs everything inline.
+ *
+ * parallelFor() cuts a range into pieces; TaskGraph runs jobs in the order
+ * their dependencies allow. Jobs are short and must not block on anything
+ * but other jobs (wait() runs jobs while it waits). Nothing here is fair or
+ * ordered: work that writes shared state must split it so pieces never
+ * overlap, which keeps the results identical to a serial run.
+ */
+
+#pragma once
+
+#include <deque>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <functional>
+#include <condition_variable>
+#include "Profiler.h" /* and THREAD_LOCAL */
+
+using namespace std;
+
+#define JOB_THREADS 8 /* at most, fewer on smaller machines */
+
+class JobSystem
+{
+private:
+	struct Job
+	{
+		function<void()> run;
+		atomic<int> *counter;   /* taken down by one when run finishes */
+	};
+
+	struct Queue
+	{
+		mutex lock;
+		deque<Job> jobs;
+	};
+
+	vector< unique_ptr<Queue> > queues; /* [0] for threads outside the pool, [k] for worker k */
+	vector<thread> workers;
+	atomic<int> queued;                 /* jobs sitting in any queue */
+	atomic<bool> stopping;
+
+	mutex sleepLock;
+	condition_variable wake;            /* something was queued, or stopping */
+
+	JobSystem( const JobSystem& );
+	JobSystem& operator=( const JobSystem& );
+
+	/* The pool the calling thread works in and its queue there */
+	struct Worker
+	{
+		const JobSystem *pool;
+		int index;
+	};
+
+	static Worker& current()
+	{
+		static THREAD_LOCAL Worker w = { NULL, 0 };
+		return w;
+	}
+
+	/* Which queue the calling thread owns. Threads outside this pool share [0]. */
+	int self()
+	{
+		Worker& w = current();
+		return w.pool == this ? w.index : 0;
+	}
+
+	/* Own newest job first, then the oldest of anyone else's */
+	bool take( int me, Job& job )
+	{
+		{
+			Queue& q = *queues[me];
+			lock_guard<mutex> guard( q.lock );
+			if( !q.jobs.empty() )
+			{
+				job = q.jobs.back();
+				q.jobs.pop_back();
+				queued--;
+				return true;
+			}
+		}
+		int n = (int)queues.size();
+		for( int k = 1; k < n; k++ )
+		{
+			Queue& q = *queues[(me + k) % n];
+			lock_guard<mutex> guard( q.lock );
+			if( !q.jobs.empty() )
+			{
+				job = q.jobs.front();
+				q.jobs.pop_front();
+				queued--;
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void execute( Job& job )
+	{
+		job.run();
+		if( job.counter )
+			job.counter->fetch_sub( 1, memory_order_acq_rel );
+	}
+
+	void workerLoop( int me )
+	{
+		current().pool = this;
+		current().index = me;
+		PROFILE_THREAD( "job worker" );
+		for( ;; )
+		{
+			Job job;
+			if( take( me, job ) )
+			{
+				execute( job );
+				continue;
+			}
+
+			unique_lock<mutex> guard( sleepLock );
+			while( queued.load() == 0 && !stopping.load() )
+				wake.wait( guard );
+			if( stopping.load() )
+				return;
+		}
+	}
+
+public:
+	/* threads counts the one calling in, 0 picks from the machine */
+	JobSystem( int threads = 0 ) : queued( 0 ), stopping( false )
+	{
+		if( threads <= 0 )
+		{
+			threads = (int)thread::hardware_concurrency();
+			threads = threads < 1 ? 1 : (threads > JOB_THREADS ? JOB_THREADS : threads);
+		}
+		for( int k = 0; k < threads; k++ )
+			queues.push_back( unique_ptr<Queue>( new Queue() ) );
+		for( int k = 1; k < threads; k++ )
+			workers.push_back( thread( &JobSystem::workerLoop, this, k ) );
+	}
+
+	~JobSystem()
+	{
+		{
+			lock_guard<mutex> guard( sleepLock );
+			stopping = true;
+		}
+		wake.notify_all();
+		for( size_t i = 0; i < workers.size(); i++ )
+			workers[i].join();
+	}
+
+	/* The pool the game shares */
+	static JobSystem& shared()
+	{
+		static JobSystem jobs;
+		return jobs;
+	}
+
+	int getNumThreads(){ return (int)queues.size(); }
+
+	/* Queues f on the calling thread's deque. counter (if any) should
+	   already count it, it is taken down by one once f has run. */
+	void submit( const function<void()>& f, atomic<int> *counter = NULL )
+	{
+		Job job;
+		job.run = f;
+		job.counter = counter;
+		{
+			Queue& q = *queues[self()];
+			lock_guard<mutex> guard( q.lock );
+			q.jobs.push_back( job );
+			queued++;
+		}
+		if( !workers.empty() )
+		{
+			lock_guard<mutex> guard( sleepLock );
+			wake.notify_one();
+		}
+	}
+
+	/* Runs queued jobs (anyone's) until counter reaches zero */
+	void wait( atomic<int>& counter )
+	{
+		int me = self();
+		while( counter.load( memory_order_acquire ) > 0 )
+		{
+			Job job;
+			if( take( me, job ) )
+				execute( job );
+			else
+				this_thread::yield();
+		}
+	}
+
+	/* body( lo, hi ) over [begin, end) in pieces spread over the pool,
+	   returning when every piece is done. Every piece but the last is a
+	   whole multiple of grain long, so pieces can be kept from sharing
+	   anything smaller (a mask word, a cache line). */
+	template<class F> void parallelFor( int begin, int end, int grain, const F& body )
+	{
+		int count = end - begin;
+		if( count <= 0 )
+			return;
+		if( grain < 1 )
+			grain = 1;
+
+		/* A few pieces per thread so that thieves have something to take */
+		int pieces = getNumThreads() * 4;
+		int size = (count + pieces - 1) / pieces;
+		size = (size + grain - 1) / grain * grain;
+		if( size >= count || getNumThreads() == 1 )
+		{
+			body( begin, end );
+			return;
+		}
+
+		atomic<int> pending( (count + size - 1) / size - 1 );
+		for( int lo = begin + size; lo < end; lo += size )
+		{
+			int hi = lo + size < end ? lo + size : end;
+			submit( [&body, lo, hi](){ body( lo, hi ); }, &pending );
+		}
+		body( begin, begin + size < end ? begin + size : end );
+		wait( pending );
+	}
+};
+
+/* Jobs with dependencies between them: add() each, precede() to say which
+   must finish before which, then run(). A graph can be run again. */
+class TaskGraph
+{
+private:
+	struct Task
+	{
+		function<void()> run;
+		vector<int> next;      /* tasks waiting on this one */
+		int deps;
+		atomic<int> waiting;   /* deps still to finish in the current run */
+
+		Task( const function<void()>& f ) : run( f ), deps( 0 ), waiting( 0 ) {}
+	};
+
+	vector< unique_ptr<Task> > tasks;
+	vector<int> ready; /* run() scratch for a pool of one */
+
+	void start( JobSystem& jobs, int t, atomic<int> *pending )
+	{
+		jobs.submit( [this, &jobs, t, pending]()
+		{
+			Task& task = *tasks[t];
+			task.run();
+			for( size_t i = 0; i < task.next.size(); i++ )
+				if( tasks[task.next[i]]->waiting.fetch_sub( 1, memory_order_acq_rel ) == 1 )
+					start( jobs, task.next[i], pending );
+		}, pending );
+	}
+
+public:
+	/* Returns the task's id, for precede() */
+	int add( const function<void()>& f )
+	{
+		tasks.push_back( unique_ptr<Task>( new Task( f ) ) );
+		return (int)tasks.size() - 1;
+	}
+
+	/* first finishes before then starts */
+	void precede( int first, int then )
+	{
+		tasks[first]->next.push_back( then );
+		tasks[then]->deps++;
+	}
+
+	int size(){ return (int)tasks.size(); }
+
+	/* Runs every task on jobs, returning once they have all finished */
+	void run( JobSystem& jobs )
+	{
+		for( size_t t = 0; t < tasks.size(); t++ )
+			tasks[t]->waiting = tasks[t]->deps;
+
+		/* Nobody to hand them to, so run them here in dependency order
+		   without queueing anything */
+		if( jobs.getNumThreads() == 1 )
+		{
+			ready.clear();
+			for( size_t t = 0; t < tasks.size(); t++ )
+				if( tasks[t]->deps == 0 )
+					ready.push_back( (int)t );
+			while( !ready.empty() )
+			{
+				Task& task = *tasks[ready.back()];
+				ready.pop_back();
+				task.run();
+				for( size_t i = 0; i < task.next.size(); i++ )
+					if( --tasks[task.next[i]]->waiting == 0 )
+						ready.push_back( task.next[i] );
+			}
+			return;
+		}
+
+		atomic<int> pending( (int)tasks.size() );
+		for( size_t t = 0; t < tasks.size(); t++ )
+			if( tasks[t]->deps == 0 )
+				start( jobs, (int)t, &pending );
+		jobs.wait( pending );
+	}
+};
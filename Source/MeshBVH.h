@@ -0,0 +1,375 @@
+/* MeshBVH.h
+ * A bounding volume hierarchy over a mesh's triangles, in the mesh's own
+ * coordinates. Answers "does this sphere touch the mesh" and "where does this
+ * ray first hit it" exactly, visiting only the triangles near the query.
+ *
+ * VNCMesh::getBVH() builds one per mesh on first use; Object moves queries
+ * between world and mesh coordinates. No GL in here.
+ */
+
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cfloat>
+
+#include "MeshFile.h" /* uint32_t */
+
+using namespace std;
+
+#define BVH_LEAF_SIZE   4
+#define BVH_MAX_DEPTH   64
+
+struct BVHNode
+{
+	float lo[3], hi[3];
+	uint32_t first; /* leaf: first triangle, inner: index of the left child (right is first + 1) */
+	uint32_t count; /* triangles in a leaf, 0 for an inner node */
+};
+
+/* Corners of one triangle and the mesh face it came from */
+struct BVHTriangle
+{
+	float v[3][3];
+	int face;
+};
+
+/* Closest point to p on triangle abc (Ericson, Real-Time Collision Detection 5.1.5) */
+void closestPointOnTriangle( const float p[3], const float a[3], const float b[3], const float c[3], float out[3] )
+{
+	float ab[3], ac[3], ap[3];
+	for( int i = 0; i < 3; i++ ){ ab[i] = b[i] - a[i]; ac[i] = c[i] - a[i]; ap[i] = p[i] - a[i]; }
+	float d1 = ab[0]*ap[0] + ab[1]*ap[1] + ab[2]*ap[2];
+	float d2 = ac[0]*ap[0] + ac[1]*ap[1] + ac[2]*ap[2];
+	if( d1 <= 0 && d2 <= 0 ){ for( int i = 0; i < 3; i++ ) out[i] = a[i]; return; }
+
+	float bp[3];
+	for( int i = 0; i < 3; i++ ) bp[i] = p[i] - b[i];
+	float d3 = ab[0]*bp[0] + ab[1]*bp[1] + ab[2]*bp[2];
+	float d4 = ac[0]*bp[0] + ac[1]*bp[1] + ac[2]*bp[2];
+	if( d3 >= 0 && d4 <= d3 ){ for( int i = 0; i < 3; i++ ) out[i] = b[i]; return; }
+
+	float vc = d1*d4 - d3*d2;
+	if( vc <= 0 && d1 >= 0 && d3 <= 0 )
+	{
+		float v = d1 / (d1 - d3);
+		for( int i = 0; i < 3; i++ ) out[i] = a[i] + v*ab[i];
+		return;
+	}
+
+	float cp[3];
+	for( int i = 0; i < 3; i++ ) cp[i] = p[i] - c[i];
+	float d5 = ab[0]*cp[0] + ab[1]*cp[1] + ab[2]*cp[2];
+	float d6 = ac[0]*cp[0] + ac[1]*cp[1] + ac[2]*cp[2];
+	if( d6 >= 0 && d5 <= d6 ){ for( int i = 0; i < 3; i++ ) out[i] = c[i]; return; }
+
+	float vb = d5*d2 - d1*d6;
+	if( vb <= 0 && d2 >= 0 && d6 <= 0 )
+	{
+		float w = d2 / (d2 - d6);
+		for( int i = 0; i < 3; i++ ) out[i] = a[i] + w*ac[i];
+		return;
+	}
+
+	float va = d3*d6 - d5*d4;
+	if( va <= 0 && (d4 - d3) >= 0 && (d5 - d6) >= 0 )
+	{
+		float w = (d4 - d3) / ((d4 - d3) + (d5 - d6));
+		for( int i = 0; i < 3; i++ ) out[i] = b[i] + w*(c[i] - b[i]);
+		return;
+	}
+
+	float denom = 1.0f / (va + vb + vc);
+	float v = vb * denom, w = vc * denom;
+	for( int i = 0; i < 3; i++ ) out[i] = a[i] + ab[i]*v + ac[i]*w;
+}
+
+/* True if the sphere (c, r) touches triangle abc */
+bool sphereTouchesTriangle( const float c[3], float r, const float a[3], const float b[3], const float t[3] )
+{
+	float q[3];
+	closestPointOnTriangle( c, a, b, t, q );
+	float dx = q[0] - c[0], dy = q[1] - c[1], dz = q[2] - c[2];
+	return dx*dx + dy*dy + dz*dz <= r*r;
+}
+
+/* Moller-Trumbore, both sides. t is in units of dir, only hits in (0, tMax) count. */
+bool rayHitsTriangle( const float o[3], const float d[3], const float a[3], const float b[3], const float c[3], float tMax, float& t )
+{
+	float e1[3] = { b[0]-a[0], b[1]-a[1], b[2]-a[2] };
+	float e2[3] = { c[0]-a[0], c[1]-a[1], c[2]-a[2] };
+	float p[3] = { d[1]*e2[2] - d[2]*e2[1], d[2]*e2[0] - d[0]*e2[2], d[0]*e2[1] - d[1]*e2[0] };
+	float det = e1[0]*p[0] + e1[1]*p[1] + e1[2]*p[2];
+	if( fabs(det) < 1e-12f )
+		return false;
+
+	float inv = 1.0f / det;
+	float s[3] = { o[0]-a[0], o[1]-a[1], o[2]-a[2] };
+	float u = (s[0]*p[0] + s[1]*p[1] + s[2]*p[2]) * inv;
+	if( u < 0 || u > 1 )
+		return false;
+
+	float q[3] = { s[1]*e1[2] - s[2]*e1[1], s[2]*e1[0] - s[0]*e1[2], s[0]*e1[1] - s[1]*e1[0] };
+	float v = (d[0]*q[0] + d[1]*q[1] + d[2]*q[2]) * inv;
+	if( v < 0 || u + v > 1 )
+		return false;
+
+	float hit = (e2[0]*q[0] + e2[1]*q[1] + e2[2]*q[2]) * inv;
+	if( hit <= 0 || hit >= tMax )
+		return false;
+	t = hit;
+	return true;
+}
+
+class MeshBVH
+{
+private:
+	vector<BVHNode> nodes;
+	vector<BVHTriangle> tris;
+	vector<float> centroids; /* only used while building */
+
+	void fitNode( BVHNode& n, uint32_t first, uint32_t count )
+	{
+		for( int k = 0; k < 3; k++ ){ n.lo[k] = FLT_MAX; n.hi[k] = -FLT_MAX; }
+		for( uint32_t i = first; i < first + count; i++ )
+			for( int j = 0; j < 3; j++ )
+				for( int k = 0; k < 3; k++ )
+				{
+					n.lo[k] = min( n.lo[k], tris[i].v[j][k] );
+					n.hi[k] = max( n.hi[k], tris[i].v[j][k] );
+				}
+	}
+
+	/* Splits [first, first+count) at the median centroid of the longest axis */
+	void split( uint32_t node, uint32_t first, uint32_t count, int depth )
+	{
+		fitNode( nodes[node], first, count );
+		if( count <= BVH_LEAF_SIZE || depth >= BVH_MAX_DEPTH - 1 )
+		{
+			nodes[node].first = first;
+			nodes[node].count = count;
+			return;
+		}
+
+		int axis = 0;
+		float ext = -1;
+		for( int k = 0; k < 3; k++ )
+			if( nodes[node].hi[k] - nodes[node].lo[k] > ext )
+			{
+				ext = nodes[node].hi[k] - nodes[node].lo[k];
+				axis = k;
+			}
+
+		/* Partial sort of the triangles (and their centroids) around the median */
+		uint32_t mid = first + count / 2;
+		vector<uint32_t> order( count );
+		for( uint32_t i = 0; i < count; i++ )
+			order[i] = first + i;
+		const float *cen = &centroids[0];
+		nth_element( order.begin(), order.begin() + (mid - first), order.end(), AxisLess( cen, axis ) );
+
+		vector<BVHTriangle> t( count );
+		vector<float> c( count * 3 );
+		for( uint32_t i = 0; i < count; i++ )
+		{
+			t[i] = tris[order[i]];
+			for( int k = 0; k < 3; k++ )
+				c[3*i + k] = centroids[3*order[i] + k];
+		}
+		for( uint32_t i = 0; i < count; i++ )
+		{
+			tris[first + i] = t[i];
+			for( int k = 0; k < 3; k++ )
+				centroids[3*(first + i) + k] = c[3*i + k];
+		}
+
+		uint32_t left = (uint32_t)nodes.size();
+		nodes.resize( nodes.size() + 2 );
+		nodes[node].first = left;
+		nodes[node].count = 0;
+		split( left, first, mid - first, depth + 1 );
+		split( left + 1, mid, first + count - mid, depth + 1 );
+	}
+
+	struct AxisLess
+	{
+		const float *cen;
+		int axis;
+		AxisLess( const float *c, int a ){ cen = c; axis = a; }
+		bool operator()( uint32_t a, uint32_t b ) const { return cen[3*a + axis] < cen[3*b + axis]; }
+	};
+
+	static bool sphereTouchesBox( const BVHNode& n, const float c[3], float r )
+	{
+		float d2 = 0;
+		for( int k = 0; k < 3; k++ )
+		{
+			float e = c[k] < n.lo[k] ? n.lo[k] - c[k] : (c[k] > n.hi[k] ? c[k] - n.hi[k] : 0);
+			d2 += e*e;
+		}
+		return d2 <= r*r;
+	}
+
+	/* Slab test, true if the ray enters the box before tMax */
+	static bool rayTouchesBox( const BVHNode& n, const float o[3], const float inv[3], float tMax )
+	{
+		float t0 = 0, t1 = tMax;
+		for( int k = 0; k < 3; k++ )
+		{
+			float a = (n.lo[k] - o[k]) * inv[k];
+			float b = (n.hi[k] - o[k]) * inv[k];
+			if( a > b ) swap( a, b );
+			if( a > t0 ) t0 = a;
+			if( b < t1 ) t1 = b;
+			if( t0 > t1 )
+				return false;
+		}
+		return true;
+	}
+
+public:
+	void clear()
+	{
+		nodes.clear();
+		tris.clear();
+		centroids.clear();
+	}
+
+	/* Adds one triangle before build() */
+	void addTriangle( const float a[3], const float b[3], const float c[3], int face )
+	{
+		BVHTriangle t;
+		for( int k = 0; k < 3; k++ )
+		{
+			t.v[0][k] = a[k]; t.v[1][k] = b[k]; t.v[2][k] = c[k];
+			centroids.push_back( (a[k] + b[k] + c[k]) / 3.0f );
+		}
+		t.face = face;
+		tris.push_back( t );
+	}
+
+	void build()
+	{
+		nodes.clear();
+		if( tris.empty() )
+			return;
+		nodes.reserve( 2 * (tris.size() / BVH_LEAF_SIZE + 1) );
+		nodes.resize( 1 );
+		split( 0, 0, (uint32_t)tris.size(), 0 );
+		vector<float>().swap( centroids );
+	}
+
+	bool empty() const { return nodes.empty(); }
+	int getNumNodes() const { return (int)nodes.size(); }
+	int getNumTriangles() const { return (int)tris.size(); }
+	const BVHTriangle& getTriangle( int i ) const { return tris[i]; }
+
+	/* Box around everything, false when empty */
+	bool getBounds( float lo[3], float hi[3] ) const
+	{
+		if( nodes.empty() )
+			return false;
+		for( int k = 0; k < 3; k++ ){ lo[k] = nodes[0].lo[k]; hi[k] = nodes[0].hi[k]; }
+		return true;
+	}
+
+	/* Calls visit(triangle) for each triangle whose leaf box the sphere (c, r)
+	   touches, stopping as soon as visit returns true. Lets the caller do
+	   the exact test in a different space (see Object::touchesSphere). */
+	template <class Visit>
+	bool findNearSphere( const float c[3], float r, Visit& visit ) const
+	{
+		if( nodes.empty() )
+			return false;
+
+		uint32_t stack[BVH_MAX_DEPTH + 1];
+		int top = 0;
+		stack[top++] = 0;
+		while( top > 0 )
+		{
+			const BVHNode& n = nodes[stack[--top]];
+			if( !sphereTouchesBox( n, c, r ) )
+				continue;
+			if( n.count )
+			{
+				for( uint32_t i = n.first; i < n.first + n.count; i++ )
+					if( visit( tris[i] ) )
+						return true;
+			}
+			else
+			{
+				stack[top++] = n.first + 1;
+				stack[top++] = n.first;
+			}
+		}
+		return false;
+	}
+
+	/* True if the sphere (c, r) touches any triangle */
+	bool touchesSphere( const float c[3], float r ) const
+	{
+		SphereVisit v( c, r );
+		return findNearSphere( c, r, v );
+	}
+
+	/* Nearest hit of the ray o + t*d for t in (0, tMax). Sets t and the face
+	   that was hit, d doesn't need to be unit length. */
+	bool raycast( const float o[3], const float d[3], float tMax, float& t, int& face ) const
+	{
+		if( nodes.empty() )
+			return false;
+
+		float inv[3];
+		for( int k = 0; k < 3; k++ )
+			inv[k] = d[k] != 0 ? 1.0f / d[k] : (d[k] >= 0 ? FLT_MAX : -FLT_MAX);
+
+		bool hit = false;
+		float best = tMax;
+		uint32_t stack[BVH_MAX_DEPTH + 1];
+		int top = 0;
+		stack[top++] = 0;
+		while( top > 0 )
+		{
+			const BVHNode& n = nodes[stack[--top]];
+			if( !rayTouchesBox( n, o, inv, best ) )
+				continue;
+			if( n.count )
+			{
+				for( uint32_t i = n.first; i < n.first + n.count; i++ )
+				{
+					float th;
+					if( rayHitsTriangle( o, d, tris[i].v[0], tris[i].v[1], tris[i].v[2], best, th ) )
+					{
+						best = th;
+						face = tris[i].face;
+						hit = true;
+					}
+				}
+			}
+			else
+			{
+				/* Nearer child last so it comes off the stack first */
+				const BVHNode& l = nodes[n.first];
+				float lc = (l.lo[0] + l.hi[0] - 2*o[0]) * d[0] + (l.lo[1] + l.hi[1] - 2*o[1]) * d[1] + (l.lo[2] + l.hi[2] - 2*o[2]) * d[2];
+				const BVHNode& r = nodes[n.first + 1];
+				float rc = (r.lo[0] + r.hi[0] - 2*o[0]) * d[0] + (r.lo[1] + r.hi[1] - 2*o[1]) * d[1] + (r.lo[2] + r.hi[2] - 2*o[2]) * d[2];
+				bool leftFirst = lc <= rc;
+				stack[top++] = leftFirst ? n.first + 1 : n.first;
+				stack[top++] = leftFirst ? n.first : n.first + 1;
+			}
+		}
+		if( hit )
+			t = best;
+		return hit;
+	}
+
+private:
+	struct SphereVisit
+	{
+		const float *c;
+		float r;
+		SphereVisit( const float *cc, float rr ){ c = cc; r = rr; }
+		bool operator()( const BVHTriangle& t ) const { return sphereTouchesTriangle( c, r, t.v[0], t.v[1], t.v[2] ); }
+	};
+};
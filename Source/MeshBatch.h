@@ -0,0 +1,90 @@
+/* MeshBatch.h
+ * A mesh compiled for drawing: triangles only, one interleaved float array
+ * of unique vertices (position, normal, color) and an index buffer into it.
+ * Renderer hands the whole thing to GL in a single glDrawElements() call
+ * instead of a glBegin/glEnd pair per face.
+ *
+ * VNCMesh::getBatch() builds it from the mesh, this file has no GL in it.
+ */
+
+#pragma once
+
+#include <vector>
+#include <map>
+#include <cstring>
+
+#include "MeshFile.h" /* uint32_t */
+
+using namespace std;
+
+/* Laid out to be used directly as GL vertex, normal and color pointers */
+struct BatchVertex
+{
+	float pos[3];
+	float norm[3];
+	float color[3];
+};
+
+class MeshBatch
+{
+private:
+	/* A corner is shared by every face that uses the same vertex, normal and color */
+	struct Key
+	{
+		uint32_t vert, norm;
+		float color[3];
+
+		bool operator<( const Key& k ) const
+		{
+			if( vert != k.vert ) return vert < k.vert;
+			if( norm != k.norm ) return norm < k.norm;
+			return memcmp( color, k.color, sizeof(color) ) < 0;
+		}
+	};
+
+	map<Key, uint32_t> lookup; /* only used while building */
+
+public:
+	vector<BatchVertex> vertices;
+	vector<uint32_t> indices; /* three per triangle */
+
+	void clear()
+	{
+		vertices.clear();
+		indices.clear();
+		lookup.clear();
+	}
+
+	/* Index of the vertex for this corner, adding it if it is new */
+	uint32_t addCorner( const float *pos, const float *norm, uint32_t vert, uint32_t normIdx, const float *color )
+	{
+		Key k;
+		k.vert = vert;
+		k.norm = normIdx;
+		memcpy( k.color, color, sizeof(k.color) );
+
+		map<Key, uint32_t>::iterator it = lookup.find( k );
+		if( it != lookup.end() )
+			return it->second;
+
+		BatchVertex v;
+		memcpy( v.pos, pos, sizeof(v.pos) );
+		memcpy( v.norm, norm, sizeof(v.norm) );
+		memcpy( v.color, color, sizeof(v.color) );
+		vertices.push_back( v );
+
+		uint32_t idx = (uint32_t)vertices.size() - 1;
+		lookup[k] = idx;
+		return idx;
+	}
+
+	/* Drops the build-time lookup, call once the last face is in */
+	void finish()
+	{
+		lookup.clear();
+	}
+
+	int getNumVertices() const { return (int)vertices.size(); }
+	int getNumTriangles() const { return (int)indices.size() / 3; }
+	bool empty() const { return indices.empty(); }
+};
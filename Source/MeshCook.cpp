@@ -0,0 +1,52 @@
+/* MeshCook.cpp
+ *
+ * Converts .3vnc text meshes into compiled .vncb files (see MeshFile.h).
+ * The game does this by itself the first time it loads a mesh, this is for
+ * shipping pre-cooked files or cooking meshes somewhere else:
+ *
+ *   g++ -O2 -std=c++11 -o MeshCook Source/MeshCook.cpp
+ *
+ * Usage: MeshCook mesh.3vnc [mesh2.3vnc ...]     writes mesh.vncb next to each
+ *        MeshCook mesh.3vnc -o out.vncb          writes to a given file
+ */
+
+#include "mesh2.h"
+#include <cstdio>
+
+int main( int argc, char **argv )
+{
+	if( argc < 2 )
+	{
+		printf( "Usage: MeshCook mesh.3vnc [more.3vnc ...]\n" );
+		printf( "       MeshCook mesh.3vnc -o out.vncb\n" );
+		return 1;
+	}
+
+	if( argc == 4 && string(argv[2]) == "-o" )
+	{
+		VNCMesh mesh;
+		if( !mesh.read( argv[1] ) || !mesh.writeBinary( argv[3] ) )
+		{
+			fprintf( stderr, "Failed to cook %s\n", argv[1] );
+			return 1;
+		}
+		printf( "%s -> %s\n", argv[1], argv[3] );
+		return 0;
+	}
+
+	int failures = 0;
+	for( int i = 1; i < argc; i++ )
+	{
+		VNCMesh mesh;
+		string out = VNCMesh::binaryPath( argv[i] );
+		if( !mesh.read( argv[i] ) || !mesh.writeBinary( out ) )
+		{
+			fprintf( stderr, "Failed to cook %s\n", argv[i] );
+			failures++;
+			continue;
+		}
+		printf( "%s -> %s (%d verts, %d faces)\n", argv[i], out.c_str(), mesh.getNumVerts(), mesh.getNumFaces() );
+	}
+
+	return failures ? 1 : 0;
+}
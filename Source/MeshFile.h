@@ -0,0 +1,251 @@
+/* MeshFile.h
+ * The compiled binary mesh format (.vncb) and the bits needed to use it in
+ * place: a read-only file mapping and the checksum.
+ *
+ * A .vncb file is a MeshFileHeader followed by six sections, each starting on
+ * a VNCB_ALIGN byte boundary, laid out exactly the way VNCMesh keeps a mesh in
+ * memory:
+ *
+ *   positions      float[numVerts * 3]
+ *   normals        float[numNormals * 3]
+ *   faceStart      uint32[numFaces + 1]   face f uses corners faceStart[f] .. faceStart[f+1]-1
+ *   vertIndex      uint32[numCorners]
+ *   normIndex      uint32[numCorners]
+ *   faceColor      float[numFaces * 3]
+ *
+ * so a mapped file is used as is, with no parsing or copying. Because of that
+ * nothing is trusted: every offset must be the one meshLayout() gives for the
+ * counts, the face table must run in order from 0 to numCorners and every
+ * index must be in range, so a bad file can't send a reader off the mapping.
+ * The checksum covers the header (with checksum and source* zeroed) and
+ * everything after it. The source* fields remember which .3vnc text the file
+ * was cooked from so the cache can tell when it is stale; they are outside
+ * the checksum so they can be re-stamped in place.
+ */
+
+#pragma once
+
+#include <string>
+#include <cstring>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX /* keep std::min/std::max usable */
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include <stdint.h>
+
+using namespace std;
+
+#define VNCB_MAGIC       0x42434E56u /* "VNCB" */
+#define VNCB_VERSION     2
+#define VNCB_BYTE_ORDER  0x01020304u /* reads back scrambled on a big endian machine */
+#define VNCB_ALIGN       16
+
+struct MeshFileHeader
+{
+	uint32_t magic, version, byteOrder, headerSize;
+	uint32_t numVerts, numNormals, numFaces, numCorners;
+	uint32_t positionOffset, normalOffset, faceStartOffset, vertIndexOffset;
+	uint32_t normIndexOffset, faceColorOffset, fileSize, checksum;
+
+	/* Stamp of the .3vnc this was cooked from, not covered by checksum */
+	uint64_t sourceSize;
+	int64_t  sourceTime;
+	uint32_t sourceHash;
+	uint32_t reserved[5];
+};
+
+/* FNV-1a, small and good enough to catch a truncated or scribbled file */
+uint32_t meshChecksum( const void *data, size_t size, uint32_t hash = 2166136261u )
+{
+	const unsigned char *p = (const unsigned char *)data;
+	for( size_t i = 0; i < size; i++ )
+	{
+		hash ^= p[i];
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+uint64_t meshAlign( uint64_t offset )
+{
+	return (offset + VNCB_ALIGN - 1) & ~(uint64_t)(VNCB_ALIGN - 1);
+}
+
+/* Fills in the counts and section offsets of h for a mesh of the given size.
+   Returns the file size worked out in 64 bits, which is more than the 32 bit
+   fields can hold when the counts are too big for a .vncb. */
+uint64_t meshLayout( MeshFileHeader& h, uint32_t numVerts, uint32_t numNormals, uint32_t numFaces, uint32_t numCorners )
+{
+	memset( &h, 0, sizeof(h) );
+	h.magic = VNCB_MAGIC;
+	h.version = VNCB_VERSION;
+	h.byteOrder = VNCB_BYTE_ORDER;
+	h.headerSize = (uint32_t)meshAlign( sizeof(MeshFileHeader) );
+	h.numVerts = numVerts;
+	h.numNormals = numNormals;
+	h.numFaces = numFaces;
+	h.numCorners = numCorners;
+
+	uint64_t at = h.headerSize;
+	h.positionOffset = (uint32_t)at;  at = meshAlign( at + (uint64_t)numVerts * 3 * sizeof(float) );
+	h.normalOffset = (uint32_t)at;    at = meshAlign( at + (uint64_t)numNormals * 3 * sizeof(float) );
+	h.faceStartOffset = (uint32_t)at; at = meshAlign( at + ((uint64_t)numFaces + 1) * sizeof(uint32_t) );
+	h.vertIndexOffset = (uint32_t)at; at = meshAlign( at + (uint64_t)numCorners * sizeof(uint32_t) );
+	h.normIndexOffset = (uint32_t)at; at = meshAlign( at + (uint64_t)numCorners * sizeof(uint32_t) );
+	h.faceColorOffset = (uint32_t)at; at = meshAlign( at + (uint64_t)numFaces * 3 * sizeof(float) );
+	h.fileSize = (uint32_t)at;
+	return at;
+}
+
+/* Checksum of a whole image: the header with the fields that change after
+   cooking zeroed, then every section */
+uint32_t meshImageChecksum( const char *image )
+{
+	MeshFileHeader h;
+	memcpy( &h, image, sizeof(h) );
+	h.checksum = 0;
+	h.sourceSize = 0;
+	h.sourceTime = 0;
+	h.sourceHash = 0;
+	uint32_t hash = meshChecksum( &h, sizeof(h) );
+	return meshChecksum( image + sizeof(h), h.fileSize - sizeof(h), hash );
+}
+
+/* Checks that image (size bytes) is a complete, uncorrupted .vncb image that
+   is safe to attach. The structure is always checked; the checksum, which
+   has to read every byte, can be skipped. */
+bool meshImageValid( const char *image, size_t size, bool verifyChecksum = true )
+{
+	if( size < sizeof(MeshFileHeader) )
+		return false;
+
+	const MeshFileHeader *h = (const MeshFileHeader *)image;
+	if( h->magic != VNCB_MAGIC || h->version != VNCB_VERSION || h->byteOrder != VNCB_BYTE_ORDER )
+		return false;
+
+	/* Every offset must be exactly where the counts put it */
+	MeshFileHeader expect;
+	if( meshLayout( expect, h->numVerts, h->numNormals, h->numFaces, h->numCorners ) != expect.fileSize ||
+		h->headerSize != expect.headerSize || h->fileSize != expect.fileSize || size < h->fileSize ||
+		h->positionOffset != expect.positionOffset || h->normalOffset != expect.normalOffset ||
+		h->faceStartOffset != expect.faceStartOffset || h->vertIndexOffset != expect.vertIndexOffset ||
+		h->normIndexOffset != expect.normIndexOffset || h->faceColorOffset != expect.faceColorOffset )
+		return false;
+
+	if( verifyChecksum && meshImageChecksum( image ) != h->checksum )
+		return false;
+
+	/* Faces cover the corners in order, from the first to the last */
+	const uint32_t *faceStart = (const uint32_t *)(image + h->faceStartOffset);
+	if( faceStart[0] != 0 || faceStart[h->numFaces] != h->numCorners )
+		return false;
+	for( uint32_t f = 0; f < h->numFaces; f++ )
+		if( faceStart[f] > faceStart[f+1] )
+			return false;
+
+	/* And every corner names a real vertex and normal */
+	const uint32_t *vertIndex = (const uint32_t *)(image + h->vertIndexOffset);
+	const uint32_t *normIndex = (const uint32_t *)(image + h->normIndexOffset);
+	for( uint32_t c = 0; c < h->numCorners; c++ )
+		if( vertIndex[c] >= h->numVerts || normIndex[c] >= h->numNormals )
+			return false;
+
+	return true;
+}
+
+/* Size and modification time of a file, false if it doesn't exist */
+bool fileStamp( const string& path, uint64_t& size, int64_t& time )
+{
+	struct stat st;
+	if( stat( path.c_str(), &st ) != 0 )
+		return false;
+	size = (uint64_t)st.st_size;
+	time = (int64_t)st.st_mtime;
+	return true;
+}
+
+/* A whole file mapped read-only into memory */
+class MappedFile
+{
+private:
+	const char *base;
+	size_t length;
+#ifdef _WIN32
+	HANDLE file, mapping;
+#endif
+
+	MappedFile( const MappedFile& );
+	MappedFile& operator=( const MappedFile& );
+
+public:
+	MappedFile()
+	{
+		base = NULL; length = 0;
+#ifdef _WIN32
+		file = INVALID_HANDLE_VALUE; mapping = NULL;
+#endif
+	}
+
+	~MappedFile(){ close(); }
+
+	bool open( const string& path )
+	{
+		close();
+#ifdef _WIN32
+		file = CreateFileA( path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+			FILE_ATTRIBUTE_NORMAL, NULL );
+		if( file == INVALID_HANDLE_VALUE )
+			return false;
+		LARGE_INTEGER sz;
+		GetFileSizeEx( file, &sz );
+		length = (size_t)sz.QuadPart;
+		mapping = length ? CreateFileMappingA( file, NULL, PAGE_READONLY, 0, 0, NULL ) : NULL;
+		base = mapping ? (const char *)MapViewOfFile( mapping, FILE_MAP_READ, 0, 0, 0 ) : NULL;
+#else
+		int fd = ::open( path.c_str(), O_RDONLY );
+		if( fd < 0 )
+			return false;
+		struct stat st;
+		if( fstat( fd, &st ) == 0 && st.st_size > 0 )
+		{
+			length = (size_t)st.st_size;
+			void *p = mmap( NULL, length, PROT_READ, MAP_PRIVATE, fd, 0 );
+			base = p == MAP_FAILED ? NULL : (const char *)p;
+		}
+		::close( fd ); /* the mapping keeps the file alive */
+#endif
+		if( !base )
+		{
+			close();
+			return false;
+		}
+		return true;
+	}
+
+	void close()
+	{
+#ifdef _WIN32
+		if( base ) UnmapViewOfFile( base );
+		if( mapping ) CloseHandle( mapping );
+		if( file != INVALID_HANDLE_VALUE ) CloseHandle( file );
+		mapping = NULL; file = INVALID_HANDLE_VALUE;
+#else
+		if( base ) munmap( (void *)base, length );
+#endif
+		base = NULL; length = 0;
+	}
+
+	bool isOpen(){ return base != NULL; }
+	const char *data(){ return base; }
+	size_t size(){ return length; }
+};
@@ -0,0 +1,255 @@
+/* MeshRegistry.h
+ * One copy of every mesh the game uses, keyed by file path and loaded on
+ * worker threads. request() returns at once with a MeshHandle; the mesh is
+ * read (through its .vncb cache, see VNCMesh::load), offset and given its
+ * BVH and levels of detail in the background, and the handle starts
+ * returning it once that is all done. Asking for the same path again gives
+ * back the same mesh.
+ *
+ * Handles are shared, so a mesh stays alive for as long as anything holds
+ * one. Nothing but the worker touches a mesh until it is ready, after that
+ * it is only read (the lazy getBatch()/getBVH() builds are done up front).
+ */
+
+#pragma once
+
+#include <map>
+#include <deque>
+#include <vector>
+#include <string>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+
+#include "mesh2.h"
+
+using namespace std;
+
+#define MESH_LOADER_THREADS 4 /* at most, fewer on smaller machines */
+
+/* What to do to a mesh once it is read. The first request for a path decides. */
+struct MeshSetup
+{
+	Vec3 offset;
+	bool buildLODs;
+
+	MeshSetup(){ offset = Vec3(0,0,0); buildLODs = true; }
+	MeshSetup( Vec3 off, bool lods = true ){ offset = off; buildLODs = lods; }
+};
+
+enum MeshState { MESH_PENDING = 0, MESH_READY, MESH_FAILED };
+
+/* A mesh in the registry and how far along it is */
+class MeshAsset
+{
+public:
+	string path;
+	MeshSetup setup;
+	VNCMesh mesh;
+	atomic<int> state;
+
+	mutex lock;
+	condition_variable loaded;
+
+	MeshAsset( const string& p, const MeshSetup& s ) : path(p), setup(s), state(MESH_PENDING) {}
+
+	/* Runs on a worker thread */
+	void load()
+	{
+		PROFILE_SCOPE( "MeshAsset::load" );
+		bool ok = mesh.load( path );
+		if( ok )
+		{
+			mesh.setOffset( setup.offset );
+			mesh.getBatch();
+			mesh.getBVH();
+			if( setup.buildLODs )
+				mesh.buildLODs();
+		}
+		lock_guard<mutex> guard( lock );
+		state.store( ok ? MESH_READY : MESH_FAILED, memory_order_release );
+		loaded.notify_all();
+	}
+
+	/* Blocks until load() has finished, true if the mesh is usable */
+	bool wait()
+	{
+		unique_lock<mutex> guard( lock );
+		while( state.load( memory_order_acquire ) == MESH_PENDING )
+			loaded.wait( guard );
+		return state.load() == MESH_READY;
+	}
+};
+
+/* Shared reference to a registry mesh. get() is NULL until it has loaded. */
+class MeshHandle
+{
+private:
+	shared_ptr<MeshAsset> asset;
+
+public:
+	MeshHandle(){}
+	explicit MeshHandle( const shared_ptr<MeshAsset>& a ) : asset(a) {}
+
+	bool isNull() const { return !asset; }
+	MeshState getState() const { return asset ? (MeshState)asset->state.load( memory_order_acquire ) : MESH_FAILED; }
+	bool isReady() const { return getState() == MESH_READY; }
+	bool hasFailed() const { return getState() == MESH_FAILED; }
+
+	VNCMesh *get() const { return isReady() ? &asset->mesh : NULL; }
+	string getPath() const { return asset ? asset->path : string(); }
+
+	/* Blocks until the mesh is loaded or has failed, true if it loaded */
+	bool wait() const { return asset ? asset->wait() : false; }
+
+	bool operator==( const MeshHandle& h ) const { return asset == h.asset; }
+	bool operator!=( const MeshHandle& h ) const { return asset != h.asset; }
+};
+
+class MeshRegistry
+{
+private:
+	map< string, shared_ptr<MeshAsset> > assets;
+	deque< shared_ptr<MeshAsset> > queue;
+	vector<thread> workers;
+	int maxWorkers;
+	int busy;
+	bool stopping;
+
+	mutex lock;
+	condition_variable work;  /* something was queued, or stopping */
+	condition_variable done;  /* something finished loading */
+
+	MeshRegistry( const MeshRegistry& );
+	MeshRegistry& operator=( const MeshRegistry& );
+
+	void workerLoop()
+	{
+		PROFILE_THREAD( "mesh loader" );
+		unique_lock<mutex> guard( lock );
+		for( ;; )
+		{
+			while( queue.empty() && !stopping )
+				work.wait( guard );
+			if( stopping )
+				return;
+
+			shared_ptr<MeshAsset> asset = queue.front();
+			queue.pop_front();
+			busy++;
+
+			guard.unlock();
+			asset->load();
+			guard.lock();
+
+			busy--;
+			done.notify_all();
+		}
+	}
+
+	/* One more worker per waiting mesh, up to maxWorkers. Call with lock held. */
+	void growPool()
+	{
+		while( (int)workers.size() < maxWorkers && (int)(queue.size() + busy) > (int)workers.size() )
+			workers.push_back( thread( &MeshRegistry::workerLoop, this ) );
+	}
+
+public:
+	MeshRegistry( int threads = 0 )
+	{
+		if( threads <= 0 )
+		{
+			threads = (int)thread::hardware_concurrency();
+			threads = threads < 1 ? 1 : (threads > MESH_LOADER_THREADS ? MESH_LOADER_THREADS : threads);
+		}
+		maxWorkers = threads;
+		busy = 0;
+		stopping = false;
+	}
+
+	~MeshRegistry()
+	{
+		{
+			lock_guard<mutex> guard( lock );
+			stopping = true;
+			queue.clear();
+		}
+		work.notify_all();
+		for( size_t i = 0; i < workers.size(); i++ )
+			workers[i].join();
+	}
+
+	/* The registry the game shares */
+	static MeshRegistry& shared()
+	{
+		static MeshRegistry registry;
+		return registry;
+	}
+
+	/* Handle to the mesh at path, queueing it to load if it is new */
+	MeshHandle request( const string& path, const MeshSetup& setup = MeshSetup() )
+	{
+		lock_guard<mutex> guard( lock );
+		map< string, shared_ptr<MeshAsset> >::iterator it = assets.find( path );
+		if( it != assets.end() )
+			return MeshHandle( it->second );
+
+		shared_ptr<MeshAsset> asset( new MeshAsset( path, setup ) );
+		assets[path] = asset;
+		queue.push_back( asset );
+		growPool();
+		work.notify_one();
+		return MeshHandle( asset );
+	}
+
+	/* Blocks until every mesh requested so far is in, true if none failed */
+	bool waitAll()
+	{
+		unique_lock<mutex> guard( lock );
+		while( !queue.empty() || busy > 0 )
+			done.wait( guard );
+
+		map< string, shared_ptr<MeshAsset> >::iterator it;
+		for( it = assets.begin(); it != assets.end(); ++it )
+			if( it->second->state.load() != MESH_READY )
+				return false;
+		return true;
+	}
+
+	/* Meshes still queued or loading */
+	int pending()
+	{
+		lock_guard<mutex> guard( lock );
+		return (int)queue.size() + busy;
+	}
+
+	/* Forgets meshes nothing holds a handle to any more, returns how many.
+	   Meshes still loading are kept. */
+	int purge()
+	{
+		lock_guard<mutex> guard( lock );
+		int dropped = 0;
+		map< string, shared_ptr<MeshAsset> >::iterator it = assets.begin();
+		while( it != assets.end() )
+		{
+			if( it->second.use_count() == 1 && it->second->state.load() != MESH_PENDING )
+			{
+				assets.erase( it++ );
+				dropped++;
+			}
+			else
+				++it;
+		}
+		return dropped;
+	}
+
+	int size()
+	{
+		lock_guard<mutex> guard( lock );
+		return (int)assets.size();
+	}
+
+	int getMaxThreads(){ return maxWorkers; }
+};
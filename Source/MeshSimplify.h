@@ -0,0 +1,474 @@
+/* MeshSimplify.h
+ * Quadric error edge collapse (Garland and Heckbert, "Surface Simplification
+ * Using Quadric Error Metrics", 1997), used by VNCMesh::buildLODs() to make
+ * cheaper versions of a mesh for drawing far away.
+ *
+ * Each vertex carries the planes of the triangles around it as a quadric, so
+ * the cost of moving it is the sum of squared distances to those planes. An
+ * edge is only collapsed while that cost stays under maxError squared, which
+ * bounds how far the simplified surface strays from the original. Open
+ * edges and edges between differently colored faces get extra planes so
+ * outlines and color borders hold their shape.
+ *
+ * Works on triangles with a color each. Simplifying is progressive: call
+ * simplify() again with a lower target to carry on from where it stopped.
+ */
+
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "MeshBatch.h"
+#include "MeshBVH.h" /* closestPointOnTriangle */
+
+using namespace std;
+
+#define SIMPLIFY_SEAM_WEIGHT  4.0   /* how much more a border or color seam plane counts */
+#define SIMPLIFY_MIN_COS      0.2   /* triangles may not turn further than this (~78 degrees) */
+#define SIMPLIFY_COLOR_TOLERANCE 0.25f /* faces closer in color than this count as one color */
+
+class MeshSimplifier
+{
+private:
+	/* Symmetric 4x4 matrix, upper triangle: aa ab ac ad bb bc bd cc cd dd */
+	struct Quadric
+	{
+		double m[10];
+
+		Quadric(){ memset( m, 0, sizeof(m) ); }
+
+		/* The squared distance to plane ax + by + cz + d = 0 (a,b,c unit), times w */
+		void addPlane( double a, double b, double c, double d, double w )
+		{
+			m[0] += w*a*a; m[1] += w*a*b; m[2] += w*a*c; m[3] += w*a*d;
+			m[4] += w*b*b; m[5] += w*b*c; m[6] += w*b*d;
+			m[7] += w*c*c; m[8] += w*c*d;
+			m[9] += w*d*d;
+		}
+
+		void add( const Quadric& q )
+		{
+			for( int i = 0; i < 10; i++ )
+				m[i] += q.m[i];
+		}
+
+		double eval( const double p[3] ) const
+		{
+			double x = p[0], y = p[1], z = p[2];
+			return m[0]*x*x + 2*m[1]*x*y + 2*m[2]*x*z + 2*m[3]*x
+				+ m[4]*y*y + 2*m[5]*y*z + 2*m[6]*y
+				+ m[7]*z*z + 2*m[8]*z + m[9];
+		}
+
+		/* Point of least error, false if the quadric is (nearly) singular */
+		bool optimum( double out[3] ) const
+		{
+			double a = m[0], b = m[1], c = m[2], e = m[4], f = m[5], i = m[7];
+			double det = a*(e*i - f*f) - b*(b*i - f*c) + c*(b*f - e*c);
+			if( fabs( det ) < 1e-12 )
+				return false;
+			double r[3] = { -m[3], -m[6], -m[8] };
+			out[0] = (r[0]*(e*i - f*f) - b*(r[1]*i - f*r[2]) + c*(r[1]*f - e*r[2])) / det;
+			out[1] = (a*(r[1]*i - f*r[2]) - r[0]*(b*i - f*c) + c*(b*r[2] - r[1]*c)) / det;
+			out[2] = (a*(e*r[2] - r[1]*f) - b*(b*r[2] - r[1]*c) + r[0]*(b*f - e*c)) / det;
+			return true;
+		}
+	};
+
+	struct Vert
+	{
+		double p[3];
+		Quadric q;
+	};
+
+	struct Tri
+	{
+		int v[3];
+		float color[3];
+		bool dead;
+	};
+
+	struct Edge
+	{
+		int a, b;
+		double cost;
+		double p[3];
+		bool operator<( const Edge& e ) const { return cost < e.cost; }
+	};
+
+	vector<Vert> verts;
+	vector<Tri> tris;
+	vector< vector<int> > around; /* triangles using each vertex */
+	int alive;
+	double worstCost;
+
+	static void normal( const double a[3], const double b[3], const double c[3], double n[3] )
+	{
+		double u[3] = { b[0]-a[0], b[1]-a[1], b[2]-a[2] }, v[3] = { c[0]-a[0], c[1]-a[1], c[2]-a[2] };
+		n[0] = u[1]*v[2] - u[2]*v[1];
+		n[1] = u[2]*v[0] - u[0]*v[2];
+		n[2] = u[0]*v[1] - u[1]*v[0];
+		double len = sqrt( n[0]*n[0] + n[1]*n[1] + n[2]*n[2] );
+		if( len > 0 ){ n[0] /= len; n[1] /= len; n[2] /= len; }
+	}
+
+	static bool sameColor( const Tri& a, const Tri& b )
+	{
+		return fabs( a.color[0] - b.color[0] ) <= SIMPLIFY_COLOR_TOLERANCE && fabs( a.color[1] - b.color[1] ) <= SIMPLIFY_COLOR_TOLERANCE &&
+			fabs( a.color[2] - b.color[2] ) <= SIMPLIFY_COLOR_TOLERANCE;
+	}
+
+	void buildAround()
+	{
+		around.assign( verts.size(), vector<int>() );
+		for( size_t t = 0; t < tris.size(); t++ )
+			if( !tris[t].dead )
+				for( int k = 0; k < 3; k++ )
+					around[tris[t].v[k]].push_back( (int)t );
+	}
+
+	/* Face planes on every vertex, plus a perpendicular plane along every
+	   open edge and color seam */
+	void buildQuadrics()
+	{
+		buildAround();
+		for( size_t t = 0; t < tris.size(); t++ )
+		{
+			const Tri& tr = tris[t];
+			double n[3];
+			normal( verts[tr.v[0]].p, verts[tr.v[1]].p, verts[tr.v[2]].p, n );
+			const double *p = verts[tr.v[0]].p;
+			double d = -(n[0]*p[0] + n[1]*p[1] + n[2]*p[2]);
+			for( int k = 0; k < 3; k++ )
+				verts[tr.v[k]].q.addPlane( n[0], n[1], n[2], d, 1.0 );
+
+			for( int k = 0; k < 3; k++ )
+			{
+				int a = tr.v[k], b = tr.v[(k+1) % 3];
+				int shared = 0;
+				bool seam = false;
+				for( size_t i = 0; i < around[a].size(); i++ )
+				{
+					const Tri& o = tris[around[a][i]];
+					if( around[a][i] != (int)t && (o.v[0] == b || o.v[1] == b || o.v[2] == b) )
+					{
+						shared++;
+						seam = seam || !sameColor( tr, o );
+					}
+				}
+				if( shared > 0 && !seam )
+					continue;
+
+				/* Plane through the edge, at right angles to the face */
+				const double *pa = verts[a].p, *pb = verts[b].p;
+				double e[3] = { pb[0]-pa[0], pb[1]-pa[1], pb[2]-pa[2] };
+				double m[3] = { e[1]*n[2] - e[2]*n[1], e[2]*n[0] - e[0]*n[2], e[0]*n[1] - e[1]*n[0] };
+				double len = sqrt( m[0]*m[0] + m[1]*m[1] + m[2]*m[2] );
+				if( len <= 0 )
+					continue;
+				m[0] /= len; m[1] /= len; m[2] /= len;
+				double md = -(m[0]*pa[0] + m[1]*pa[1] + m[2]*pa[2]);
+				verts[a].q.addPlane( m[0], m[1], m[2], md, SIMPLIFY_SEAM_WEIGHT );
+				verts[b].q.addPlane( m[0], m[1], m[2], md, SIMPLIFY_SEAM_WEIGHT );
+			}
+		}
+	}
+
+	/* Cheapest place to put the merged vertex of edge (a, b) */
+	void price( Edge& e )
+	{
+		Quadric q = verts[e.a].q;
+		q.add( verts[e.b].q );
+
+		const double *pa = verts[e.a].p, *pb = verts[e.b].p;
+		double cand[4][3];
+		int n = 0;
+		if( q.optimum( cand[n] ) ) n++;
+		for( int k = 0; k < 3; k++ )
+		{
+			cand[n][k] = pa[k];
+			cand[n+1][k] = pb[k];
+			cand[n+2][k] = (pa[k] + pb[k]) / 2;
+		}
+		n += 3;
+
+		e.cost = 1e300;
+		for( int i = 0; i < n; i++ )
+		{
+			double c = q.eval( cand[i] );
+			if( c < e.cost )
+			{
+				e.cost = c;
+				memcpy( e.p, cand[i], sizeof(e.p) );
+			}
+		}
+		if( e.cost < 0 ) /* rounding */
+			e.cost = 0;
+	}
+
+	/* False if moving v to p would fold over a triangle that doesn't use
+	   other, or leave a sliver */
+	bool keepsShape( int v, int other, const double p[3] )
+	{
+		for( size_t i = 0; i < around[v].size(); i++ )
+		{
+			const Tri& t = tris[around[v][i]];
+			if( t.dead || t.v[0] == other || t.v[1] == other || t.v[2] == other )
+				continue;
+
+			const double *c[3], *moved[3];
+			for( int k = 0; k < 3; k++ )
+			{
+				c[k] = verts[t.v[k]].p;
+				moved[k] = t.v[k] == v ? p : c[k];
+			}
+			double before[3], after[3];
+			normal( c[0], c[1], c[2], before );
+			normal( moved[0], moved[1], moved[2], after );
+			if( before[0]*after[0] + before[1]*after[1] + before[2]*after[2] < SIMPLIFY_MIN_COS )
+				return false;
+		}
+		return true;
+	}
+
+	/* An edge may only go if a and b share just the one or two triangles on
+	   it, otherwise the collapse pinches the surface */
+	bool manifold( int a, int b )
+	{
+		int onEdge = 0;
+		for( size_t i = 0; i < around[a].size(); i++ )
+		{
+			const Tri& t = tris[around[a][i]];
+			if( !t.dead && (t.v[0] == b || t.v[1] == b || t.v[2] == b) )
+				onEdge++;
+		}
+
+		/* Vertices next to both a and b (other than across the edge's own triangles) */
+		vector<int> na, nb;
+		for( size_t i = 0; i < around[a].size(); i++ )
+			if( !tris[around[a][i]].dead )
+				for( int k = 0; k < 3; k++ )
+					na.push_back( tris[around[a][i]].v[k] );
+		for( size_t i = 0; i < around[b].size(); i++ )
+			if( !tris[around[b][i]].dead )
+				for( int k = 0; k < 3; k++ )
+					nb.push_back( tris[around[b][i]].v[k] );
+		sort( na.begin(), na.end() ); na.erase( unique( na.begin(), na.end() ), na.end() );
+		sort( nb.begin(), nb.end() ); nb.erase( unique( nb.begin(), nb.end() ), nb.end() );
+		int common = 0;
+		for( size_t i = 0, j = 0; i < na.size() && j < nb.size(); )
+		{
+			if( na[i] < nb[j] ) i++;
+			else if( na[i] > nb[j] ) j++;
+			else
+			{
+				if( na[i] != a && na[i] != b )
+					common++;
+				i++; j++;
+			}
+		}
+		return onEdge >= 1 && onEdge <= 2 && common == onEdge;
+	}
+
+	/* Moves b into a at p */
+	void collapse( const Edge& e )
+	{
+		Vert& a = verts[e.a];
+		memcpy( a.p, e.p, sizeof(a.p) );
+		a.q.add( verts[e.b].q );
+		if( e.cost > worstCost )
+			worstCost = e.cost;
+
+		for( size_t i = 0; i < around[e.b].size(); i++ )
+		{
+			int ti = around[e.b][i];
+			Tri& t = tris[ti];
+			if( t.dead )
+				continue;
+			if( t.v[0] == e.a || t.v[1] == e.a || t.v[2] == e.a )
+			{
+				t.dead = true;
+				alive--;
+				continue;
+			}
+			for( int k = 0; k < 3; k++ )
+				if( t.v[k] == e.b )
+					t.v[k] = e.a;
+			around[e.a].push_back( ti );
+		}
+		around[e.b].clear();
+	}
+
+public:
+	MeshSimplifier(){ alive = 0; worstCost = 0; }
+
+	/* positions: numVerts xyz. indices: three per triangle. colors: RGB per triangle. */
+	void setMesh( const float *positions, int numVerts, const vector<uint32_t>& indices, const vector<float>& colors )
+	{
+		verts.resize( numVerts );
+		for( int i = 0; i < numVerts; i++ )
+			for( int k = 0; k < 3; k++ )
+				verts[i].p[k] = positions[3*i + k];
+
+		tris.resize( indices.size() / 3 );
+		for( size_t t = 0; t < tris.size(); t++ )
+		{
+			for( int k = 0; k < 3; k++ )
+			{
+				tris[t].v[k] = (int)indices[3*t + k];
+				tris[t].color[k] = colors[3*t + k];
+			}
+			tris[t].dead = tris[t].v[0] == tris[t].v[1] || tris[t].v[1] == tris[t].v[2] || tris[t].v[0] == tris[t].v[2];
+		}
+		alive = 0;
+		for( size_t t = 0; t < tris.size(); t++ )
+			alive += !tris[t].dead;
+		worstCost = 0;
+		buildQuadrics();
+	}
+
+	/* Collapses edges until no more than target triangles are left or the
+	   next collapse would cost more than maxError. Returns the triangles left. */
+	int simplify( int target, double maxError )
+	{
+		double maxCost = maxError * maxError;
+		vector<Edge> edges;
+		vector<char> touched;
+
+		while( alive > target )
+		{
+			buildAround();
+
+			/* Every edge once, priced */
+			edges.clear();
+			for( size_t t = 0; t < tris.size(); t++ )
+			{
+				if( tris[t].dead )
+					continue;
+				for( int k = 0; k < 3; k++ )
+				{
+					Edge e;
+					e.a = tris[t].v[k];
+					e.b = tris[t].v[(k+1) % 3];
+					if( e.a > e.b )
+						swap( e.a, e.b );
+					edges.push_back( e );
+				}
+			}
+			sort( edges.begin(), edges.end(), EdgeOrder() );
+			edges.erase( unique( edges.begin(), edges.end(), EdgeSame() ), edges.end() );
+			for( size_t i = 0; i < edges.size(); i++ )
+				price( edges[i] );
+			sort( edges.begin(), edges.end() );
+
+			/* Cheapest first; a vertex touched this pass waits for the next */
+			touched.assign( verts.size(), 0 );
+			int collapsed = 0;
+			for( size_t i = 0; i < edges.size() && alive > target; i++ )
+			{
+				const Edge& e = edges[i];
+				if( e.cost > maxCost )
+					break;
+				if( touched[e.a] || touched[e.b] )
+					continue;
+				if( !manifold( e.a, e.b ) || !keepsShape( e.a, e.b, e.p ) || !keepsShape( e.b, e.a, e.p ) )
+					continue;
+
+				for( int s = 0; s < 2; s++ )
+				{
+					int v = s ? e.b : e.a;
+					for( size_t j = 0; j < around[v].size(); j++ )
+						for( int k = 0; k < 3; k++ )
+							touched[tris[around[v][j]].v[k]] = 1;
+				}
+				collapse( e );
+				collapsed++;
+			}
+			if( collapsed == 0 )
+				break;
+		}
+		return alive;
+	}
+
+	int getNumTriangles(){ return alive; }
+
+	/* Worst collapse so far. An upper bound on how far the surface has
+	   moved, usually a loose one; see batchDistance() for a measurement. */
+	double getError(){ return sqrt( worstCost ); }
+
+	/* Furthest any vertex of a is from the surface of b or the other way
+	   round, a vertex sampled Hausdorff distance between two versions of a mesh */
+	static float batchDistance( const MeshBatch& a, const MeshBatch& b )
+	{
+		float worst = 0;
+		for( int pass = 0; pass < 2; pass++ )
+		{
+			const MeshBatch& from = pass ? b : a;
+			const MeshBatch& to = pass ? a : b;
+			for( size_t v = 0; v < from.vertices.size(); v++ )
+			{
+				const float *p = from.vertices[v].pos;
+				float best = 1e30f;
+				for( size_t t = 0; t + 2 < to.indices.size() && best > worst; t += 3 )
+				{
+					float q[3];
+					closestPointOnTriangle( p, to.vertices[to.indices[t]].pos, to.vertices[to.indices[t+1]].pos,
+						to.vertices[to.indices[t+2]].pos, q );
+					float d = (q[0]-p[0])*(q[0]-p[0]) + (q[1]-p[1])*(q[1]-p[1]) + (q[2]-p[2])*(q[2]-p[2]);
+					best = min( best, d );
+				}
+				/* Stopped early means this vertex can't raise worst */
+				if( best > worst )
+					worst = best;
+			}
+		}
+		return sqrt( worst );
+	}
+
+	/* The mesh as it stands, normals averaged over the triangles at each vertex */
+	void writeBatch( MeshBatch& out )
+	{
+		vector<double> vn( verts.size() * 3, 0.0 );
+		for( size_t t = 0; t < tris.size(); t++ )
+		{
+			if( tris[t].dead )
+				continue;
+			double n[3];
+			normal( verts[tris[t].v[0]].p, verts[tris[t].v[1]].p, verts[tris[t].v[2]].p, n );
+			for( int k = 0; k < 3; k++ )
+				for( int j = 0; j < 3; j++ )
+					vn[3*tris[t].v[k] + j] += n[j];
+		}
+
+		out.clear();
+		for( size_t t = 0; t < tris.size(); t++ )
+		{
+			if( tris[t].dead )
+				continue;
+			for( int k = 0; k < 3; k++ )
+			{
+				int v = tris[t].v[k];
+				const double *p = verts[v].p, *n = &vn[3*v];
+				double len = sqrt( n[0]*n[0] + n[1]*n[1] + n[2]*n[2] );
+				if( len <= 0 ) len = 1;
+				float fp[3] = { (float)p[0], (float)p[1], (float)p[2] };
+				float fn[3] = { (float)(n[0] / len), (float)(n[1] / len), (float)(n[2] / len) };
+				out.indices.push_back( out.addCorner( fp, fn, v, 0, tris[t].color ) );
+			}
+		}
+		out.finish();
+	}
+
+private:
+	struct EdgeOrder
+	{
+		bool operator()( const Edge& x, const Edge& y ) const { return x.a != y.a ? x.a < y.a : x.b < y.b; }
+	};
+	struct EdgeSame
+	{
+		bool operator()( const Edge& x, const Edge& y ) const { return x.a == y.a && x.b == y.b; }
+	};
+};
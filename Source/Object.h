@@ -7,178 +7,276 @@
 #pragma once
 
 #include <vector>
-#include "Random.h"
 #include "Camera.h"
-#include "mesh2.h"
+#include "MeshRegistry.h"
+#include "InstanceBatch.h"
 
-enum OBJECT_TYPE { OBJECT_POWERUP = 0, OBJECT_BADGUY, OBJECT_PLAYER, OBJECT_WEAPON1, OBJECT_WEAPON2, OBJECT_WEAPON3, OBJECT_WEAPON4 };
+enum OBJECT_TYPE { OBJECT_POWERUP = 0, OBJECT_BADGUY, OBJECT_PLAYER, OBJECT_WEAPON1, OBJECT_WEAPON2, OBJECT_WEAPON3, OBJECT_WEAPON4, NUM_OBJECT_TYPES };
 
-/* Every object is it's own Camera => Potentially useful design idea */
-class Object : public Camera
+/* Where Renderer::drawObject() puts a mesh: scaled about (0.5,0.5,0.5),
+   turned about x, then y, then z (degrees) and moved to position. That is
+   world = position + m * (scale * (local - 0.5)), m row major. Objects and
+   EntityStore entities both go through this. */
+struct Placement
 {
-private:
-	Random rnd;
-	VNCMesh *mesh;	/* This is a pointer to an already loaded mesh (ideally) */
-	bool isVisible, hitBoxVisible;
-	int rotationAxis; /* random int between 0-5 determining how it should rotate initially*/
+	Vec3 position, rotation, scale;
+
+	Placement( const Vec3& p, const Vec3& r, const Vec3& s ) : position(p), rotation(r), scale(s) {}
+
+	void getRotation( double m[9] ) const
+	{
+		double a = rotation.x * RADIANS_PER_DEGREE, b = rotation.y * RADIANS_PER_DEGREE, c = rotation.z * RADIANS_PER_DEGREE;
+		double ca = cos(a), sa = sin(a), cb = cos(b), sb = sin(b), cc = cos(c), sc = sin(c);
+
+		/* Rx * Ry * Rz */
+		m[0] = cb*cc;              m[1] = -cb*sc;             m[2] = sb;
+		m[3] = sa*sb*cc + ca*sc;   m[4] = -sa*sb*sc + ca*cc;  m[5] = -sa*cb;
+		m[6] = -ca*sb*cc + sa*sc;  m[7] = ca*sb*sc + sa*cc;   m[8] = ca*cb;
+	}
+
+	void toWorld( const double m[9], const float local[3], float out[3] ) const
+	{
+		double l[3] = { scale.x * (local[0] - 0.5), scale.y * (local[1] - 0.5), scale.z * (local[2] - 0.5) };
+		out[0] = (float)(position.x + m[0]*l[0] + m[1]*l[1] + m[2]*l[2]);
+		out[1] = (float)(position.y + m[3]*l[0] + m[4]*l[1] + m[5]*l[2]);
+		out[2] = (float)(position.z + m[6]*l[0] + m[7]*l[1] + m[8]*l[2]);
+	}
+
+	/* Inverse of toWorld(). With point false, world is a direction. */
+	void toLocal( const double m[9], const double world[3], float out[3], bool point = true ) const
+	{
+		double d[3] = { world[0], world[1], world[2] };
+		if( point )
+		{
+			d[0] -= position.x; d[1] -= position.y; d[2] -= position.z;
+		}
+		double s[3] = { scale.x, scale.y, scale.z };
+		for( int k = 0; k < 3; k++ )
+			out[k] = (float)((m[k]*d[0] + m[3+k]*d[1] + m[6+k]*d[2]) / s[k] + (point ? 0.5 : 0.0));
+	}
+
+	/* toWorld() as a 4x4 matrix, what drawObject() builds on the modelview
+	   stack, for drawing the mesh through an InstanceBatch */
+	void getModelMatrix( Mat4& out ) const
+	{
+		out = Mat4::rotationXYZ( rotation );
+		float s[3] = { scale.x, scale.y, scale.z };
+		for( int c = 0; c < 3; c++ )
+			for( int r = 0; r < 3; r++ )
+				out.m[4*c + r] *= s[c];
+
+		/* position - R * S * (0.5, 0.5, 0.5) */
+		Vec3 half = out.transformDir( Vec3( 0.5f, 0.5f, 0.5f ) );
+		out.m[12] = position.x - half.x;
+		out.m[13] = position.y - half.y;
+		out.m[14] = position.z - half.z;
+	}
+
+	/* Radius around position that holds the whole mesh however it is turned,
+	   scale.x without a mesh */
+	float getBoundingRadius( VNCMesh *m ) const
+	{
+		if( !m || m->getNumVerts() == 0 )
+			return scale.x;
+
+		Vec3 lo = m->getBoxMin(), hi = m->getBoxMax();
+		float dx = max( fabsf(lo.x - 0.5f), fabsf(hi.x - 0.5f) ) * fabsf(scale.x);
+		float dy = max( fabsf(lo.y - 0.5f), fabsf(hi.y - 0.5f) ) * fabsf(scale.y);
+		float dz = max( fabsf(lo.z - 0.5f), fabsf(hi.z - 0.5f) ) * fabsf(scale.z);
+		return sqrtf( dx*dx + dy*dy + dz*dz );
+	}
+
+	/* Coarsest level of detail (see VNCMesh::buildLODs) whose error, seen
+	   from eye, covers no more than maxPixelError pixels. pixelsAtUnit is how
+	   many pixels tall something one unit high and one unit away is, that
+	   is viewport height / (2 tan(fov / 2)). boundRadius is getBoundingRadius(). */
+	int selectLOD( VNCMesh *m, float boundRadius, Vec3 eye, float pixelsAtUnit, float maxPixelError ) const
+	{
+		if( !m || m->getNumLODs() <= 1 )
+			return 0;
+
+		float dist = distance( position, eye ) - boundRadius;
+		if( dist <= 0 )
+			return 0;
+
+		float maxScale = max( fabsf(scale.x), max( fabsf(scale.y), fabsf(scale.z) ) );
+		float pixelsPerUnit = pixelsAtUnit * maxScale / dist;
+		for( int level = m->getNumLODs() - 1; level > 0; level-- )
+			if( m->getLODError( level ) * pixelsPerUnit <= maxPixelError )
+				return level;
+		return 0;
+	}
 
-	/* Denotes the 2 points that the box lies between */
-	Point3 box1; /* STILL UNUSED: Used for bounding box collision detection */
-	Point3 box2; 
+	/* True if the sphere (c, r) touches one of the mesh's triangles as it is
+	   drawn. Without a mesh (or before it has loaded) it falls back to a
+	   sphere of radius scale.x around the center. */
+	bool touchesSphere( VNCMesh *m, Vec3 c, float r ) const;
 
-	void generateHitBoxes()
+	/* Nearest point where the ray origin + t*dir (t in (0, maxT)) meets the
+	   mesh as it is drawn. t is in units of dir. */
+	bool raycast( VNCMesh *m, Vec3 origin, Vec3 dir, float maxT, float& t ) const
 	{
+		if( !m || m->getNumFaces() == 0 )
+			return false;
 
+		double rm[9];
+		getRotation( rm );
+		double wo[3] = { origin.x, origin.y, origin.z }, wd[3] = { dir.x, dir.y, dir.z };
+		float lo[3], ld[3];
+		toLocal( rm, wo, lo );
+		toLocal( rm, wd, ld, false );
+
+		int face;
+		return m->getBVH().raycast( lo, ld, maxT, t, face );
+	}
+};
+
+/* Exact test of one mesh triangle, moved into the world, against a world sphere */
+struct WorldSphereVisit
+{
+	const Placement *place;
+	double m[9];
+	float c[3], r;
+
+	bool operator()( const BVHTriangle& t )
+	{
+		float w[3][3];
+		for( int j = 0; j < 3; j++ )
+			place->toWorld( m, t.v[j], w[j] );
+		return sphereTouchesTriangle( c, r, w[0], w[1], w[2] );
 	}
+};
 
-	void drawHitBox()
+inline bool Placement::touchesSphere( VNCMesh *m, Vec3 c, float r ) const
+{
+	if( !m || m->getNumFaces() == 0 )
 	{
-		glutWireSphere(scale.x, 8, 8);
+		float reach = r + scale.x;
+		return distanceSq( c, m ? position + m->getCenter() : position ) < reach * reach;
 	}
 
+	WorldSphereVisit v;
+	v.place = this;
+	getRotation( v.m );
+	v.c[0] = c.x; v.c[1] = c.y; v.c[2] = c.z;
+	v.r = r;
+
+	/* The hierarchy is searched in mesh space with a sphere that covers
+	   the real one, then each triangle is tested exactly in the world */
+	double wc[3] = { c.x, c.y, c.z };
+	float lc[3];
+	toLocal( v.m, wc, lc );
+	double minScale = min( fabs(scale.x), min( fabs(scale.y), fabs(scale.z) ) );
+	if( minScale <= 0 )
+		return false;
+	return m->getBVH().findNearSphere( lc, (float)(r / minScale), v );
+}
+
+/* Every object is it's own Camera => Potentially useful design idea */
+class Object : public Camera
+{
+private:
+	MeshHandle mesh;	/* Shared with every object using the same file, may still be loading */
+	bool isVisible, hitBoxVisible;
+
+	/* getBoundingRadius() for this mesh and scale */
+	VNCMesh *boundMesh;
+	Vec3 boundScale;
+	float boundRadius;
+
+	Placement getPlacement(){ return Placement( position, rotation, scale ); }
+
 public:
 	/* position is inherited from Camera */
-	Vector3 rotation;
-	Vector3 scale;
+	Vec3 rotation;
+	Vec3 scale;
 
 	Object() 
 	{ 
-		Camera(); 
 		hitBoxVisible = false;
-		rotation = Vector3(0,0,0);
-		scale = Vector3(1,1,1); 
+		rotation = Vec3(0,0,0);
+		scale = Vec3(1,1,1); 
 		isVisible = true;  
-		rotationAxis = rnd.RandomInt(0, 6);
+		boundMesh = NULL;
+		boundRadius = 0;
 	};
 
-	Object( VNCMesh &someMesh )
+	Object( const MeshHandle &someMesh )
 	{ 
-		Camera(); 
 		hitBoxVisible = false;
-		rotation = Vector3(0,0,0);
-		scale = Vector3(1,1,1); 
+		rotation = Vec3(0,0,0);
+		scale = Vec3(1,1,1); 
 		isVisible = true;
-		rotationAxis = rnd.RandomInt(0, 5);
+		boundMesh = NULL;
+		boundRadius = 0;
 		setMesh(someMesh); 
 	};
 
 	/* Uses basic spherical collision detection */
-	bool checkCollision( Object obj )
+	bool checkCollision( Object& obj )
 	{
-		Vector3 tk;
-		float length;
-
-		tk.setDiff( getCenter(), obj.getCenter() );
-
-		length = sqrt(tk.x*tk.x + tk.y*tk.y + tk.z*tk.z);
-
-		if( length < (obj.getRadius() + getRadius()) )
-			return true;
-
-		return false;
+		float reach = obj.getRadius() + getRadius();
+		return distanceSq( getCenter(), obj.getCenter() ) < reach * reach;
 	}
 
-	Point3 getCenter()
+	Vec3 getCenter()
 	{ 
-		Point3 cent;
-		if(mesh)
-			cent = mesh->getCenter(); 
-		else
-			cent = Point3(0,0,0);
-
-		cent.x += position.x;
-		cent.y += position.y;
-		cent.z += position.z;
-
-		return cent;
+		VNCMesh *m = mesh.get();
+		return m ? position + m->getCenter() : position;
 	}
 
 	float getRadius()
 	{ 
 		return scale.x; 
 	} /* Scale is uniform right now */
-	
-	void setMesh( VNCMesh &someM )
-	{ 
-		mesh = &someM;
-	}
 
-	void toggleVisible(){ isVisible = !isVisible; }
-	void setVisible(bool bb){ isVisible = bb; }
+	/* See Placement */
+	void getRotation( double m[9] ){ getPlacement().getRotation( m ); }
+	void toWorld( const double m[9], const float local[3], float out[3] ){ getPlacement().toWorld( m, local, out ); }
+	void toLocal( const double m[9], const double world[3], float out[3], bool point = true ){ getPlacement().toLocal( m, world, out, point ); }
+	void getModelMatrix( Mat4& out ){ getPlacement().getModelMatrix( out ); }
 
-	void toggleHitBoxVisible(){ hitBoxVisible = !hitBoxVisible; }
-	void setHitBoxVisible(bool bb){ hitBoxVisible = bb; }
-
-	void draw( Vector3 hitBoxColor = Vector3(1.0f,0,0) )
+	float getBoundingRadius()
 	{
-		if( isVisible ) 
-		{
-			glPushMatrix();
-				glTranslatef( position.x, position.y, position.z );
-				glRotatef( rotation.x, 1.0f, 0.0f, 0.0f );
-				glRotatef( rotation.y, 0.0f, 1.0f, 0.0f );
-				glRotatef( rotation.z, 0.0f, 0.0f, 1.0f );
-
-				if( hitBoxVisible )
-				{
-					glColor3f(hitBoxColor.x, hitBoxColor.y, hitBoxColor.z);
-					drawHitBox();
-				}
-
-				glScalef( scale.x, scale.y, scale.z );
-				glTranslatef( -0.5f, -0.5f, -0.5f );
-				mesh->draw(TRUE);
-			glPopMatrix();
-		}
+		VNCMesh *m = mesh.get();
+		if( !m || m->getNumVerts() == 0 )
+			return getRadius();
+
+		/* Remembered until the scale or mesh changes */
+		if( boundMesh == m && boundScale == scale )
+			return boundRadius;
+		boundMesh = m;
+		boundScale = scale;
+		boundRadius = getPlacement().getBoundingRadius( m );
+		return boundRadius;
 	}
 
-	/* drawBasedOnCamera() draws the objects and uses the rotation that the camera
-	   has done to rotate the object nicely */
-	void drawBasedOnCamera()
+	int selectLOD( Vec3 eye, float pixelsAtUnit, float maxPixelError )
 	{
-		const int LENGTH = 5;
-		//rotation.y = 180*angleBetween( getLookDirection(),Vector3(1,0,0));
-		//rotation.x = -180*angleBetween( getLookDirection(),Vector3(0,1,0));
-		//rotation.z = -180*angleBetween( getUpVector(),Vector3(0,0,1));
-		draw();
-		glPushMatrix();
-			glColor3f( 1,1,1 );
-			glTranslatef( position.x, position.y, position.z );
-			glBegin( GL_LINES );
-				glVertex3f( 0,0,0 );
-				glVertex3f( LENGTH*getLookDirection().x, LENGTH*getLookDirection().y, LENGTH*getLookDirection().z );
-			glEnd();
-		glPopMatrix();
+		return getPlacement().selectLOD( mesh.get(), getBoundingRadius(), eye, pixelsAtUnit, maxPixelError );
 	}
 
-	void doRotation()
-	{
-		switch( rotationAxis )
-		{
-		case 0:
-			rotation.x += 2.0;
-			break;
-		case 1:
-			rotation.y += 1.0; 
-			break;
-		case 2:
-			rotation.z += 1.5; 
-			break;
-		case 3:
-			rotation.x += 0.67;
-			rotation.y += 1.3; 
-			break;
-		case 4:
-			rotation.x += 0.75;
-			rotation.z += 1.1;
-			break;
-		case 5:
-			rotation.y += 3.0;
-			break;
-		default: rotation.x += 1.0;
-		}
+	bool touchesSphere( Vec3 c, float r ){ return getPlacement().touchesSphere( mesh.get(), c, r ); }
+
+	bool raycast( Vec3 origin, Vec3 dir, float maxT, float& t ){ return getPlacement().raycast( mesh.get(), origin, dir, maxT, t ); }
+	
+	void setMesh( const MeshHandle &someM )
+	{ 
+		mesh = someM;
 	}
 
+	/* NULL until the mesh has loaded */
+	VNCMesh *getMesh(){ return mesh.get(); }
+	const MeshHandle& getMeshHandle(){ return mesh; }
+
+	void toggleVisible(){ isVisible = !isVisible; }
+	void setVisible(bool bb){ isVisible = bb; }
+	bool getVisible(){ return isVisible; }
+
+	void toggleHitBoxVisible(){ hitBoxVisible = !hitBoxVisible; }
+	void setHitBoxVisible(bool bb){ hitBoxVisible = bb; }
+	bool getHitBoxVisible(){ return hitBoxVisible; }
+
 	void addRotation( float x, float y, float z )
 	{
 		rotation.x += x;
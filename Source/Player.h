@@ -4,31 +4,13 @@
  * November 16, 2008
  * Phillip Napieralski
  * - Wrote the code
+ *
+ * The hud is drawn by Renderer::drawHud() so the player can be simulated headless.
  */
 
-#include "Universe.h" /* For object class */
-#include "Fonts.h"
-#include <iomanip>
-#include <sstream>
-
-static int   g_screenWidth = 640,
-			 g_screenHeight = 480;
-
-void setProjectionTo2D()
-{
-	glMatrixMode( GL_MODELVIEW );
-	glLoadIdentity();
-
-	glMatrixMode (GL_PROJECTION);
-	glLoadIdentity();
-	gluOrtho2D( (GLdouble)0, (GLdouble)g_screenWidth, 
-		(GLdouble)0, (GLdouble)g_screenHeight );
-}
+#pragma once
 
-void setViewport( int l, int r, int b, int t )
-{
-	glViewport(l, b, r-l, t-b);
-}
+#include "Universe.h" /* For object class */
 
 class Gun : public Object
 {
@@ -45,86 +27,48 @@ public:
 	Bullet();
 };
 
+/* The player's side of a frame, see Counters.h */
+Counter countBadGuysHit( "bad guys hit" );
+Counter countPowerUpsTaken( "power ups taken" );
+Counter countScore( "score", true );
+Counter countFuel( "fuel", true );
+
 class Player : public Object
 {
 private:
-	VNCMesh playerMesh;
-	Font font;
 	float fuel;
 	int score;
 
-	void drawCrosshair()
-	{
-		const float SPACING = 10.0f;
-		int sw = g_screenWidth >> 1; /* faster div by 2 */
-		int sh = g_screenHeight >> 1;
-		
-		glColor3f( 0.6f, 0.6f, 0.6f );
-		glBegin( GL_LINES );
-			glVertex2f( sw, sh + SPACING );
-			glVertex2f( sw, sh - SPACING );
-			glVertex2f( sw + SPACING, sh );
-			glVertex2f( sw - SPACING, sh );
-		glEnd();
-	}
-
-	void drawScore()
-	{
-		setProjectionTo2D();
-	
-		glColor3f( 0.8f, 0.8f, 0.8f );
-
-		/* Draw GUI stuff */
-		ostringstream oss;
-		oss << fixed << setprecision(0) << "Bad guys left: " << NUM_BADGUYS-(score/10) << "    Score: " << score;
-
-		font.draw(50, 50, oss.str() );
-
-		oss.str(""); /* reset it */
-		oss << "Position: (" << position.x << ", " << position.y << ", " << position.z << ") ";
-		
-		font.draw(50, 30, oss.str());
-
-		oss.str(""); /* reset it */
-		if( fuel < 30 )
-			glColor3f(0.95f,0.0f,0.0f);
-		
-		oss << "    Fuel: " << fuel << "%";
-		font.draw(50 + 30*font.width(' '), 50, oss.str());
-		
-	}
-
 public:
 	Player()
 	{
-		playerMesh.read("player.3vnc");
 		Camera();
 		Object();
-		setMesh(playerMesh);
-
-		//font = Font(HELVETICA_18); 
 
 		setDefault(); /* Setup camera */ 
 		fuel = 100; 
 	}
-	
-	void drawHud()
+
+	/* Starts loading the player mesh from dataDir (empty => working dir),
+	   the player has no mesh until it is in */
+	void loadMesh( const string& dataDir = "" )
 	{
-		drawScore();
-		drawCrosshair();
+		setMesh( MeshRegistry::shared().request( dataDir + "player.3vnc", MeshSetup( Vec3(0,0,0), false ) ) );
 	}
 
-	void resetScore(){ score = 0; }
-	void increaseScore( int amt ){ score += amt; }
+	void resetScore(){ score = 0; countScore.set( 0 ); }
+	void increaseScore( int amt ){ score += amt; countScore.set( score ); }
+	int getScore(){ return score; }
 	void increaseFuel( float amt )
 	{ 
 		fuel += amt; 
 		if( fuel > 100 )
 			fuel = 100;
+		countFuel.set( (long long)fuel );
 	}
 
 	float checkFuel(){ return fuel; }
-	void setFuel(float amt){ fuel = amt; }
+	void setFuel(float amt){ fuel = amt; countFuel.set( (long long)fuel ); }
 
 };
 
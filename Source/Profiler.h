@@ -0,0 +1,233 @@
+/* Profiler.h
+ * Scoped timers for seeing where a frame goes. PROFILE_SCOPE( "name" ) at
+ * the top of a block times it from there to the end of the block; while a
+ * recording is running (start() to stop()) each finished scope lands in
+ * its thread's own event log, which only that thread writes, so recording
+ * takes no locks. write() saves a recording as Chrome trace JSON, for
+ * chrome://tracing or ui.perfetto.dev, one track per thread.
+ *
+ * Names must be string literals (only the pointer is kept). Each thread
+ * keeps at most PROFILE_EVENTS events a recording, later ones are counted
+ * as dropped. Building with SHAZAM_NO_PROFILE compiles the scopes out.
+ *
+ * What it costs (ShazamBench profile, -O2, one x64 core under a VM): a
+ * scope adds under half a nanosecond while not recording (one atomic load)
+ * and about 90 ns while recording, nearly all of it the two clock reads
+ * (steady_clock is about 45 ns a read there). A tick records four scopes,
+ * lost in its noise even at 100000 entities.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <memory>
+#include <string>
+#include <cstdio>
+
+using namespace std;
+
+/* thread_local needs VS2015. The older spellings only take plain data
+   with a constant initializer, which is all a thread keeps here or in
+   JobSystem.h. */
+#ifdef _MSC_VER
+#define THREAD_LOCAL __declspec(thread)
+#else
+#define THREAD_LOCAL __thread
+#endif
+
+#define PROFILE_EVENTS (1 << 16) /* per thread and recording */
+
+/* One finished scope, times in nanoseconds since the profiler started */
+struct ProfileEvent
+{
+	const char *name;
+	long long start, duration;
+};
+
+class Profiler
+{
+private:
+	/* A thread's events. Only the thread writes them; count is published
+	   after each event, so anyone reading sees only finished ones. */
+	struct ThreadLog
+	{
+		const char *name;
+		atomic<unsigned> count;
+		atomic<unsigned> dropped;
+		vector<ProfileEvent> events;
+
+		ThreadLog() : name( "thread" ), count( 0 ), dropped( 0 ), events( PROFILE_EVENTS ) {}
+	};
+
+	mutex lock;                        /* guards logs, a thread takes it once, for its first event */
+	vector< unique_ptr<ThreadLog> > logs;
+	atomic<unsigned> recording;        /* the running recording's number, 0 while stopped */
+	unsigned lastRecording;
+	chrono::steady_clock::time_point epoch;
+
+	Profiler( const Profiler& );
+	Profiler& operator=( const Profiler& );
+
+	ThreadLog& threadLog()
+	{
+		static THREAD_LOCAL ThreadLog *log = NULL;
+		if( !log )
+		{
+			lock_guard<mutex> guard( lock );
+			logs.push_back( unique_ptr<ThreadLog>( new ThreadLog() ) );
+			log = logs.back().get();
+		}
+		return *log;
+	}
+
+public:
+	Profiler() : recording( 0 )
+	{
+		lastRecording = 0;
+		epoch = chrono::steady_clock::now();
+	}
+
+	static Profiler& shared()
+	{
+		static Profiler profiler;
+		return profiler;
+	}
+
+	long long now()
+	{
+		return chrono::duration_cast<chrono::nanoseconds>( chrono::steady_clock::now() - epoch ).count();
+	}
+
+	/* The running recording's number, 0 if there is none */
+	unsigned getRecording(){ return recording.load( memory_order_relaxed ); }
+	bool isRecording(){ return getRecording() != 0; }
+
+	/* Drops the last recording and starts a new one. Call it between frames,
+	   not while jobs are recording into the old one. */
+	void start()
+	{
+		lock_guard<mutex> guard( lock );
+		recording = 0;
+		for( size_t i = 0; i < logs.size(); i++ )
+		{
+			logs[i]->count = 0;
+			logs[i]->dropped = 0;
+		}
+		if( ++lastRecording == 0 )
+			lastRecording = 1;
+		recording = lastRecording;
+	}
+
+	/* Scopes still open finish unrecorded */
+	void stop(){ recording = 0; }
+
+	/* Adds a finished scope to the calling thread's log, if the recording
+	   it started in is still running */
+	void record( const char *name, long long start, unsigned startedIn )
+	{
+		long long end = now();
+		if( recording.load( memory_order_relaxed ) != startedIn )
+			return;
+		ThreadLog& log = threadLog();
+		unsigned n = log.count.load( memory_order_relaxed );
+		if( n >= PROFILE_EVENTS )
+		{
+			log.dropped++;
+			return;
+		}
+		ProfileEvent& e = log.events[n];
+		e.name = name;
+		e.start = start;
+		e.duration = end - start;
+		log.count.store( n + 1, memory_order_release );
+	}
+
+	/* Labels the calling thread's track in the trace */
+	void nameThread( const char *name ){ threadLog().name = name; }
+
+	int getNumEvents()
+	{
+		lock_guard<mutex> guard( lock );
+		int n = 0;
+		for( size_t i = 0; i < logs.size(); i++ )
+			n += (int)logs[i]->count.load( memory_order_acquire );
+		return n;
+	}
+
+	int getNumDropped()
+	{
+		lock_guard<mutex> guard( lock );
+		int n = 0;
+		for( size_t i = 0; i < logs.size(); i++ )
+			n += (int)logs[i]->dropped.load();
+		return n;
+	}
+
+	/* Saves the events recorded so far as Chrome trace JSON, false if the
+	   file could not be written. Best after stop(). */
+	bool write( const string& path )
+	{
+		FILE *f = fopen( path.c_str(), "w" );
+		if( !f )
+			return false;
+
+		lock_guard<mutex> guard( lock );
+		fprintf( f, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n" );
+		bool first = true;
+		for( size_t t = 0; t < logs.size(); t++ )
+		{
+			ThreadLog& log = *logs[t];
+			fprintf( f, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+				first ? "" : ",\n", (int)t, log.name );
+			first = false;
+
+			unsigned n = log.count.load( memory_order_acquire );
+			for( unsigned i = 0; i < n; i++ )
+			{
+				const ProfileEvent& e = log.events[i];
+				fprintf( f, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+					e.name, (int)t, e.start / 1000.0, e.duration / 1000.0 );
+			}
+		}
+		fprintf( f, "\n]}\n" );
+		return fclose( f ) == 0;
+	}
+};
+
+/* Times from here to the end of the enclosing block, see PROFILE_SCOPE */
+class ProfileScope
+{
+private:
+	const char *name;
+	long long start;
+	unsigned startedIn;
+
+public:
+	ProfileScope( const char *scopeName )
+	{
+		Profiler& p = Profiler::shared();
+		name = scopeName;
+		startedIn = p.getRecording();
+		start = startedIn ? p.now() : 0;
+	}
+
+	~ProfileScope()
+	{
+		if( startedIn )
+			Profiler::shared().record( name, start, startedIn );
+	}
+};
+
+#define PROFILE_JOIN2( a, b ) a##b
+#define PROFILE_JOIN( a, b ) PROFILE_JOIN2( a, b )
+
+#ifdef SHAZAM_NO_PROFILE
+#define PROFILE_SCOPE( name )
+#define PROFILE_THREAD( name )
+#else
+#define PROFILE_SCOPE( name ) ProfileScope PROFILE_JOIN( profileScope, __LINE__ )( name )
+#define PROFILE_THREAD( name ) Profiler::shared().nameThread( name ) /* names the calling thread's track */
+#endif
@@ -8,25 +8,49 @@
 []____________________________________________________________________________[]
 */
 
+/* The interface is the original one; underneath, each Random is now its own
+ * xoshiro256** generator rather than a window onto rand(), with no global
+ * state and no reseeding from time(). A generator is seeded explicitly
+ * (SplitMix64 spreads the seed over the state) and the same seed gives the
+ * same numbers on every compiler, unlike rand(), whose RAND_MAX is 32767 on
+ * some. The stream argument picks one of 2^128 non-overlapping runs of the
+ * sequence for that seed, so subsystems can each draw from their own without
+ * one's draws moving another's. fill() hands out many numbers at once, for
+ * generating in bulk.
+ */
+
 #pragma once
 
 #include <climits>
-#include <ctime>
 
 #ifndef _RANDOM
 #define _RANDOM
 
+#define RANDOM_DEFAULT_SEED 0x5348415aULL /* what a Random made without a seed starts from */
+
 class Random
 {
 public:
 	Random();
-	// Initializes the generator.
+	// Initializes the generator, always with the same seed.
+
+	Random(unsigned long long seed, unsigned stream = 0);
+	// Initializes the generator from seed, on one of its streams.
+
+	void Seed(unsigned long long seed, unsigned stream = 0);
+	// Starts the generator over from seed, on one of its streams.
+
+	unsigned long long Next();
+	// Returns 64 random bits.
 
 	double RandomNum();
-	// Returns a random number between 0.0 and 1.0.
+	// Returns a random number between 0.0 and 1.0 (never 1.0).
+
+	float RandomFloat();
+	// Returns a random float between 0.0 and 1.0 (never 1.0).
 
 	int RandomInt();
-	// Returns a random integer between 0 and RAND_MAX.
+	// Returns a random integer between 0 and RandomMax().
 
 	int RandomInt(int n);
 	// Precondition: n > 0;
@@ -40,34 +64,118 @@ public:
 	// Returns the largest random integer that the
 	// generator can produce.
 
+	void fill(int *out, int count, int min, int max);
+	// Precondition: max >= min;
+	// Fills out with count random integers between min and max.
+
+	void fill(float *out, int count, float lo, float hi);
+	// Fills out with count random floats between lo and hi.
+
 private:
-	void Seed();
+	unsigned long long s[4];
+
+	static unsigned long long rotl(unsigned long long x, int k)
+	{ return (x << k) | (x >> (64 - k)); }
+
+	unsigned Below(unsigned range);
+	void Jump();
 };
 
-Random::Random() { Seed(); }
+Random::Random() { Seed(RANDOM_DEFAULT_SEED); }
+
+Random::Random(unsigned long long seed, unsigned stream) { Seed(seed, stream); }
+
+void Random::Seed(unsigned long long seed, unsigned stream)
+{
+	/* SplitMix64, so that similar seeds give unrelated states */
+	for (int i = 0; i < 4; i++)
+	{
+		unsigned long long z = (seed += 0x9e3779b97f4a7c15ULL);
+		z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+		z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+		s[i] = z ^ (z >> 31);
+	}
+	for (unsigned k = 0; k < stream; k++)
+		Jump();
+}
+
+unsigned long long Random::Next()
+{
+	unsigned long long result = rotl(s[1] * 5, 7) * 9;
+	unsigned long long t = s[1] << 17;
+	s[2] ^= s[0];
+	s[3] ^= s[1];
+	s[1] ^= s[2];
+	s[0] ^= s[3];
+	s[2] ^= t;
+	s[3] = rotl(s[3], 45);
+	return result;
+}
+
+/* As far along as 2^128 calls to Next(), the start of the next stream */
+void Random::Jump()
+{
+	static const unsigned long long JUMP[4] = { 0x180ec6d33cfd0abaULL, 0xd5a61266f0c9392cULL,
+		0xa9582618e03fc9aaULL, 0x39abdc4529b1661cULL };
+	unsigned long long t[4] = { 0, 0, 0, 0 };
+	for (int i = 0; i < 4; i++)
+		for (int b = 0; b < 64; b++)
+		{
+			if (JUMP[i] & (1ULL << b))
+				for (int k = 0; k < 4; k++)
+					t[k] ^= s[k];
+			Next();
+		}
+	for (int k = 0; k < 4; k++)
+		s[k] = t[k];
+}
 
 double Random::RandomNum()
-{ return rand() / double(RAND_MAX); }
+{ return (Next() >> 11) * (1.0 / 9007199254740992.0); }
+
+float Random::RandomFloat()
+{ return (Next() >> 40) * (1.0f / 16777216.0f); }
 
 int Random::RandomInt()
-{ return rand(); }
+{ return (int)(Next() >> 33); }
+
+/* Uniform in [0, range) without modulo bias, Lemire's multiply and reject.
+   range 0 stands for 2^32. */
+unsigned Random::Below(unsigned range)
+{
+	if (range == 0)
+		return (unsigned)(Next() >> 32);
+	unsigned long long m = (Next() >> 32) * range;
+	if ((unsigned)m < range)
+	{
+		unsigned floor = (0u - range) % range;
+		while ((unsigned)m < floor)
+			m = (Next() >> 32) * range;
+	}
+	return (unsigned)(m >> 32);
+}
 
 int Random::RandomInt(int n)
-{ return rand() % n; }
+{ return (int)Below((unsigned)n); }
 
 int Random::RandomInt(int min, int max)
-{ return min + int(RandomNum() * (max - min + 1)); }
+{ return (int)((unsigned)min + Below((unsigned)max - (unsigned)min + 1u)); }
 
 int Random::RandomMax()
-{ return RAND_MAX; }
+{ return INT_MAX; }
 
-void Random::Seed()
+void Random::fill(int *out, int count, int min, int max)
 {
-	time_t seconds;
+	unsigned range = (unsigned)max - (unsigned)min + 1u;
+	for (int i = 0; i < count; i++)
+		out[i] = (int)((unsigned)min + Below(range));
+}
 
-	time(&seconds);
-	srand(seconds);
-	rand();
+void Random::fill(float *out, int count, float lo, float hi)
+{
+	float span = hi - lo;
+	for (int i = 0; i < count; i++)
+		out[i] = lo + RandomFloat() * span;
 }
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,995 @@
+/* Renderer.h
+ * Everything that turns the simulation into OpenGL calls. The game classes
+ * (Camera, Object, VNCMesh, Universe, Player) only hold state; this is the one
+ * place that knows about GLUT and GL, so a headless build can leave it out.
+ */
+
+#pragma once
+
+#include "glut.h" /* pulls in windows.h, gl.h and glu.h */
+#include "Simulation.h"
+#include "Frustum.h"
+#include "Fonts.h"
+#include "FrameTimes.h"
+#include <iomanip>
+#include <sstream>
+#include <set>
+
+static int   g_screenWidth = 640,
+			 g_screenHeight = 480;
+
+void setProjectionTo2D()
+{
+	glMatrixMode( GL_MODELVIEW );
+	glLoadIdentity();
+
+	glMatrixMode (GL_PROJECTION);
+	glLoadIdentity();
+	gluOrtho2D( (GLdouble)0, (GLdouble)g_screenWidth,
+		(GLdouble)0, (GLdouble)g_screenHeight );
+}
+
+void setViewport( int l, int r, int b, int t )
+{
+	glViewport(l, b, r-l, t-b);
+}
+
+#define OOB_GRID_SPACING 25
+#define MAX_GRID_LISTS   4 /* grid sizes kept compiled, two are in use at a time */
+
+#define OVERLAY_BUDGET_MS   (1000.0f / 60) /* a frame at 60 Hz, the overlay's reference line */
+#define OVERLAY_HEIGHT      40              /* sparkline pixels, twice the budget fills it */
+
+#define DRAW_UNLOADED    -1 /* drawInstanced() levels for entities it skips */
+#define DRAW_CULLED      -2
+
+/* One grid line, ends in a fixed order so a line drawn twice compares equal */
+struct GridLine
+{
+	int p[6];
+
+	GridLine( int a[3], int b[3] )
+	{
+		bool swap = lexicographical_compare( b, b + 3, a, a + 3 );
+		for( int k = 0; k < 3; k++ )
+		{
+			p[k] = swap ? b[k] : a[k];
+			p[3 + k] = swap ? a[k] : b[k];
+		}
+	}
+
+	bool operator<( const GridLine& l ) const { return lexicographical_compare( p, p + 6, l.p, l.p + 6 ); }
+};
+
+/* The lines of Renderer::drawOOBGrid3DImmediate() for a grid of this size,
+   moved into place and with the edges faces share kept once, as GL_LINES
+   vertex pairs (x, y, z floats) */
+void buildOOBGrid( int size, vector<float>& verts )
+{
+	set<GridLine> lines;
+	int s = size;
+
+	/* The four faces that are turned about x by the running total of 90*k
+	   degrees (0, 90, 270, 180), then the two x faces at the last of them */
+	int turns[5] = { 0, 1, 3, 2, 2 };
+	for( int f = 0; f < 5; f++ )
+	{
+		for( int i = 0; i <= 2*s; i += OOB_GRID_SPACING )
+		{
+			int ends[6][2][3];
+			int count = 0;
+			if( f < 4 )
+			{
+				int e[2][2][3] = { { { -s + i, s, -s }, { -s + i, -s, -s } },
+				                   { { s, -s + i, -s }, { -s, -s + i, -s } } };
+				memcpy( ends, e, sizeof(e) );
+				count = 2;
+			}
+			else
+			{
+				for( int x = 0; x < 2; x++ )
+				{
+					int sx = x ? s : -s;
+					int e[2][2][3] = { { { sx, s, -s + i }, { sx, -s, -s + i } },
+					                   { { sx, -s + i, s }, { sx, -s + i, -s } } };
+					memcpy( ends[count], e, sizeof(e) );
+					count += 2;
+				}
+			}
+
+			for( int l = 0; l < count; l++ )
+			{
+				for( int e = 0; e < 2; e++ )
+				{
+					/* Quarter turns about x: (y, z) -> (-z, y) */
+					for( int t = 0; t < turns[f]; t++ )
+					{
+						int y = ends[l][e][1];
+						ends[l][e][1] = -ends[l][e][2];
+						ends[l][e][2] = y;
+					}
+				}
+				lines.insert( GridLine( ends[l][0], ends[l][1] ) );
+			}
+		}
+	}
+
+	verts.clear();
+	verts.reserve( lines.size() * 6 );
+	for( set<GridLine>::iterator it = lines.begin(); it != lines.end(); ++it )
+		for( int k = 0; k < 6; k++ )
+			verts.push_back( (float)it->p[k] );
+}
+
+/* What the renderer handed to GL since the last reset, to compare drawing paths */
+struct RenderStats
+{
+	int drawCalls;  /* glBegin/glEnd pairs and glDrawElements calls */
+	int vertices;   /* vertices submitted, indices for batched meshes */
+	int triangles;  /* filled mesh triangles, polygons count as their fan */
+	int stateChanges; /* calls setting up draws rather than making them: arrays, matrices, colors, textures */
+
+	/* What frustum culling let through and what it skipped */
+	int objectsVisible, objectsCulled;
+	int starBlocksVisible, starBlocksCulled;
+
+	RenderStats(){ reset(); }
+	void reset()
+	{
+		drawCalls = vertices = triangles = stateChanges = 0;
+		objectsVisible = objectsCulled = starBlocksVisible = starBlocksCulled = 0;
+	}
+
+	void add( const RenderStats& s )
+	{
+		drawCalls += s.drawCalls;
+		vertices += s.vertices;
+		triangles += s.triangles;
+		stateChanges += s.stateChanges;
+		objectsVisible += s.objectsVisible;
+		objectsCulled += s.objectsCulled;
+		starBlocksVisible += s.starBlocksVisible;
+		starBlocksCulled += s.starBlocksCulled;
+	}
+};
+
+/* What a frame sent to GL, see Counters.h. Shazam adds the frame's
+   RenderStats to them once it is drawn. */
+Counter countDrawCalls( "draw calls" );
+Counter countVertices( "vertices" );
+Counter countTriangles( "triangles" );
+Counter countStateChanges( "gl state changes" );
+Counter countObjectsDrawn( "objects drawn" );
+Counter countObjectsCulled( "objects culled" );
+Counter countStarBlocksDrawn( "star blocks drawn" );
+Counter countStarBlocksCulled( "star blocks culled" );
+Counter countHudBytes( "hud bytes formatted" );
+
+void countRenderStats( const RenderStats& s )
+{
+	countDrawCalls.add( s.drawCalls );
+	countVertices.add( s.vertices );
+	countTriangles.add( s.triangles );
+	countStateChanges.add( s.stateChanges );
+	countObjectsDrawn.add( s.objectsVisible );
+	countObjectsCulled.add( s.objectsCulled );
+	countStarBlocksDrawn.add( s.starBlocksVisible );
+	countStarBlocksCulled.add( s.starBlocksCulled );
+}
+
+/* A rectangle of the screen kept in a texture (GL 1.1 glCopyTexSubImage2D,
+   no extensions), so it can be put back on later frames without drawing
+   what is in it again. See Renderer::captureView()/drawCachedView(). */
+class CachedView
+{
+public:
+	GLuint texture;
+	int texWidth, texHeight; /* powers of two, GL 1.1 needs them */
+	int width, height;       /* of the last capture, 0 until there is one */
+
+	CachedView(){ texture = 0; texWidth = texHeight = width = height = 0; }
+
+	bool isValid( int w, int h ){ return texture != 0 && width == w && height == h; }
+	void invalidate(){ width = height = 0; }
+};
+
+class Renderer
+{
+private:
+	Font font;
+	RenderStats stats;
+	bool batching;
+	bool instancing;
+	vector<InstanceBatch> instanceBatches; /* one per mesh (and level) drawn instanced, reused every frame */
+
+	/* drawInstanced() scratch, per entity: the level to draw (or why not) and its modelview */
+	vector<int> drawLevels;
+	vector<Mat4> drawTransforms;
+	JobSystem *jobs;
+
+	/* How far the frame is between the last two simulation ticks, entities
+	   are drawn turned that far (see setTickAlpha()) */
+	float tickAlpha;
+
+	/* Objects and star blocks outside the camera's view are skipped unless this is off */
+	bool culling;
+	Frustum frustum; /* from the last applyView() */
+
+	/* The stars compiled into display lists, two per StarBlock, so GL keeps
+	   them after one upload */
+	GLuint starLists;
+	int starListBlocks;
+	unsigned starListVersion; /* Universe::getStarsVersion() the lists hold */
+	int starListDivisor;      /* sparseStarDivisor the lists were split for */
+
+	/* Passes with sparse stars on draw one star in sparseStarDivisor */
+	bool sparseStars;
+	int sparseStarDivisor;
+	vector<GLuint> visibleStarLists; /* scratch for glCallLists() */
+
+	/* drawOOBGrid3D() display lists, one per size, most recently built last */
+	struct GridList
+	{
+		int size;
+		GLuint list;
+		int vertices;
+	};
+	vector<GridList> grids;
+
+	/* Level of detail selection, from the last applyProjection/applyView/applyViewport */
+	bool lod;
+	float lodPixelError; /* how far (in pixels) a level may be off to be used */
+	Vec3 eye;
+	float fieldOfView;
+	int viewportHeight;
+
+	/* One glBegin/glEnd per face, used for wireframes and for comparison */
+	void drawMeshImmediate( VNCMesh& mesh, bool filled )
+	{
+		for(int f = 0; f < mesh.getNumFaces(); f++)
+		{  // Draw each face.
+			if (filled) glColor3fv(mesh.getFaceColor(f));
+			glBegin(filled ? GL_POLYGON : GL_LINE_LOOP);
+				for(int v = 0; v < mesh.getFaceSize(f); v++)
+				{
+					Vec3 norm = mesh.getNormal( mesh.getFaceNormIndex(f, v) );
+					Vec3 pt = mesh.getVertex( mesh.getFaceVertIndex(f, v) );
+					glNormal3f(norm.x, norm.y, norm.z);
+					glVertex3f(pt.x, pt.y, pt.z);
+				}
+			glEnd();
+
+			stats.drawCalls++;
+			stats.vertices += mesh.getFaceSize(f);
+			if (filled) stats.triangles += mesh.getFaceSize(f) - 2;
+			if (filled) stats.stateChanges++;
+		}
+	}
+
+	/* A whole mesh (or one of its levels of detail) in one call */
+	void drawMeshBatch( const MeshBatch& batch )
+	{
+		if( batch.empty() )
+			return;
+
+		const BatchVertex *v = &batch.vertices[0];
+		glEnableClientState( GL_VERTEX_ARRAY );
+		glEnableClientState( GL_NORMAL_ARRAY );
+		glEnableClientState( GL_COLOR_ARRAY );
+		glVertexPointer( 3, GL_FLOAT, sizeof(BatchVertex), v->pos );
+		glNormalPointer( GL_FLOAT, sizeof(BatchVertex), v->norm );
+		glColorPointer( 3, GL_FLOAT, sizeof(BatchVertex), v->color );
+
+		glDrawElements( GL_TRIANGLES, (GLsizei)batch.indices.size(), GL_UNSIGNED_INT, &batch.indices[0] );
+
+		glDisableClientState( GL_COLOR_ARRAY );
+		glDisableClientState( GL_NORMAL_ARRAY );
+		glDisableClientState( GL_VERTEX_ARRAY );
+
+		stats.drawCalls++;
+		stats.vertices += (int)batch.indices.size();
+		stats.triangles += batch.getNumTriangles();
+		stats.stateChanges += 9; /* the arrays enabled, pointed and disabled */
+	}
+
+	/* The InstanceBatch collecting copies of mesh this frame */
+	InstanceBatch& instancesOf( const MeshBatch& mesh )
+	{
+		for( size_t i = 0; i < instanceBatches.size(); i++ )
+			if( instanceBatches[i].getMesh() == &mesh )
+				return instanceBatches[i];
+		instanceBatches.push_back( InstanceBatch( mesh ) );
+		return instanceBatches.back();
+	}
+
+	/* Every copy in batch off one binding of the mesh's arrays */
+	void drawInstanceBatch( InstanceBatch& batch )
+	{
+		const MeshBatch& mesh = *batch.getMesh();
+		if( batch.getNumInstances() == 0 || mesh.empty() )
+		{
+			batch.clear();
+			return;
+		}
+
+		const BatchVertex *v = &mesh.vertices[0];
+		GLsizei count = (GLsizei)mesh.indices.size();
+		glEnableClientState( GL_VERTEX_ARRAY );
+		glEnableClientState( GL_NORMAL_ARRAY );
+		glEnableClientState( GL_COLOR_ARRAY );
+		glVertexPointer( 3, GL_FLOAT, sizeof(BatchVertex), v->pos );
+		glNormalPointer( GL_FLOAT, sizeof(BatchVertex), v->norm );
+		glColorPointer( 3, GL_FLOAT, sizeof(BatchVertex), v->color );
+
+		for( int i = 0; i < batch.getNumInstances(); i++ )
+		{
+			glLoadMatrixf( batch.getMatrix( i ) );
+			glDrawElements( GL_TRIANGLES, count, GL_UNSIGNED_INT, &mesh.indices[0] );
+		}
+
+		glDisableClientState( GL_COLOR_ARRAY );
+		glDisableClientState( GL_NORMAL_ARRAY );
+		glDisableClientState( GL_VERTEX_ARRAY );
+
+		stats.drawCalls += batch.getNumInstances();
+		stats.vertices += count * batch.getNumInstances();
+		stats.triangles += mesh.getNumTriangles() * batch.getNumInstances();
+		stats.stateChanges += 9 + batch.getNumInstances(); /* the arrays once, a matrix load per copy */
+		batch.clear();
+	}
+
+	/* Hit boxes are green for power ups and red for everything else */
+	static Vec3 hitBoxColor( int type )
+	{
+		return type == OBJECT_POWERUP ? Vec3( 0,1.0f,0 ) : Vec3( 1.0f,0,0 );
+	}
+
+	/* An entity's hit box, drawn where drawObject() would draw it for an Object */
+	void drawEntityHitBox( EntityStore& entities, int i )
+	{
+		Vec3 p = entities.position[i], r = entities.getRotationBetweenTicks( i, tickAlpha ), c = hitBoxColor( entities.type[i] );
+		glPushMatrix();
+			glTranslatef( p.x, p.y, p.z );
+			glRotatef( r.x, 1.0f, 0.0f, 0.0f );
+			glRotatef( r.y, 0.0f, 1.0f, 0.0f );
+			glRotatef( r.z, 0.0f, 0.0f, 1.0f );
+			glColor3f( c.x, c.y, c.z );
+			glutWireSphere( entities.scale[i].x, 8, 8 );
+		glPopMatrix();
+		stats.stateChanges += 7;
+	}
+
+	/* drawEntity() for every entity at once: the modelview matrix of each is
+	   worked out up front into one InstanceBatch per mesh (and level of
+	   detail), then each batch is drawn in one go. Hit boxes are still
+	   drawn one by one. */
+	void drawInstanced( EntityStore& entities )
+	{
+		float pixelsAtUnit = viewportHeight / (2.0f * tanf( fieldOfView * (float)RADIANS_PER_DEGREE / 2 ));
+		Mat4 view;
+		glGetFloatv( GL_MODELVIEW_MATRIX, view.m );
+		bool hitBoxes = entities.getHitBoxesVisible();
+
+		/* Culling, picking levels and building the modelview matrices only
+		   read the store, so they are split across the pool. Handing the
+		   results to the batches stays in entity order, as before. */
+		int n = entities.size();
+		drawLevels.resize( n );
+		drawTransforms.resize( n );
+		jobs->parallelFor( 0, n, TRANSFORM_GRAIN, [&]( int lo, int hi )
+		{
+			Mat4 model;
+			for( int i = lo; i < hi; i++ )
+			{
+				VNCMesh *mesh = entities.getMesh( i ); /* NULL while it is still loading */
+				if( !mesh )
+					drawLevels[i] = DRAW_UNLOADED;
+				else if( !visible( entities, i ) )
+					drawLevels[i] = DRAW_CULLED;
+				else
+				{
+					drawLevels[i] = lod ? entities.selectLOD( i, eye, pixelsAtUnit, lodPixelError ) : 0;
+					entities.getModelMatrix( i, tickAlpha, model );
+					Mat4::mul( view, model, drawTransforms[i] );
+				}
+			}
+		} );
+
+		for( int i = 0; i < n; i++ )
+		{
+			int level = drawLevels[i];
+			if( level == DRAW_UNLOADED )
+				continue;
+			if( level == DRAW_CULLED )
+			{
+				stats.objectsCulled++;
+				continue;
+			}
+			stats.objectsVisible++;
+			instancesOf( entities.getMesh( i )->getLOD( level ) ).add( drawTransforms[i] );
+
+			if( hitBoxes )
+				drawEntityHitBox( entities, i );
+		}
+
+		glPushMatrix();
+		for( size_t i = 0; i < instanceBatches.size(); i++ )
+			drawInstanceBatch( instanceBatches[i] );
+		glPopMatrix();
+		stats.stateChanges += 2;
+	}
+
+	void drawHitBox( Object& obj )
+	{
+		glutWireSphere(obj.scale.x, 8, 8);
+	}
+
+	void drawCrosshair( bool onTarget )
+	{
+		const float SPACING = 10.0f;
+		int sw = g_screenWidth >> 1; /* faster div by 2 */
+		int sh = g_screenHeight >> 1;
+
+		if( onTarget )
+			glColor3f( 1.0f, 0.2f, 0.2f );
+		else
+			glColor3f( 0.6f, 0.6f, 0.6f );
+		glBegin( GL_LINES );
+			glVertex2f( sw, sh + SPACING );
+			glVertex2f( sw, sh - SPACING );
+			glVertex2f( sw + SPACING, sh );
+			glVertex2f( sw - SPACING, sh );
+		glEnd();
+	}
+
+	void drawScore( Player& player )
+	{
+		setProjectionTo2D();
+
+		glColor3f( 0.8f, 0.8f, 0.8f );
+
+		/* Draw GUI stuff */
+		ostringstream oss;
+		oss << fixed << setprecision(0) << "Bad guys left: " << NUM_BADGUYS-(player.getScore()/10) << "    Score: " << player.getScore();
+
+		font.draw(50, 50, oss.str() );
+		countHudBytes.add( oss.str().size() );
+
+		oss.str(""); /* reset it */
+		oss << "Position: (" << player.position.x << ", " << player.position.y << ", " << player.position.z << ") ";
+
+		font.draw(50, 30, oss.str());
+		countHudBytes.add( oss.str().size() );
+
+		oss.str(""); /* reset it */
+		if( player.checkFuel() < 30 )
+			glColor3f(0.95f,0.0f,0.0f);
+
+		oss << "    Fuel: " << player.checkFuel() << "%";
+		font.draw(50 + 30*font.width(' '), 50, oss.str());
+		countHudBytes.add( oss.str().size() );
+
+	}
+
+public:
+	Renderer()
+	{
+		batching = lod = instancing = true;
+		culling = true;
+		starLists = 0;
+		starListBlocks = 0;
+		starListDivisor = 0;
+		sparseStars = false;
+		sparseStarDivisor = 4;
+		lodPixelError = LOD_PIXEL_ERROR;
+		starListVersion = 0;
+		fieldOfView = 60;
+		viewportHeight = g_screenHeight;
+		jobs = &JobSystem::shared();
+		tickAlpha = 1;
+	}
+
+	/* Filled meshes go through their MeshBatch unless this is turned off */
+	void setBatching( bool on ){ batching = on; }
+	bool getBatching(){ return batching; }
+
+	/* Far away objects use simpler meshes unless this is turned off (needs batching) */
+	void setLOD( bool on ){ lod = on; }
+	bool getLOD(){ return lod; }
+
+	/* Screen error allowed when picking levels of detail, LOD_PIXEL_ERROR by
+	   default. Small or unimportant views can afford a coarser setting. */
+	void setLODPixelError( float pixels ){ lodPixelError = pixels; }
+	float getLODPixelError(){ return lodPixelError; }
+
+	/* With sparse on drawStars() draws one star in divisor (see setStarDivisor) */
+	void setSparseStars( bool sparse ){ sparseStars = sparse; }
+	bool getSparseStars(){ return sparseStars; }
+	void setStarDivisor( int divisor ){ sparseStarDivisor = divisor < 1 ? 1 : divisor; }
+	int getStarDivisor(){ return sparseStarDivisor; }
+
+	/* Populations of objects go through InstanceBatches unless this is turned off (needs batching) */
+	void setInstancing( bool on ){ instancing = on; }
+	bool getInstancing(){ return instancing; }
+
+	/* Skips objects and stars outside the camera's view unless this is turned off */
+	void setCulling( bool on ){ culling = on; }
+	bool getCulling(){ return culling; }
+
+	/* Entities are drawn alpha of the way (0 to 1, TickClock::getAlpha())
+	   from the tick before the last to the last one. 1 by default, which
+	   draws them as the last tick left them. */
+	void setTickAlpha( float alpha ){ tickAlpha = alpha; }
+	float getTickAlpha(){ return tickAlpha; }
+
+	/* The pool drawInstanced() builds transforms on, JobSystem::shared() by default */
+	void setJobs( JobSystem& js ){ jobs = &js; }
+
+	RenderStats& getStats(){ return stats; }
+	void resetStats(){ stats.reset(); }
+
+	/* Loads the camera's view volume into the projection matrix */
+	void applyProjection( Camera& cam )
+	{
+		float vAng, asp, nearD, farD;
+		cam.getShape( vAng, asp, nearD, farD );
+		fieldOfView = vAng;
+
+		glMatrixMode(GL_PROJECTION);
+		glLoadIdentity();
+		gluPerspective( vAng, asp, nearD, farD );
+	}
+
+	/* Loads the camera's position and orientation into the modelview matrix */
+	void applyView( Camera& cam )
+	{
+		float m[16];
+		cam.getModelViewMatrix( m );
+		eye = cam.getPosition();
+		frustum.set( cam );
+
+		glMatrixMode(GL_MODELVIEW);
+		glLoadMatrixf(m); // load OpenGL's modelview matrix
+	}
+
+	/* setViewport() that also remembers the height for level of detail */
+	void applyViewport( int l, int r, int b, int t )
+	{
+		setViewport( l, r, b, t );
+		viewportHeight = t - b;
+	}
+
+	void drawMesh( VNCMesh& mesh, bool filled = false )
+	{
+		if( filled && batching )
+			drawMeshBatch( mesh.getBatch() );
+		else
+			drawMeshImmediate( mesh, filled );
+	}
+
+	void drawObject( Object& obj, Vec3 hitBoxColor = Vec3(1.0f,0,0) )
+	{
+		if( obj.getVisible() )
+		{
+			glPushMatrix();
+				glTranslatef( obj.position.x, obj.position.y, obj.position.z );
+				glRotatef( obj.rotation.x, 1.0f, 0.0f, 0.0f );
+				glRotatef( obj.rotation.y, 0.0f, 1.0f, 0.0f );
+				glRotatef( obj.rotation.z, 0.0f, 0.0f, 1.0f );
+
+				if( obj.getHitBoxVisible() )
+				{
+					glColor3f(hitBoxColor.x, hitBoxColor.y, hitBoxColor.z);
+					drawHitBox( obj );
+				}
+
+				glScalef( obj.scale.x, obj.scale.y, obj.scale.z );
+				glTranslatef( -0.5f, -0.5f, -0.5f );
+				VNCMesh *mesh = obj.getMesh(); /* NULL while it is still loading */
+				if( !mesh )
+					;
+				else if( lod && batching )
+				{
+					float pixelsAtUnit = viewportHeight / (2.0f * tanf( fieldOfView * (float)RADIANS_PER_DEGREE / 2 ));
+					drawMeshBatch( mesh->getLOD( obj.selectLOD( eye, pixelsAtUnit, lodPixelError ) ) );
+				}
+				else
+					drawMesh( *mesh, true );
+			glPopMatrix();
+			stats.stateChanges += obj.getHitBoxVisible() ? 9 : 8;
+		}
+	}
+
+	/* drawObject() for entity i */
+	void drawEntity( EntityStore& entities, int i )
+	{
+		if( entities.getHitBoxesVisible() )
+			drawEntityHitBox( entities, i );
+
+		VNCMesh *mesh = entities.getMesh( i ); /* NULL while it is still loading */
+		if( !mesh )
+			return;
+
+		Vec3 p = entities.position[i], r = entities.getRotationBetweenTicks( i, tickAlpha ), sc = entities.scale[i];
+		glPushMatrix();
+			glTranslatef( p.x, p.y, p.z );
+			glRotatef( r.x, 1.0f, 0.0f, 0.0f );
+			glRotatef( r.y, 0.0f, 1.0f, 0.0f );
+			glRotatef( r.z, 0.0f, 0.0f, 1.0f );
+			glScalef( sc.x, sc.y, sc.z );
+			glTranslatef( -0.5f, -0.5f, -0.5f );
+			if( lod && batching )
+			{
+				float pixelsAtUnit = viewportHeight / (2.0f * tanf( fieldOfView * (float)RADIANS_PER_DEGREE / 2 ));
+				drawMeshBatch( mesh->getLOD( entities.selectLOD( i, eye, pixelsAtUnit, lodPixelError ) ) );
+			}
+			else
+				drawMesh( *mesh, true );
+		glPopMatrix();
+		stats.stateChanges += 8;
+	}
+
+	/* drawObjectBasedOnCamera() draws the object and a line showing where it is looking */
+	void drawObjectBasedOnCamera( Object& obj )
+	{
+		const int LENGTH = 5;
+		Vec3 look = obj.getLookDirection();
+		drawObject( obj );
+		glPushMatrix();
+			glColor3f( 1,1,1 );
+			glTranslatef( obj.position.x, obj.position.y, obj.position.z );
+			glBegin( GL_LINES );
+				glVertex3f( 0,0,0 );
+				glVertex3f( LENGTH*look.x, LENGTH*look.y, LENGTH*look.z );
+			glEnd();
+		glPopMatrix();
+	}
+
+	/* The grid as it was always drawn, four faces turned into place around x
+	   and then the two x faces. Left in for comparison (batching off). */
+	void drawOOBGrid3DImmediate( int size )
+	{
+		glPushMatrix();
+		Vec3 start(-size,-size,-size);
+		Vec3 end(size,size,size);
+		const float SPACING = (float)OOB_GRID_SPACING;
+		int lines = 2*size / (int)SPACING + 1;
+
+
+		for( int k = 0; k < 4; k++)
+		{
+		glRotatef( 90*k, 1, 0, 0 );
+			glPushMatrix();
+			glBegin( GL_LINES );
+				for( int i = 0; i <= 2*size; i+= SPACING )
+				{
+					glVertex3f( start.x + i, start.y + 2*size, start.z ); /* xz plane */
+					glVertex3f( start.x + i, start.y, start.z );
+					glVertex3f( start.x + 2*size, start.y + i, start.z);
+					glVertex3f( start.x, start.y + i, start.z);
+				}
+			glEnd();
+			glPopMatrix();
+			stats.drawCalls++;
+			stats.vertices += 4*lines;
+		}
+
+		glPushMatrix();
+		glBegin( GL_LINES );
+			for( int i = 0; i <= 2*size; i+= SPACING )
+			{
+					glVertex3f( start.x , start.y + 2*size, start.z + i );
+					glVertex3f( start.x, start.y, start.z + i );
+					glVertex3f( start.x , start.y + i, start.z + 2*size );
+					glVertex3f( start.x, start.y + i, start.z );
+
+					glVertex3f( start.x+2*size, start.y + 2*size, start.z + i );
+					glVertex3f( start.x+2*size, start.y, start.z + i );
+					glVertex3f( start.x+2*size, start.y + i, start.z + 2*size );
+					glVertex3f( start.x+2*size, start.y + i, start.z );
+			}
+		glEnd();
+		glPopMatrix();
+		stats.drawCalls++;
+		stats.vertices += 8*lines;
+		glPopMatrix();
+	}
+
+	/* Draw a simple grid defining our boundaries. With batching on each
+	   size is compiled into a display list the first time it is drawn. */
+	void drawOOBGrid3D( int size )
+	{
+		PROFILE_SCOPE( "Renderer::drawOOBGrid3D" );
+		if( !batching )
+		{
+			drawOOBGrid3DImmediate( size );
+			return;
+		}
+
+		size_t g = 0;
+		while( g < grids.size() && grids[g].size != size )
+			g++;
+		if( g == grids.size() )
+		{
+			/* Sizes only change with UNIVERSE_SIZE/DEAD_ZONE, so the oldest list is stale */
+			if( grids.size() < MAX_GRID_LISTS )
+			{
+				grids.push_back( GridList() );
+				grids.back().list = glGenLists( 1 );
+			}
+			else
+				rotate( grids.begin(), grids.begin() + 1, grids.end() );
+			g = grids.size() - 1;
+
+			vector<float> verts;
+			buildOOBGrid( size, verts );
+			glEnableClientState( GL_VERTEX_ARRAY );
+			glVertexPointer( 3, GL_FLOAT, 0, &verts[0] );
+			glNewList( grids[g].list, GL_COMPILE );
+				glDrawArrays( GL_LINES, 0, (GLsizei)(verts.size() / 3) );
+			glEndList();
+			glDisableClientState( GL_VERTEX_ARRAY );
+
+			grids[g].size = size;
+			grids[g].vertices = (int)(verts.size() / 3);
+		}
+
+		glCallList( grids[g].list );
+		stats.drawCalls++;
+		stats.vertices += grids[g].vertices;
+	}
+
+	/* Stars of block b this pass draws, every sparseStarDivisor-th with sparse stars on */
+	int starsToDraw( const StarBlock& b )
+	{
+		return sparseStars ? (b.count + sparseStarDivisor - 1) / sparseStarDivisor : b.count;
+	}
+
+	/* Draw stars. They only change when the universe is generated, so with
+	   batching on each block of them is compiled into display lists once
+	   and every frame after that is a single glCallLists() of the blocks in
+	   view. A block is split in two lists, the sparse part and the rest, so
+	   that a sparse pass just leaves the second out. Stars are in random
+	   order within a block, so the sparse part is an even sample. */
+	void drawStars( Universe& universe )
+	{
+		PROFILE_SCOPE( "Renderer::drawStars" );
+		vector<Star>& stars = universe.getStars();
+		vector<StarBlock>& blocks = universe.getStarBlocks();
+		if( stars.empty() )
+			return;
+
+		if( !batching )
+		{
+			glBegin( GL_POINTS );
+				for( size_t b = 0; b < blocks.size(); b++ )
+				{
+					if( culling && !frustum.boxVisible( blocks[b].lo, blocks[b].hi ) )
+					{
+						stats.starBlocksCulled++;
+						continue;
+					}
+					stats.starBlocksVisible++;
+					int count = starsToDraw( blocks[b] );
+					for( int i = blocks[b].first; i < blocks[b].first + count; i++ )
+					{
+						glColor3ubv( stars[i].color );
+						glVertex3fv( stars[i].position );
+					}
+					stats.vertices += count;
+				}
+			glEnd();
+			stats.drawCalls++;
+			return;
+		}
+
+		if( starLists == 0 || starListVersion != universe.getStarsVersion() || starListDivisor != sparseStarDivisor )
+		{
+			if( starLists != 0 )
+				glDeleteLists( starLists, 2 * starListBlocks );
+			starListBlocks = (int)blocks.size();
+			starLists = glGenLists( 2 * starListBlocks );
+
+			glEnableClientState( GL_VERTEX_ARRAY );
+			glEnableClientState( GL_COLOR_ARRAY );
+			glVertexPointer( 3, GL_FLOAT, sizeof(Star), stars[0].position );
+			glColorPointer( 3, GL_UNSIGNED_BYTE, sizeof(Star), stars[0].color );
+			for( int b = 0; b < starListBlocks; b++ )
+			{
+				int sparse = (blocks[b].count + sparseStarDivisor - 1) / sparseStarDivisor;
+				glNewList( starLists + 2*b, GL_COMPILE );
+					glDrawArrays( GL_POINTS, blocks[b].first, sparse );
+				glEndList();
+				glNewList( starLists + 2*b + 1, GL_COMPILE );
+					if( blocks[b].count > sparse )
+						glDrawArrays( GL_POINTS, blocks[b].first + sparse, blocks[b].count - sparse );
+				glEndList();
+			}
+			glDisableClientState( GL_COLOR_ARRAY );
+			glDisableClientState( GL_VERTEX_ARRAY );
+
+			starListVersion = universe.getStarsVersion();
+			starListDivisor = sparseStarDivisor;
+		}
+
+		visibleStarLists.clear();
+		for( int b = 0; b < starListBlocks; b++ )
+		{
+			if( culling && !frustum.boxVisible( blocks[b].lo, blocks[b].hi ) )
+			{
+				stats.starBlocksCulled++;
+				continue;
+			}
+			stats.starBlocksVisible++;
+			visibleStarLists.push_back( starLists + 2*b );
+			if( !sparseStars )
+				visibleStarLists.push_back( starLists + 2*b + 1 );
+			stats.vertices += starsToDraw( blocks[b] );
+		}
+
+		if( visibleStarLists.empty() )
+			return;
+		glCallLists( (GLsizei)visibleStarLists.size(), GL_UNSIGNED_INT, &visibleStarLists[0] );
+		stats.drawCalls++;
+	}
+
+	/* Copies the w x h pixels at (l, b) of the frame being drawn into view */
+	void captureView( CachedView& view, int l, int b, int w, int h )
+	{
+		if( view.texture == 0 || view.texWidth < w || view.texHeight < h )
+		{
+			if( view.texture == 0 )
+				glGenTextures( 1, &view.texture );
+			view.texWidth = view.texHeight = 1;
+			while( view.texWidth < w ) view.texWidth <<= 1;
+			while( view.texHeight < h ) view.texHeight <<= 1;
+
+			glBindTexture( GL_TEXTURE_2D, view.texture );
+			glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST );
+			glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST );
+			glTexImage2D( GL_TEXTURE_2D, 0, GL_RGB, view.texWidth, view.texHeight, 0, GL_RGB, GL_UNSIGNED_BYTE, NULL );
+		}
+
+		glBindTexture( GL_TEXTURE_2D, view.texture );
+		glCopyTexSubImage2D( GL_TEXTURE_2D, 0, 0, 0, l, b, w, h );
+		glBindTexture( GL_TEXTURE_2D, 0 );
+		stats.stateChanges += 2;
+		view.width = w;
+		view.height = h;
+	}
+
+	/* Puts the last capture of view back at (l, b), pixel for pixel */
+	void drawCachedView( CachedView& view, int l, int b )
+	{
+		float s = (float)view.width / view.texWidth, t = (float)view.height / view.texHeight;
+
+		setProjectionTo2D();
+		glPushAttrib( GL_ENABLE_BIT | GL_TEXTURE_BIT );
+		glDisable( GL_DEPTH_TEST );
+		glEnable( GL_TEXTURE_2D );
+		glBindTexture( GL_TEXTURE_2D, view.texture );
+		glTexEnvi( GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_REPLACE );
+		glBegin( GL_QUADS );
+			glTexCoord2f( 0, 0 ); glVertex2i( l, b );
+			glTexCoord2f( s, 0 ); glVertex2i( l + view.width, b );
+			glTexCoord2f( s, t ); glVertex2i( l + view.width, b + view.height );
+			glTexCoord2f( 0, t ); glVertex2i( l, b + view.height );
+		glEnd();
+		glPopAttrib();
+
+		stats.drawCalls++;
+		stats.vertices += 4;
+		stats.stateChanges += 6;
+	}
+
+	/* False if nothing of entity i can be in view. Only reads, so jobs can
+	   ask about different entities at once. */
+	bool visible( EntityStore& entities, int i )
+	{
+		float r = entities.radius[i];
+		if( entities.getHitBoxesVisible() )
+			r = max( r, fabsf( entities.getCollisionRadius( i ) ) );
+		return !culling || frustum.sphereVisible( entities.position[i], r );
+	}
+
+	/* visible(), counted as culled or visible */
+	bool inView( EntityStore& entities, int i )
+	{
+		if( !visible( entities, i ) )
+		{
+			stats.objectsCulled++;
+			return false;
+		}
+		stats.objectsVisible++;
+		return true;
+	}
+
+	void drawUniverse( Universe& universe )
+	{
+		PROFILE_SCOPE( "Renderer::drawUniverse" );
+		EntityStore& entities = universe.getEntities();
+
+		if( instancing && batching )
+			drawInstanced( entities );
+		else
+		{
+			for( int i = 0; i < entities.size(); i++ )
+				if( inView( entities, i ) )
+					drawEntity( entities, i );
+		}
+
+		glColor3f( 0.2f, 0.2f, 0.2f );
+		drawOOBGrid3D( UNIVERSE_SIZE );
+	}
+
+	/* Frame, tick and drawing times in the top left corner: the newest and
+	   p50/p95/p99 of each over the window, then a bar a frame (oldest on
+	   the left) stacking the ticks (blue), the drawing (green) and the rest
+	   of the frame (gray, red past the budget line). Formats into a fixed
+	   buffer, so it allocates nothing itself. */
+	void drawFrameOverlay( const FrameTimes& frame, const FrameTimes& sim, const FrameTimes& render )
+	{
+		const char *names[3] = { "frame ", "sim   ", "render" };
+		const FrameTimes *series[3] = { &frame, &sim, &render };
+		const int LINE = 15, LEFT = 10;
+		int y = g_screenHeight - 20;
+		char line[128];
+
+		setProjectionTo2D();
+		glPushAttrib( GL_ENABLE_BIT );
+		glDisable( GL_DEPTH_TEST );
+
+		glColor3f( 0.8f, 0.8f, 0.8f );
+		for( int s = 0; s < 3; s++, y -= LINE )
+		{
+			const FrameTimes& t = *series[s];
+			float now = t.size() ? t.get( 0 ) : 0;
+			sprintf( line, "%s %6.2f ms  p50 %6.2f  p95 %6.2f  p99 %6.2f", names[s], min( now, 9999.0f ),
+				min( t.percentile( 0.50f ), 9999.0f ), min( t.percentile( 0.95f ), 9999.0f ), min( t.percentile( 0.99f ), 9999.0f ) );
+			font.draw( (float)LEFT, (float)y, line );
+		}
+
+		float scale = OVERLAY_HEIGHT / (2 * OVERLAY_BUDGET_MS);
+		float budget = OVERLAY_HEIGHT / 2.0f;
+		int bottom = y - OVERLAY_HEIGHT, n = frame.size();
+		glBegin( GL_LINES );
+			for( int age = 0; age < n; age++ )
+			{
+				float x = LEFT + FRAME_WINDOW - 0.5f - age;
+				float ticks = min( sim.size() > age ? sim.get( age ) * scale : 0, (float)OVERLAY_HEIGHT );
+				float drawing = min( ticks + (render.size() > age ? render.get( age ) * scale : 0), (float)OVERLAY_HEIGHT );
+				float whole = min( max( frame.get( age ) * scale, drawing ), (float)OVERLAY_HEIGHT );
+
+				glColor3f( 0.3f, 0.5f, 1.0f );
+				glVertex2f( x, (float)bottom );
+				glVertex2f( x, bottom + ticks );
+				glColor3f( 0.3f, 0.9f, 0.3f );
+				glVertex2f( x, bottom + ticks );
+				glVertex2f( x, bottom + drawing );
+				glColor3f( 0.5f, 0.5f, 0.5f );
+				glVertex2f( x, bottom + drawing );
+				glVertex2f( x, bottom + max( drawing, min( whole, budget ) ) );
+				glColor3f( 0.9f, 0.2f, 0.2f );
+				glVertex2f( x, bottom + max( drawing, budget ) );
+				glVertex2f( x, bottom + max( whole, budget ) );
+			}
+
+			/* The budget, over the bars */
+			glColor3f( 0.8f, 0.8f, 0.8f );
+			glVertex2f( (float)LEFT, bottom + budget );
+			glVertex2f( (float)(LEFT + FRAME_WINDOW), bottom + budget );
+		glEnd();
+		glPopAttrib();
+
+		stats.drawCalls += 4;
+		stats.vertices += 8 * n + 2;
+		stats.stateChanges += 3;
+	}
+
+	/* onTarget turns the crosshair red, see Simulation::hasTarget() */
+	void drawHud( Player& player, bool onTarget = false )
+	{
+		drawScore( player );
+		drawCrosshair( onTarget );
+	}
+};
@@ -0,0 +1,544 @@
+/* Replay.h
+ * Records a game as the seed its universe was generated from and the input
+ * that reached the simulation, each stamped with the tick it came before,
+ * and plays it back tick for tick. The same seed and the same input at the
+ * same ticks give the same game, so one recorded session can be flown again
+ * headless (ShazamBench replay) or on screen (SHAZAM --replay) to measure
+ * every change on identical work.
+ *
+ * While recording, a hash of the game state (the player and every entity)
+ * is kept every checkpointTicks ticks; playing back checks its own hashes
+ * against them, so a replay that has drifted from the recording says so
+ * and at which tick. A recording only plays back the same in a build that
+ * does the same floating point, a change to the rules shows up as a
+ * mismatch too.
+ *
+ * The file is little endian: a header, then each event as the ticks since
+ * the one before (a varint), its type and for most types four bytes of
+ * payload, then the checkpoints the same way. Most events take six bytes,
+ * a minute of mouse flying a few tens of kilobytes.
+ */
+
+#pragma once
+
+#include "Simulation.h"
+#include "Bench.h" /* Stopwatch */
+#include "TickClock.h" /* TICKS_PER_SECOND */
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include <string>
+
+using namespace std;
+
+#define REPLAY_VERSION			1
+#define REPLAY_CHECKPOINT_TICKS	60 /* ticks between state hashes, a second of play */
+
+static const char REPLAY_MAGIC[4] = { 'S', 'H', 'Z', 'R' };
+
+/* What a recorded event does to the Simulation, one for each of its input
+   methods. The order is the file format, only add to the end. */
+enum InputType
+{
+	INPUT_YAW = 0, INPUT_PITCH, INPUT_ROLL, INPUT_ROLL2,
+	INPUT_FORWARD, INPUT_RIGHT,
+	INPUT_REVIVE,   /* no payload */
+	INPUT_RESTART,  /* startGame() on a new seed */
+	NUM_INPUT_TYPES
+};
+
+struct InputEvent
+{
+	unsigned tick;      /* applied just before this tick runs */
+	unsigned char type; /* InputType */
+	float amount;
+	unsigned seed;      /* INPUT_RESTART's */
+};
+
+/* The state hash after tick ticks had run, before the input that came
+   after them; except at the end of a recording, where it is after it */
+struct Checkpoint
+{
+	unsigned tick;
+	unsigned long long hash;
+};
+
+/* FNV-1a over the parts of the game a tick changes: the player's ship,
+   fuel, score and fate, and every entity's type and placement. withStars
+   adds the stars, which only generating changes. */
+unsigned long long hashState( Simulation& sim, bool withStars = false )
+{
+	struct Fnv
+	{
+		unsigned long long h;
+		void add( const void *data, size_t bytes )
+		{
+			const unsigned char *p = (const unsigned char *)data;
+			for( size_t i = 0; i < bytes; i++ )
+				h = (h ^ p[i]) * 1099511628211ULL;
+		}
+		void add( const Vec3& v ){ add( &v.x, sizeof(float) ); add( &v.y, sizeof(float) ); add( &v.z, sizeof(float) ); }
+	} fnv = { 14695981039346656037ULL };
+
+	Player& player = sim.getPlayer();
+	fnv.add( player.position );
+	fnv.add( player.getLookDirection() );
+	fnv.add( player.getUpVector() );
+	fnv.add( player.getLookVelocity() );
+	float motion[3] = { player.getVelocity(), player.getAcceleration(), player.checkFuel() };
+	int score = player.getScore();
+	unsigned char fate[3] = { sim.isPlayerDead(), sim.hasWon(), sim.isOOB() };
+	fnv.add( motion, sizeof(motion) );
+	fnv.add( &score, sizeof(score) );
+	fnv.add( fate, sizeof(fate) );
+
+	EntityStore& e = sim.getUniverse().getEntities();
+	int n = e.size();
+	fnv.add( &n, sizeof(n) );
+	if( n > 0 )
+	{
+		fnv.add( &e.type[0], n );
+		fnv.add( &e.position[0], n * sizeof(Vec3) );
+		fnv.add( &e.rotation[0], n * sizeof(Vec3) );
+		fnv.add( &e.scale[0], n * sizeof(Vec3) );
+	}
+
+	vector<Star>& stars = sim.getUniverse().getStars();
+	if( withStars && !stars.empty() )
+		fnv.add( &stars[0], stars.size() * sizeof(Star) );
+	return fnv.h;
+}
+
+/* Applies a recorded event to sim, as the input method it stands for would */
+void applyInput( Simulation& sim, const InputEvent& e )
+{
+	switch( e.type )
+	{
+	case INPUT_YAW: sim.playerYaw( e.amount ); break;
+	case INPUT_PITCH: sim.playerPitch( e.amount ); break;
+	case INPUT_ROLL: sim.playerRoll( e.amount ); break;
+	case INPUT_ROLL2: sim.playerRoll2( e.amount ); break;
+	case INPUT_FORWARD: sim.movePlayerForward( e.amount ); break;
+	case INPUT_RIGHT: sim.movePlayerRight( e.amount ); break;
+	case INPUT_REVIVE: sim.revivePlayer(); break;
+	case INPUT_RESTART: sim.startGame( e.seed ); break;
+	default: break;
+	}
+}
+
+/* A recorded session and the universe it was played in */
+class InputRecording
+{
+private:
+	static void putU32( vector<unsigned char>& out, unsigned v )
+	{
+		for( int i = 0; i < 4; i++ )
+			out.push_back( (unsigned char)(v >> (8 * i)) );
+	}
+
+	static void putVarint( vector<unsigned char>& out, unsigned v )
+	{
+		while( v >= 0x80 )
+		{
+			out.push_back( (unsigned char)(v | 0x80) );
+			v >>= 7;
+		}
+		out.push_back( (unsigned char)v );
+	}
+
+	/* Reads from a buffer, every get fails (and stays failed) past its end */
+	struct Reader
+	{
+		const unsigned char *p, *end;
+		bool ok;
+
+		unsigned u32()
+		{
+			if( end - p < 4 )
+			{
+				ok = false;
+				return 0;
+			}
+			unsigned v = p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned)p[3] << 24);
+			p += 4;
+			return v;
+		}
+
+		unsigned varint()
+		{
+			unsigned v = 0;
+			for( int shift = 0; shift < 35; shift += 7 )
+			{
+				if( p == end )
+					break;
+				unsigned char b = *p++;
+				v |= (unsigned)(b & 0x7f) << shift;
+				if( !(b & 0x80) )
+					return v;
+			}
+			ok = false;
+			return 0;
+		}
+
+		unsigned char byte()
+		{
+			if( p == end )
+			{
+				ok = false;
+				return 0;
+			}
+			return *p++;
+		}
+	};
+
+public:
+	unsigned seed;         /* what the first game's universe was generated from */
+	int universeSize;      /* UNIVERSE_SIZE then */
+	int numStars;          /* NUM_STARS then, --stars can change it */
+	int ticksPerSecond;    /* the rate it was played at */
+	int checkpointTicks;
+	unsigned ticks;        /* how many ticks it ran for */
+	vector<InputEvent> events;       /* in the order they happened */
+	vector<Checkpoint> checkpoints;  /* in tick order */
+
+	InputRecording(){ clear(); }
+
+	void clear()
+	{
+		seed = 0;
+		universeSize = UNIVERSE_SIZE;
+		numStars = NUM_STARS;
+		ticksPerSecond = TICKS_PER_SECOND;
+		checkpointTicks = REPLAY_CHECKPOINT_TICKS;
+		ticks = 0;
+		events.clear();
+		checkpoints.clear();
+	}
+
+	/* The file image, see the top of this file */
+	void encode( vector<unsigned char>& out ) const
+	{
+		out.assign( REPLAY_MAGIC, REPLAY_MAGIC + 4 );
+		putU32( out, REPLAY_VERSION );
+		putU32( out, seed );
+		putU32( out, universeSize );
+		putU32( out, numStars );
+		putU32( out, ticksPerSecond );
+		putU32( out, checkpointTicks );
+		putU32( out, ticks );
+		putU32( out, (unsigned)events.size() );
+		putU32( out, (unsigned)checkpoints.size() );
+
+		unsigned last = 0;
+		for( size_t i = 0; i < events.size(); i++ )
+		{
+			const InputEvent& e = events[i];
+			putVarint( out, e.tick - last );
+			last = e.tick;
+			out.push_back( e.type );
+			if( e.type == INPUT_RESTART )
+				putU32( out, e.seed );
+			else if( e.type != INPUT_REVIVE )
+			{
+				unsigned bits;
+				memcpy( &bits, &e.amount, sizeof(bits) );
+				putU32( out, bits );
+			}
+		}
+
+		last = 0;
+		for( size_t i = 0; i < checkpoints.size(); i++ )
+		{
+			putVarint( out, checkpoints[i].tick - last );
+			last = checkpoints[i].tick;
+			putU32( out, (unsigned)checkpoints[i].hash );
+			putU32( out, (unsigned)(checkpoints[i].hash >> 32) );
+		}
+	}
+
+	/* Reads encode()'s image back, false (and cleared) if it is not one */
+	bool decode( const unsigned char *data, size_t bytes )
+	{
+		clear();
+		Reader in = { data, data + bytes, true };
+		if( bytes < 4 || memcmp( data, REPLAY_MAGIC, 4 ) != 0 )
+			return false;
+		in.p += 4;
+		if( in.u32() != REPLAY_VERSION )
+			return false;
+
+		seed = in.u32();
+		universeSize = (int)in.u32();
+		numStars = (int)in.u32();
+		ticksPerSecond = (int)in.u32();
+		checkpointTicks = (int)in.u32();
+		ticks = in.u32();
+		unsigned numEvents = in.u32();
+		unsigned numCheckpoints = in.u32();
+
+		/* Every event takes at least two bytes and every checkpoint nine,
+		   so counts the file cannot hold are caught before reserving */
+		size_t left = in.end - in.p;
+		if( !in.ok || numEvents > left / 2 || numCheckpoints > left / 9 )
+		{
+			clear();
+			return false;
+		}
+
+		events.resize( numEvents );
+		unsigned last = 0;
+		for( unsigned i = 0; i < numEvents && in.ok; i++ )
+		{
+			InputEvent& e = events[i];
+			e.tick = last += in.varint();
+			e.type = in.byte();
+			e.amount = 0;
+			e.seed = 0;
+			if( e.type >= NUM_INPUT_TYPES )
+				in.ok = false;
+			else if( e.type == INPUT_RESTART )
+				e.seed = in.u32();
+			else if( e.type != INPUT_REVIVE )
+			{
+				unsigned bits = in.u32();
+				memcpy( &e.amount, &bits, sizeof(bits) );
+			}
+		}
+
+		checkpoints.resize( numCheckpoints );
+		last = 0;
+		for( unsigned i = 0; i < numCheckpoints && in.ok; i++ )
+		{
+			checkpoints[i].tick = last += in.varint();
+			unsigned long long lo = in.u32();
+			unsigned long long hi = in.u32();
+			checkpoints[i].hash = lo | (hi << 32);
+		}
+
+		if( !in.ok || universeSize <= 0 || numStars < 0 )
+		{
+			clear();
+			return false;
+		}
+		return true;
+	}
+
+	bool save( const string& path ) const
+	{
+		vector<unsigned char> image;
+		encode( image );
+		FILE *f = fopen( path.c_str(), "wb" );
+		if( !f )
+			return false;
+		bool ok = fwrite( &image[0], 1, image.size(), f ) == image.size();
+		return fclose( f ) == 0 && ok;
+	}
+
+	bool load( const string& path )
+	{
+		clear();
+		FILE *f = fopen( path.c_str(), "rb" );
+		if( !f )
+			return false;
+		vector<unsigned char> image;
+		unsigned char chunk[4096];
+		size_t got;
+		while( (got = fread( chunk, 1, sizeof(chunk), f )) > 0 )
+			image.insert( image.end(), chunk, chunk + got );
+		fclose( f );
+		return !image.empty() && decode( &image[0], image.size() );
+	}
+};
+
+/* Stands between a front end and the Simulation: its input methods are
+   the Simulation's, forwarded on, and while recording each is also kept
+   with the tick it came before. Not recording, it only forwards. */
+class InputRecorder
+{
+private:
+	Simulation *sim;
+	InputRecording recording;
+	bool armed;    /* record from the next startGame() */
+	bool started;  /* that startGame() has happened */
+	unsigned tick; /* ticks run since it did */
+
+	void record( InputType type, float amount, unsigned seed = 0 )
+	{
+		if( !started )
+			return;
+		InputEvent e = { tick, (unsigned char)type, amount, seed };
+		recording.events.push_back( e );
+	}
+
+	void checkpoint()
+	{
+		Checkpoint c = { tick, hashState( *sim, tick == 0 ) };
+		recording.checkpoints.push_back( c );
+	}
+
+public:
+	InputRecorder( Simulation& s ) : sim( &s )
+	{
+		armed = started = false;
+		tick = 0;
+	}
+
+	/* Records everything from the next startGame() on, checkpointing every
+	   so many ticks */
+	void record( int checkpointTicks = REPLAY_CHECKPOINT_TICKS )
+	{
+		recording.clear();
+		recording.checkpointTicks = checkpointTicks < 1 ? 1 : checkpointTicks;
+		armed = true;
+		started = false;
+		tick = 0;
+	}
+
+	bool isRecording(){ return armed; }
+
+	/* The first game recorded sets up the recording, later ones (playing
+	   again after winning or losing) are events in it */
+	void startGame( unsigned seed )
+	{
+		if( armed && !started )
+		{
+			recording.seed = seed;
+			recording.universeSize = UNIVERSE_SIZE;
+			recording.numStars = NUM_STARS;
+			sim->startGame( seed );
+			started = true;
+			checkpoint();
+			return;
+		}
+		record( INPUT_RESTART, 0, seed );
+		sim->startGame( seed );
+	}
+
+	void updateGame()
+	{
+		sim->updateGame();
+		if( !started )
+			return;
+		tick++;
+		if( tick % recording.checkpointTicks == 0 )
+			checkpoint();
+	}
+
+	void playerYaw( float amt ){ record( INPUT_YAW, amt ); sim->playerYaw( amt ); }
+	void playerPitch( float amt ){ record( INPUT_PITCH, amt ); sim->playerPitch( amt ); }
+	void playerRoll( float amt ){ record( INPUT_ROLL, amt ); sim->playerRoll( amt ); }
+	void playerRoll2( float amt ){ record( INPUT_ROLL2, amt ); sim->playerRoll2( amt ); }
+	void movePlayerForward( float amt ){ record( INPUT_FORWARD, amt ); sim->movePlayerForward( amt ); }
+	void movePlayerRight( float amt ){ record( INPUT_RIGHT, amt ); sim->movePlayerRight( amt ); }
+	void revivePlayer(){ record( INPUT_REVIVE, 0 ); sim->revivePlayer(); }
+
+	/* Ends the recording where the game is now, with a last checkpoint
+	   of the game as it is (input since the last tick and all), and
+	   returns it. Recording stops. */
+	const InputRecording& finish()
+	{
+		if( started )
+		{
+			if( !recording.checkpoints.empty() && recording.checkpoints.back().tick == tick )
+				recording.checkpoints.pop_back();
+			checkpoint();
+			recording.ticks = tick;
+		}
+		armed = started = false;
+		return recording;
+	}
+};
+
+/* Plays an InputRecording back into a Simulation a tick at a time,
+   checking the state against the recorded hashes as it goes */
+class InputReplayer
+{
+private:
+	Simulation *sim;
+	InputRecording recording;
+	size_t nextEvent, nextCheckpoint;
+	unsigned tick;
+	int checked, mismatches;
+	long long firstMismatch;   /* the tick of the first, -1 while there is none */
+	vector<double> tickTimes;  /* microseconds each updateGame() took */
+
+	/* Applies the input recorded before the coming tick, or at the end
+	   the input that came after the last */
+	void applyDue()
+	{
+		while( nextEvent < recording.events.size() && recording.events[nextEvent].tick <= tick )
+			applyInput( *sim, recording.events[nextEvent++] );
+	}
+
+	/* Compares the state with the recorded checkpoint for this tick, if any */
+	void check()
+	{
+		while( nextCheckpoint < recording.checkpoints.size() && recording.checkpoints[nextCheckpoint].tick < tick )
+			nextCheckpoint++;
+		if( nextCheckpoint == recording.checkpoints.size() || recording.checkpoints[nextCheckpoint].tick != tick )
+			return;
+		checked++;
+		if( hashState( *sim, tick == 0 ) != recording.checkpoints[nextCheckpoint].hash )
+		{
+			if( mismatches++ == 0 )
+				firstMismatch = tick;
+		}
+		nextCheckpoint++;
+	}
+
+public:
+	InputReplayer( Simulation& s ) : sim( &s )
+	{
+		nextEvent = nextCheckpoint = 0;
+		tick = 0;
+		checked = mismatches = 0;
+		firstMismatch = -1;
+	}
+
+	/* Sizes the universe as recorded and starts the first game. Meshes
+	   should be loading (or loaded) already. */
+	void start( const InputRecording& r )
+	{
+		recording = r;
+		nextEvent = nextCheckpoint = 0;
+		tick = 0;
+		checked = mismatches = 0;
+		firstMismatch = -1;
+		tickTimes.clear();
+		tickTimes.reserve( recording.ticks );
+
+		setUniverseSize( recording.universeSize );
+		setNumStars( recording.numStars );
+		sim->startGame( recording.seed );
+		if( isFinished() )
+			applyDue();
+		check();
+	}
+
+	bool isFinished(){ return tick >= recording.ticks; }
+
+	/* Applies the input recorded before the next tick, runs it and checks
+	   the state. False, doing nothing, once the recording has run out. */
+	bool updateGame()
+	{
+		if( isFinished() )
+			return false;
+		applyDue();
+
+		Stopwatch sw;
+		sim->updateGame();
+		tickTimes.push_back( sw.elapsedUs() );
+		tick++;
+		if( isFinished() )
+			applyDue();
+		check();
+		return true;
+	}
+
+	const InputRecording& getRecording(){ return recording; }
+	unsigned getTick(){ return tick; }
+	int getCheckpointsChecked(){ return checked; }
+	int getMismatches(){ return mismatches; }
+	long long getFirstMismatch(){ return firstMismatch; }
+	vector<double>& getTickTimes(){ return tickTimes; }
+};
@@ -29,17 +29,19 @@ void ERRCHECK(FMOD_RESULT result)
 void Display()                                              // glutDisplayFunc()
 {
 	glClearColor(0.0, 0.0, 0.0, 0.0);
+	PROFILE_SCOPE( "frame" );
 	glClear( GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT );
 
 	shazam.drawUniverse();
 
 	glutSwapBuffers();
+	Counters::shared().endFrame();
 }
 
 void Idle()                                                     //glutIdleFunc()
 {
 	glutSetCursor( GLUT_CURSOR_NONE );
-	shazam.updateGame();
+	shazam.advanceGame();
 	glutPostRedisplay();
 }
 
@@ -70,6 +72,7 @@ void Keyboard(unsigned char key, int x, int y)             // glutKeyboardFunc()
 	switch( key )
 	{
 	case 27:		/* ESC */
+		shazam.saveRecording();
 		exit(0); 
 		break;
 
@@ -101,6 +104,7 @@ void Keyboard(unsigned char key, int x, int y)             // glutKeyboardFunc()
 		if( shazam.getMode() == PLAYING && (shazam.isPlayerDead() || shazam.hasWon()) )
 		{
 			shazam.goToMainMenu();
+			shazam.saveRecording();
 			exit(0); // TEMP until a main menu is implemented! 
 		}
 		break;
@@ -118,6 +122,70 @@ void Special(int key, int x, int y)                         // glutSpecialFunc()
 		shazam.toggleHitBoxes();
 		break;
 
+	case GLUT_KEY_F2:
+		shazam.toggleBatching();
+		cout << "Mesh batching " << (shazam.isBatching() ? "on" : "off") << endl;
+		break;
+
+	case GLUT_KEY_F4:
+		shazam.toggleLOD();
+		cout << "Level of detail " << (shazam.isLOD() ? "on" : "off") << endl;
+		break;
+
+	case GLUT_KEY_F5:
+		shazam.toggleInstancing();
+		cout << "Instanced drawing " << (shazam.isInstancing() ? "on" : "off") << endl;
+		break;
+
+	case GLUT_KEY_F6:
+		shazam.toggleCulling();
+		cout << "Frustum culling " << (shazam.isCulling() ? "on" : "off") << endl;
+		break;
+
+	case GLUT_KEY_F8:
+		shazam.toggleFrameOverlay();
+		break;
+
+	case GLUT_KEY_F7:
+	{
+		/* Starts a profile recording, or stops one and saves it */
+		Profiler& profiler = Profiler::shared();
+		if( !profiler.isRecording() )
+		{
+			profiler.start();
+			cout << "Profiling, press F7 again to stop" << endl;
+		}
+		else
+		{
+			profiler.stop();
+			if( profiler.write( "shazam_trace.json" ) )
+				cout << "Wrote " << profiler.getNumEvents() << " events (" << profiler.getNumDropped()
+					<< " dropped) to shazam_trace.json, open it in chrome://tracing or ui.perfetto.dev" << endl;
+			else
+				cerr << "Could not write shazam_trace.json" << endl;
+		}
+		break;
+	}
+
+	case GLUT_KEY_F3:
+	{
+		RenderStats st = shazam.getFrameStats();
+		cout << "Last frame: " << st.drawCalls << " draw calls, " << st.vertices
+			<< " vertices, " << st.triangles << " mesh triangles, " << st.stateChanges << " state changes" << endl;
+		cout << "  objects " << st.objectsVisible << " drawn, " << st.objectsCulled << " culled; star blocks "
+			<< st.starBlocksVisible << " drawn, " << st.starBlocksCulled << " culled" << endl;
+
+		RenderStats mainSt, povSt;
+		double mainMs, povMs;
+		bool refreshed;
+		shazam.getFrameCost( mainSt, mainMs, povSt, povMs, refreshed );
+		cout << "  main view " << mainSt.drawCalls << " draw calls, " << mainSt.vertices << " vertices, "
+			<< mainMs << " ms" << endl;
+		cout << "  enemy view " << povSt.drawCalls << " draw calls, " << povSt.vertices << " vertices, "
+			<< povMs << " ms (" << (refreshed ? "rendered" : "from texture") << ")" << endl;
+		break;
+	}
+
 	case GLUT_KEY_UP:	/* up arrow */
 		if( SCALE > 10.0f )
 			SCALE -= 1.0f;
@@ -148,6 +216,11 @@ void main(int argc, char **argv)
 	FMOD::Channel *channel = 0;
 	FMOD_RESULT result;
 	unsigned int      version;
+
+	PROFILE_THREAD( "main" );
+
+	/* Meshes load on worker threads while FMOD, GLUT and the intro get going */
+	shazam.loadAsync();
 	
 	// Create/init the system object
 	result = FMOD::System_Create(&fmodSystem);
@@ -173,6 +246,34 @@ void main(int argc, char **argv)
 	
 	ConsoleMode( 105, 20 );
 	glutInit(&argc, argv);
+
+	/* SHAZAM --stars 1000000 fills the sky for stress testing the starfield.
+	   --pov-interval, --pov-lod and --pov-stars set how often the enemy view
+	   inset is rendered (in frames), its level of detail error (in pixels)
+	   and that it shows one star in so many. --counters FILE streams every
+	   frame's counters (Counters.h) to FILE, as JSON lines if it ends in
+	   .json or .jsonl and as CSV otherwise. --record FILE saves the seed
+	   and every input (Replay.h) to FILE on the way out, and --replay FILE
+	   plays such a recording back in place of the mouse and keys. */
+	for( int i = 1; i + 1 < argc; i++ )
+	{
+		string arg = argv[i];
+		if( arg == "--stars" )
+			setNumStars( atoi(argv[i+1]) );
+		else if( arg == "--pov-interval" )
+			shazam.setPovInterval( atoi(argv[i+1]) );
+		else if( arg == "--pov-lod" )
+			shazam.setPovPixelError( (float)atof(argv[i+1]) );
+		else if( arg == "--pov-stars" )
+			shazam.setPovStarDivisor( atoi(argv[i+1]) );
+		else if( arg == "--counters" && !Counters::shared().openStream( argv[i+1] ) )
+			cerr << "Could not open " << argv[i+1] << " for the counters" << endl;
+		else if( arg == "--record" )
+			shazam.recordTo( argv[i+1] );
+		else if( arg == "--replay" && !shazam.replayFrom( argv[i+1] ) )
+			cerr << "Could not read the recording " << argv[i+1] << endl;
+	}
+
 	glutInitDisplayMode(GLUT_RGB | GLUT_DOUBLE | GLUT_DEPTH);
 	glutInitWindowSize(640,480);
 	glutInitWindowPosition(100, 100);
@@ -201,6 +302,10 @@ void main(int argc, char **argv)
 	cout << "  D - Roll right" << endl;
 	cout << "  ESC - Exit the game" << endl;
 	cout << "  F1 - Toggle hit boxes" << endl;
+	cout << "  F2 - Toggle mesh batching, F3 - Print draw call counts" << endl;
+	cout << "  F4 - Toggle level of detail, F5 - Toggle instanced drawing" << endl;
+	cout << "  F6 - Toggle frustum culling, F7 - Start/stop profiling" << endl;
+	cout << "  F8 - Toggle the frame time overlay" << endl;
 	cout << "  Use the up and down arrow keys to modify mouse sensitivity" << endl;
 	//cout << "  Mouse1 - Fire weapon" << endl;
 	cout << "\nUse your mouse to control the ship's view" << endl;
@@ -215,6 +320,9 @@ void main(int argc, char **argv)
 	fmodSystem->playSound(FMOD_CHANNEL_FREE, music, false, &channel);
 	ERRCHECK(result);
 
+	if( !shazam.finishLoading() )
+		cerr << "Some meshes failed to load, run SHAZAM from the Binaries folder!" << endl;
+
 	shazam.startGame();
 	shazam.updateGame();
 	glutFullScreen();
@@ -4,33 +4,62 @@
  * November 16, 2008
  * Phillip Napieralski
  *  - Wrote the code
+ *
+ * The game rules live in Simulation.h, this class is the GLUT front end that
+ * draws them and forwards input.
  */
 
 #pragma once 
 
-#include "Player.h" /* includes basically everything */
-
-enum ShazamMode { MAIN_MENU = 0, PLAYING }; /* Not used currently */
+#include "Renderer.h" /* includes basically everything */
+#include "Bench.h" /* Stopwatch */
+#include "TickClock.h"
+#include "Replay.h"
+#include <ctime>
 
 #define ENEMY_POV_WINDOW_HEIGHT		150
 #define ENEMY_POV_WINDOW_WIDTH		ENEMY_POV_WINDOW_HEIGHT*(4.0f/3.0f)
-#define NUM_PLAYERS					1 /* We want multiplayer support later eh? :) */
 
-#define STARTING_FUEL				100
+#define POV_INTERVAL				3	  /* frames between renderings of the enemy POV inset */
+#define POV_LOD_PIXEL_ERROR			4.0f  /* level of detail error allowed in the inset, in pixels */
+#define POV_STAR_DIVISOR			4	  /* the inset shows one star in this many */
 
 class Shazam
 {
 private:
 	Camera topCam;
-	ShazamMode mode;
-	Universe universe; /* Create the universe */
-	Player player;
+	Simulation sim;
+	InputRecorder input;       /* what input goes through, recording it if asked to */
+	Renderer renderer;
 	Font font;
 	Font bigFont; 
 	float timer;
-	bool oob;     /* out of bounds (out of gray box) */
-	bool playerDead;
-	bool won;
+	RenderStats frameStats; /* what the last drawUniverse() sent to GL */
+
+	/* The game ticks at a fixed rate whatever the frame rate, frames are
+	   drawn between the last two ticks */
+	TickClock clock;
+	Stopwatch frameTimer;  /* since the last advanceGame() */
+	double frameSeconds;   /* how long the last frame was */
+
+	/* The frame time overlay's window of frame, tick and drawing times, in ms */
+	FrameTimes frameTimes, simTimes, renderTimes;
+	bool frameOverlay;
+
+	/* The enemy POV inset and what it costs next to the main view */
+	CachedView povView;
+	int povInterval, povAge;
+	float povPixelError;
+	bool povRefreshed;         /* the last frame rendered the inset rather than reusing it */
+	RenderStats mainStats, povStats;
+	double mainMs, povMs;      /* CPU time spent issuing each, last frame */
+
+	/* Playing a recording back rather than taking input */
+	InputReplayer replay;
+	InputRecording replayed;
+	bool replaying, replayStarted, replayReported;
+	vector<double> replayFrameMs;
+	string recordPath;
 
 	void drawWonGame()
 	{
@@ -62,13 +91,18 @@ private:
 		glColor3f( abs(costimer) , 0, 0 );
 		font.draw( w, h, sz );
 
-		timer += 0.05f;
+		timer += 3.0f * (float)frameSeconds; /* 0.05 a frame at 60 Hz */
 		if( timer >= 360.0f )
 			timer = -360.0f;
 	}
 
-	void drawObjectPov( Object obj )
+	/* Renders the scene as the enemy sees it into the inset, at the POV's
+	   own (coarser) level of detail and star density */
+	void renderObjectPov( Camera& cam )
 	{
+		Universe& universe = sim.getUniverse();
+		Player player = sim.getPlayerBetweenTicks( clock.getAlpha() );
+
 		setProjectionTo2D();
 		glColor3f(0,0,0);
 
@@ -90,183 +124,282 @@ private:
 			glVertex2f( g_screenWidth, g_screenHeight-ENEMY_POV_WINDOW_HEIGHT );
 		glEnd();
 
-		setViewport( g_screenWidth - ENEMY_POV_WINDOW_WIDTH, g_screenWidth, 
+		renderer.applyViewport( g_screenWidth - ENEMY_POV_WINDOW_WIDTH, g_screenWidth, 
 			g_screenHeight - ENEMY_POV_WINDOW_HEIGHT, g_screenHeight );
 
-		obj.setLookAt( player.position );
-		obj.setNearPlane( 2.0f ); /* Make sure we don't see just the objects insides :p */
-		obj.applyShape();
-		obj.update();
-		if( oob )
+		cam.setLookAt( player.position );
+		cam.setNearPlane( 2.0f ); /* Make sure we don't see just the objects insides :p */
+		renderer.applyProjection( cam );
+		renderer.applyView( cam );
+
+		float mainPixelError = renderer.getLODPixelError();
+		renderer.setLODPixelError( povPixelError );
+		renderer.setSparseStars( true );
+
+		if( sim.isOOB() )
 		{
 			glColor3f( 0.5f, 0.0f, 0.0f );
 			glPushMatrix();
-				universe.drawOOBGrid3D( UNIVERSE_SIZE + DEAD_ZONE );
+				renderer.drawOOBGrid3D( UNIVERSE_SIZE + DEAD_ZONE );
 			glPopMatrix();
 		}
-		player.drawBasedOnCamera();
-		universe.draw();
-		universe.drawStars();
+		renderer.drawObjectBasedOnCamera( player );
+		renderer.drawUniverse( universe );
+		renderer.drawStars( universe );
+
+		renderer.setSparseStars( false );
+		renderer.setLODPixelError( mainPixelError );
+	}
+
+	/* The enemy POV inset. It is only rendered every povInterval frames,
+	   in between the last rendering is put back from a texture. */
+	void drawObjectPov()
+	{
+		PROFILE_SCOPE( "Shazam::drawObjectPov" );
+		Universe& universe = sim.getUniverse();
+		int w = (int)ENEMY_POV_WINDOW_WIDTH, h = ENEMY_POV_WINDOW_HEIGHT;
+		int l = g_screenWidth - w, b = g_screenHeight - h;
+
+		povRefreshed = povAge <= 0 || povAge >= povInterval || !povView.isValid( w, h );
+		if( !povRefreshed )
+		{
+			renderer.drawCachedView( povView, l, b );
+			povAge++;
+			return;
+		}
+
+		/* The view from the first bad guy, looking at the player */
+		Camera cam;
+		int badGuy = sim.getWatcher();
+		if( badGuy >= 0 )
+			cam.moveTo( universe.getEntities().position[badGuy] );
+		renderObjectPov( cam );
+		renderer.captureView( povView, l, b, w, h );
+		povAge = 1;
+	}
+
+	/* A tick, of the recording when playing one back */
+	void tick()
+	{
+		if( !replaying )
+			input.updateGame();
+		else if( !replay.updateGame() )
+			reportReplay();
+	}
+
+	/* Once the recording has run out: whether it played back the same and
+	   how long its frames and ticks took */
+	void reportReplay()
+	{
+		if( replayReported )
+			return;
+		replayReported = true;
+		LatencyStats frames( replayFrameMs ), ticks( replay.getTickTimes() );
+		cout << "Replay finished after " << replay.getTick() << " ticks, " << replay.getCheckpointsChecked()
+			<< " checkpoints checked, " << replay.getMismatches() << " mismatched";
+		if( replay.getMismatches() > 0 )
+			cout << " (the first at tick " << replay.getFirstMismatch() << ")";
+		cout << endl;
+		cout << "  frames (ms) p50 " << frames.p50 << ", p95 " << frames.p95 << ", p99 " << frames.p99
+			<< ", max " << frames.max << " over " << frames.count << " frames" << endl;
+		cout << "  ticks (us) p50 " << ticks.p50 << ", p95 " << ticks.p95 << ", p99 " << ticks.p99
+			<< ", max " << ticks.max << endl;
 	}
 
 public:
-	Shazam()
+	Shazam() : input( sim ), replay( sim )
 	{
-		timer = 0; won = oob = false;
+		timer = 0;
 		font = Font(BITMAP_8X13); bigFont = Font(TIMES_ROMAN_24); 
-		player.resetScore();
+		povInterval = POV_INTERVAL;
+		povAge = 0;
+		povPixelError = POV_LOD_PIXEL_ERROR;
+		povRefreshed = false;
+		mainMs = povMs = 0;
+		frameSeconds = 0;
+		frameOverlay = false;
+		replaying = replayStarted = replayReported = false;
+		renderer.setStarDivisor( POV_STAR_DIVISOR );
 	};
 
-	ShazamMode getMode(){ return mode; }
+	/* Starts loading the game's meshes from the working directory */
+	void loadAsync(){ sim.loadAsync(); }
+
+	/* Waits for the meshes, false if some did not load */
+	bool finishLoading(){ return sim.finishLoading(); }
+
+	ShazamMode getMode(){ return sim.getMode(); }
 	
-	bool isPlayerDead()
-	{
-		return playerDead;
-	}
+	bool isPlayerDead(){ return sim.isPlayerDead(); }
 
-	void killPlayer()
+	/* Records the game from startGame() on, saveRecording() writes it to path */
+	void recordTo( const string& path )
 	{
-		won = false;
-		playerDead = true;
-		player.stopMoving();
+		recordPath = path;
+		input.record();
 	}
 
-	void revivePlayer()
+	/* Saves what recordTo() asked for, call on the way out */
+	void saveRecording()
 	{
-		won = false;
-		playerDead = false;
-		player.setFuel( STARTING_FUEL );
+		if( !input.isRecording() )
+			return;
+		const InputRecording& r = input.finish();
+		if( r.save( recordPath ) )
+			cout << "Recorded " << r.ticks << " ticks (" << r.events.size() << " inputs) to " << recordPath << endl;
+		else
+			cerr << "Could not write the recording to " << recordPath << endl;
 	}
 
-	void startGame()
-	{ 
-		//cout << "Loading..." << endl;
-		player.resetScore();
-		oob = false;
-		revivePlayer();
-		mode = PLAYING; 
-
-		universe.generate();
-		player.setDefault();
+	/* Plays the recording in path from startGame() on, ignoring the mouse
+	   and keys that steer. False if it could not be read. */
+	bool replayFrom( const string& path )
+	{
+		if( !replayed.load( path ) )
+			return false;
+		replaying = true;
+		return true;
 	}
 
-	void goToMainMenu()
-	{ 
-		mode = MAIN_MENU; 
-	}
+	bool isReplaying(){ return replaying; }
 
-	void winGame()
+	/* Generating takes a while, none of it is owed to the clock. A new
+	   game gets a new seed, except in a replay which brings its own. */
+	void startGame()
 	{
-		drawWonGame();
-		won = true;
-		player.stopMoving();
+		if( !replaying )
+			input.startGame( (unsigned)time( NULL ) );
+		else if( !replayStarted )
+		{
+			replay.start( replayed );
+			replayStarted = true;
+		}
+		else
+			return; /* the recording plays again itself if it did */
+		clock.reset();
+		frameTimer.reset();
 	}
 
+	void goToMainMenu(){ sim.goToMainMenu(); }
+
 	void drawUniverse()
 	{
-		player.applyShape();
-		player.update(); 
-		setViewport( 0, g_screenWidth, 0, g_screenHeight);
-		if( oob )
+		PROFILE_SCOPE( "Shazam::drawUniverse" );
+		Universe& universe = sim.getUniverse();
+		Player player = sim.getPlayerBetweenTicks( clock.getAlpha() );
+		Stopwatch sw;
+
+		renderer.setTickAlpha( clock.getAlpha() );
+		renderer.resetStats();
+		renderer.applyProjection( player );
+		renderer.applyView( player );
+		renderer.applyViewport( 0, g_screenWidth, 0, g_screenHeight);
+		if( sim.isOOB() )
 		{
 			glColor3f( 0.5f, 0.0f, 0.0f );
 			glPushMatrix();
-				universe.drawOOBGrid3D( UNIVERSE_SIZE + DEAD_ZONE );
+				renderer.drawOOBGrid3D( UNIVERSE_SIZE + DEAD_ZONE );
 			glPopMatrix();
 		}
-		universe.draw();
-		universe.drawStars();
+		renderer.drawUniverse( universe );
+		renderer.drawStars( universe );
 
 		/* draw player HUD */
-		player.drawHud();
-		if( oob && !playerDead )
+		renderer.drawHud( player, sim.hasTarget() );
+		if( sim.isOOB() && !sim.isPlayerDead() )
 			drawOOBWarning();
-		if( playerDead && !won )
+		if( sim.isPlayerDead() && !sim.hasWon() )
 			drawLostGame();
-		if( won )
+		if( sim.hasWon() )
 			drawWonGame();
 
-		drawObjectPov( universe.getFirstBadGuy() );
+		mainStats = renderer.getStats();
+		mainMs = sw.elapsedMs();
 
-	}
-
-	void updateGame()
-	{
-		if( universe.checkCollisionBadGuys( player ) >= 0 )		
-			player.increaseScore( 10 );
+		sw.reset();
+		renderer.resetStats();
+		drawObjectPov();
+		povStats = renderer.getStats();
+		povMs = sw.elapsedMs();
 
-		if( universe.checkCollisionPowerUps( player ) >= 0 )
-		{
-			player.increaseFuel( 40 );
-		}
+		frameStats = mainStats;
+		frameStats.add( povStats );
+		countRenderStats( frameStats );
 
-		if( universe.checkOOB( player ) )
+		renderTimes.add( (float)(mainMs + povMs) );
+		if( frameOverlay )
 		{
-			if( universe.checkDeadZone( player ) )
-			{
-				if( !playerDead )
-					player.increaseFuel( -10 ); /* lose fuel FAST */
-			}
-			oob = true;
-		}
-		else
-		{
-			oob = false;
+			renderer.applyViewport( 0, g_screenWidth, 0, g_screenHeight );
+			renderer.drawFrameOverlay( frameTimes, simTimes, renderTimes );
 		}
+	}
 
-		if( player.checkFuel() <= 0.0f )
-			killPlayer();
+	RenderStats getFrameStats(){ return frameStats; }
 
-		/* Travelling faster uses more fuel! */
-		if( !playerDead && !won)
-			player.increaseFuel( abs(player.getVelocity()) * -0.1f - 0.015f );
+	/* The last frame split into the main view and the enemy POV inset, with
+	   the CPU milliseconds each took to issue. refreshed is false when the
+	   inset was put back from its texture. */
+	void getFrameCost( RenderStats& main, double& mainTime, RenderStats& pov, double& povTime, bool& refreshed )
+	{
+		main = mainStats; mainTime = mainMs;
+		pov = povStats; povTime = povMs;
+		refreshed = povRefreshed;
+	}
 
-		if( universe.getNumBadGuys() <= 0 && !playerDead )
-			winGame();
+	/* Enemy POV inset settings: frames between renderings (1 = every frame),
+	   its level of detail error in pixels and how sparse its stars are */
+	void setPovInterval( int frames ){ povInterval = frames < 1 ? 1 : frames; }
+	void setPovPixelError( float pixels ){ povPixelError = pixels; }
+	void setPovStarDivisor( int divisor ){ renderer.setStarDivisor( divisor ); }
 
-		universe.updateRotations();
-		//player.addRotation( 0, 0, player.getLookVelocity().x );
-	}
+	/* Switches meshes between batched and per-face drawing */
+	void toggleBatching(){ renderer.setBatching( !renderer.getBatching() ); }
+	bool isBatching(){ return renderer.getBatching(); }
 
-	bool hasWon(){ return won; }
+	/* Switches distance based level of detail on and off */
+	void toggleLOD(){ renderer.setLOD( !renderer.getLOD() ); }
+	bool isLOD(){ return renderer.getLOD(); }
 
-	void playerYaw( float amt )
-	{ 
-		//player.addRotation( 0.0f, amt, 0.0f );
-		player.yaw(amt);
-	}
-	void playerPitch( float amt )
-	{
-		//player.addRotation( amt, 0.0f, 0.0f );
-		player.pitch( amt ); 
-	}
+	/* Switches bad guys and power ups between instanced and per-object drawing */
+	void toggleInstancing(){ renderer.setInstancing( !renderer.getInstancing() ); }
+	bool isInstancing(){ return renderer.getInstancing(); }
 
-	void playerRoll( float amt )
-	{
-		player.accelRoll( amt );
-	}
+	/* Shows and hides the frame time overlay */
+	void toggleFrameOverlay(){ frameOverlay = !frameOverlay; }
+	bool isFrameOverlay(){ return frameOverlay; }
 
-	void playerRoll2( float amt )
-	{
-		player.roll( amt );
-	}
+	/* Switches frustum culling of objects and stars on and off */
+	void toggleCulling(){ renderer.setCulling( !renderer.getCulling() ); }
+	bool isCulling(){ return renderer.getCulling(); }
 
-	void movePlayerForward( float amt )
-	{	
-		if( !playerDead && !won)
-			player.accelForward( amt ); 
-	}
-	void movePlayerRight( float amt )
-	{ 
-		if( !playerDead && !won )
-			player.moveRight( amt ); 
-	}
+	void updateGame(){ tick(); }
 
-	void toggleHitBoxes()
+	/* Runs however many ticks the real time since the last call is worth,
+	   call once a frame */
+	void advanceGame()
 	{
-		universe.toggleHitBoxVisible();
+		PROFILE_SCOPE( "Shazam::advanceGame" );
+		frameSeconds = frameTimer.elapsedUs() / 1e6;
+		frameTimer.reset();
+		Stopwatch sw;
+		for( int ticks = clock.advance( frameSeconds ); ticks > 0; ticks-- )
+			tick();
+		if( replaying && !replay.isFinished() )
+			replayFrameMs.push_back( frameSeconds * 1000 );
+		frameTimes.add( (float)(frameSeconds * 1000) );
+		simTimes.add( (float)sw.elapsedMs() );
 	}
 
-};
+	bool hasWon(){ return sim.hasWon(); }
+
+	/* Steering goes through the recorder, and nowhere during a replay */
+	void playerYaw( float amt ){ if( !replaying ) input.playerYaw( amt ); }
+	void playerPitch( float amt ){ if( !replaying ) input.playerPitch( amt ); }
+	void playerRoll( float amt ){ if( !replaying ) input.playerRoll( amt ); }
+	void playerRoll2( float amt ){ if( !replaying ) input.playerRoll2( amt ); }
+	void movePlayerForward( float amt ){ if( !replaying ) input.movePlayerForward( amt ); }
+	void movePlayerRight( float amt ){ if( !replaying ) input.movePlayerRight( amt ); }
 
+	void toggleHitBoxes(){ sim.toggleHitBoxes(); }
 
+};
@@ -0,0 +1,2617 @@
+/* ShazamBench.cpp
+ *
+ * Headless benchmarks for SHAZAM. Builds without GLUT, OpenGL or FMOD:
+ *
+ *   g++ -O2 -std=c++11 -pthread -o ShazamBench Source/ShazamBench.cpp
+ *
+ * Usage: ShazamBench <benchmark> [options]
+ *
+ *   tick    Steps Simulation::updateGame() with scripted input and reports
+ *           ticks per second and per-tick latency percentiles.
+ *             --sizes 100,200,400   UNIVERSE_SIZE values to run
+ *             --ticks 5000          timed ticks per size
+ *             --warmup 200          untimed ticks before timing
+ *             --stars N             stars to generate instead of size*25
+ *             --counters FILE       stream every tick's counters (Counters.h)
+ *                                   to FILE, JSON lines for .json/.jsonl
+ *
+ *   collide Player-vs-everything collision query through SpatialHash against
+ *           the old linear Object::checkCollision scan, at a constant entity
+ *           density so the hash query time should stay flat as count grows.
+ *           "rand" queries jump anywhere (cold cache), "path" queries follow
+ *           a ship flying through the entities like the game does.
+ *             --counts 1000,10000,100000
+ *             --queries 20000       hash queries per count (scan runs 1/1000th)
+ *
+ *   meshload  Cold and warm load times of each mesh as .3vnc text (read())
+ *           and as a mapped .vncb (readBinary()), plus load() through the
+ *           cache. Cold runs first ask the OS to drop the file from its cache
+ *           (POSIX only, elsewhere "cold" is only the first load).
+ *             --runs 200            warm loads to average
+ *
+ *   batch   Per mesh, the draw calls and vertices of per-face immediate mode
+ *           against its compiled MeshBatch, and how long the batch takes to
+ *           build.
+ *             --runs 200            builds to average
+ *
+ *   meshlayout  Heap blocks, bytes and per-corner walk time of the flat mesh
+ *           arrays against the old Face/VertexID layout (a heap block per
+ *           face), over many copies so they don't all fit in cache.
+ *             --copies 64           copies of each mesh
+ *             --passes 200          walks over all copies
+ *             --scatter             interleave the old layout's face blocks
+ *                                   across copies, as on a well used heap
+ *
+ *   bvh     Per mesh, sphere-touch and raycast latency through its MeshBVH
+ *           against testing every triangle (answers are cross-checked),
+ *           and cached getCenter() against re-averaging the vertices.
+ *             --queries 20000       random queries around each mesh
+ *
+ *   lod     The levels of detail each mesh gets, then how many mesh vertices
+ *           a frame submits with and without them during scripted flight,
+ *           for the main view and the enemy POV window.
+ *             --sizes 100,200,400   UNIVERSE_SIZE values to run
+ *             --frames 2000         frames to average
+ *             --height 480          main view height in pixels
+ *             --pov 150             POV window height in pixels
+ *
+ *   cull    Fraction of objects and star blocks frustum culling skips for
+ *           the main view and the enemy POV window along the scripted
+ *           flight, and what the culling tests cost per frame.
+ *             --sizes 100,200,400   UNIVERSE_SIZE values to run
+ *             --frames 2000         frames to average
+ *
+ *   registry  Time to get the game's meshes loaded and ready (BVH, levels
+ *           of detail) one after another on the calling thread, against
+ *           through a MeshRegistry with a number of worker threads, and how
+ *           long request() itself holds the caller up.
+ *             --threads 1,2,4       worker counts to run
+ *             --runs 20             loads to average
+ *
+ *   math    The old double Vector3 against VecMath.h's float Vec3 for
+ *           vector work, array copies and turning camera bases, the old and
+ *           new model matrix, and Mat4/Quat products through SIMD against
+ *           their plain versions, with the largest difference between them.
+ *             --count 100000        vectors (a tenth as many matrices)
+ *             --passes 50           times over them
+ *
+ *   entities  Bytes per entity and the time of each per-tick or per-frame
+ *           pass (spinning, culling, collision spheres, model matrices)
+ *           over bad guys kept as one Object each against EntityStore's
+ *           packed columns, checking both give the same answers.
+ *             --counts 1000,10000,100000
+ *             --passes 50           times over every entity
+ *
+ *   spin    Entities turned per microsecond by the old per-Object switch, the
+ *           same switch over packed columns, and the angular velocity column
+ *           added on with wrapping a float at a time and through SIMD.
+ *             --counts 1000,10000,100000
+ *             --passes 200          ticks to average
+ *
+ *   overlap The player's sphere, then volleys of projectile spheres, against
+ *           every entity's collision sphere: Object::checkCollision() per
+ *           pair, SphereSet's plain and SIMD kernels, and SpatialHash
+ *           queries, with every answer checked against the plain kernel.
+ *             --counts 1000,10000,100000
+ *             --probes 64           projectiles per volley
+ *             --queries 2000        player queries (a twentieth as many volleys)
+ *
+ *   churn   Despawning and spawning many entities a tick through
+ *           Universe::spawn()/despawn() and generational handles, against
+ *           vector::erase with a hash relabel of everything after the hole,
+ *           and whether references held across the churn notice their
+ *           entity has gone. Then moves and rescales some entities through
+ *           Universe::move()/resize() and checks that collision queries
+ *           still agree with testing every entity.
+ *             --entities 10000,100000
+ *             --churn 100,1000,5000 entities despawned and spawned per tick
+ *             --ticks 200
+ *             --held 1000           handles (or old indices) held throughout
+ *
+ *   jobs    Each phase split across a JobSystem (turning, rebuilding the
+ *           broad phase, the player's and a volley's collision queries,
+ *           building every entity's modelview) and whole ticks, on a large
+ *           universe with 1 to N threads, checked against serial answers.
+ *             --size 400000         UNIVERSE_SIZE (100000 entities)
+ *             --stars 1000          stars, they play no part
+ *             --threads 1,2,4       pool sizes, by default powers of two
+ *                                   up to the hardware's thread count
+ *             --runs 50             runs of each phase, the median counts
+ *             --probes 64           projectiles in the volley
+ *
+ *   timestep  The same scripted flight (input by time, as the mouse and
+ *           keys give it) at several frame rates, one tick per frame as the
+ *           game used to run against the fixed rate TickClock, and how
+ *           evenly the ship moves from one drawn frame to the next with and
+ *           without interpolating between ticks.
+ *             --rates 30,60,144,500 frames per second
+ *             --seconds 20          of play
+ *             --jitter 20           frame times vary by up to this percent
+ *             --stall 500           ms of one long frame halfway, 0 for none
+ *             --size 400            UNIVERSE_SIZE, room to fly in
+ *
+ *   profile  What a PROFILE_SCOPE costs with the profiler off (compiled
+ *           in but not recording) and recording, against the same loop with
+ *           no scope, then ticks with recording off and on, and how many
+ *           events a tick records. Build with -DSHAZAM_NO_PROFILE to see the
+ *           scopes compiled out.
+ *             --scopes 1000000      scopes to time
+ *             --size 400            UNIVERSE_SIZE for the ticks
+ *             --ticks 2000          ticks each way
+ *             --out FILE            also write the recorded ticks there as
+ *                                   Chrome trace JSON
+ *
+ *   counters  What counting costs: a Counter::add(), closing a frame with
+ *           and without a stream, and a new/delete pair with allocations
+ *           counted (build with -DSHAZAM_NO_ALLOC_COUNT to compare). Then
+ *           every counter's mean and peak per tick over the scripted flight.
+ *             --adds 10000000       adds to time
+ *             --frames 100000       frames to close
+ *             --size 400            UNIVERSE_SIZE for the flight
+ *             --ticks 2000          ticks of it
+ *
+ *   overlay  What the frame time overlay's bookkeeping costs a frame: the
+ *           three samples it keeps with the overlay hidden, and with it
+ *           shown the nine percentiles too, over a flight of real ticks.
+ *           Counts heap allocations meanwhile, which should be none.
+ *             --frames 100000       frames to time
+ *             --size 400            UNIVERSE_SIZE for the ticks
+ *
+ *   replay  Records the scripted flight (seed, input and state hashes, see
+ *           Replay.h) or reads a recording SHAZAM --record made, then plays
+ *           it back headless with each pool size, checking every state hash
+ *           and reporting tick latency percentiles. Exits 1 on a mismatch.
+ *             --in FILE             recording to play, instead of flying
+ *             --out FILE            save the scripted flight's recording
+ *             --ticks 3600          ticks to fly (a minute of play)
+ *             --size 400            UNIVERSE_SIZE to fly in
+ *             --seed 1234           seed the universe is generated from
+ *             --threads 1,2,4       pool sizes to play back with
+ *
+ *   random  Random's xoshiro256** streams against the rand() based Random
+ *           it replaced: ns per number one at a time and through fill(),
+ *           how many distinct values each gives over a wide range, then
+ *           Universe::generate() at growing sizes, checking that a seed
+ *           regenerates the same universe and that the star count leaves
+ *           the bad guys and power ups where they were.
+ *             --count 10000000      numbers to time each way
+ *             --sizes 400,4000,40000  UNIVERSE_SIZE values to generate
+ *             --stars N             stars instead of size*25
+ *
+ *   Common options:
+ *             --data DIR            folder holding the .3vnc meshes (Binaries)
+ */
+
+#include "Simulation.h"
+#include "Frustum.h"
+#include "Vector3.h" /* the old types, for comparison */
+#include "Bench.h"
+#include "TickClock.h"
+#include "FrameTimes.h"
+#include "Replay.h"
+#include <type_traits>
+#include <cstring>
+#include <ctime>
+
+/* Scripted pilot: thrust in bursts and weave around so that the player
+   sweeps through the universe and actually hits things. sim is a
+   Simulation or anything with its input methods (an InputRecorder). */
+template<class Pilot> void applyScriptedInput( Pilot& sim, int tick )
+{
+	if( tick % 40 == 0 )
+		sim.movePlayerForward( (tick / 40) % 4 == 3 ? -0.1f : 0.1f );
+	sim.playerYaw( 0.5f * sinf( tick * 0.01f ) );
+	sim.playerPitch( 0.3f * cosf( tick * 0.013f ) );
+}
+
+/* What a bench returns when the game's meshes are not where --data says */
+int meshesMissing()
+{
+	fprintf( stderr, "Could not load meshes, pass --data <Binaries folder>\n" );
+	return 1;
+}
+
+/* The turtle the entity benches fill space with, loaded and waited for.
+   Check isReady(), it is not if the mesh could not be loaded. */
+MeshHandle loadTurtle( const string& dataDir, const MeshSetup& setup = MeshSetup( Vec3(0,0,0), false ) )
+{
+	MeshHandle turtle = MeshRegistry::shared().request( dataDir + "turtle.3vnc", setup );
+	turtle.wait();
+	return turtle;
+}
+
+#define ENTITY_SPACING 10.0f /* one turtle per 10x10x10 block of space */
+
+/* A random point in the cube from the origin to (side, side, side) */
+Vec3 randomPoint( Random& rnd, float side )
+{
+	float x = (float)rnd.RandomNum() * side, y = (float)rnd.RandomNum() * side;
+	return Vec3( x, y, (float)rnd.RandomNum() * side );
+}
+
+/* Random positions for n entities, ENTITY_SPACING apart on average.
+   Returns the side of the cube they fill. */
+float scatterEntities( int n, Random& rnd, vector<Vec3>& positions )
+{
+	float side = ENTITY_SPACING * (float)cbrt( (double)n );
+	positions.resize( n );
+	for( int i = 0; i < n; i++ )
+		positions[i] = randomPoint( rnd, side );
+	return side;
+}
+
+int benchTick( int argc, char **argv )
+{
+	vector<int> sizes = argIntList( argc, argv, "--sizes", "100,200,400" );
+	int ticks = argInt( argc, argv, "--ticks", 5000 );
+	int warmup = argInt( argc, argv, "--warmup", 200 );
+	int stars = argInt( argc, argv, "--stars", 0 );
+	string counters = argValue( argc, argv, "--counters", "" );
+	string dataDir = dataDirArg( argc, argv );
+
+	if( !counters.empty() && !Counters::shared().openStream( counters ) )
+	{
+		fprintf( stderr, "Could not open %s\n", counters.c_str() );
+		return 1;
+	}
+
+	printf( "%8s %8s %8s %8s %10s %12s %9s %9s %9s %9s\n", "size", "badguys", "powerups",
+		"stars", "gen(ms)", "ticks/s", "p50(us)", "p95(us)", "p99(us)", "max(us)" );
+
+	for( size_t s = 0; s < sizes.size(); s++ )
+	{
+		setUniverseSize( sizes[s] );
+		if( stars > 0 )
+			setNumStars( stars );
+
+		Simulation sim;
+		if( !sim.load( dataDir ) )
+			return meshesMissing();
+
+		Stopwatch gen;
+		sim.startGame();
+		double genMs = gen.elapsedMs();
+
+		vector<double> samples;
+		samples.reserve( ticks );
+
+		for( int t = 0; t < warmup + ticks; t++ )
+		{
+			/* Keep the pilot alive so every tick does the same kind of work */
+			if( sim.isPlayerDead() )
+				sim.revivePlayer();
+
+			applyScriptedInput( sim, t );
+
+			Stopwatch sw;
+			sim.updateGame();
+			double us = sw.elapsedUs();
+
+			if( t >= warmup )
+				samples.push_back( us );
+			if( Counters::shared().isStreaming() )
+				Counters::shared().endFrame();
+		}
+
+		LatencyStats stats( samples );
+		printf( "%8d %8d %8d %8d %10.2f %12.0f %9.2f %9.2f %9.2f %9.2f\n", sizes[s], NUM_BADGUYS,
+			NUM_POWERUPS, NUM_STARS, genMs, stats.count / (stats.total / 1e6),
+			stats.p50, stats.p95, stats.p99, stats.max );
+	}
+
+	return 0;
+}
+
+int benchCollide( int argc, char **argv )
+{
+	vector<int> counts = argIntList( argc, argv, "--counts", "1000,10000,100000" );
+	int queries = argInt( argc, argv, "--queries", 20000 );
+	string dataDir = dataDirArg( argc, argv );
+
+	MeshHandle turtle = loadTurtle( dataDir );
+	if( !turtle.isReady() )
+		return meshesMissing();
+
+	Random rnd;
+	Object player( turtle );
+
+	printf( "%8s %10s %14s %14s %14s %10s %14s\n", "count", "build(ms)", "rand avg(ns)",
+		"rand p99(ns)", "path avg(ns)", "hits/qry", "scan avg(us)" );
+
+	for( size_t c = 0; c < counts.size(); c++ )
+	{
+		int n = counts[c];
+		vector<Vec3> positions;
+		float side = scatterEntities( n, rnd, positions );
+
+		vector<Object> objects( n, Object( turtle ) );
+		for( int i = 0; i < n; i++ )
+		{
+			objects[i].position = positions[i];
+			objects[i].scale = Vec3( 1, 2, 1 );
+		}
+
+		Stopwatch build;
+		SpatialHash hash;
+		hash.clear( n );
+		for( int i = 0; i < n; i++ )
+			hash.insert( i, objects[i].getCenter(), objects[i].getRadius() );
+		double buildMs = build.elapsedMs();
+
+		/* Half the queries land right on top of an entity so there is work to find */
+		vector<Vec3> where( queries );
+		for( int q = 0; q < queries; q++ )
+		{
+			if( q & 1 )
+				where[q] = randomPoint( rnd, side );
+			else
+				where[q] = objects[rnd.RandomInt( n )].position;
+		}
+
+		vector<int> hits;
+		vector<double> samples( queries );
+		vector<int> hitCount( queries );
+		long totalHits = 0;
+		for( int q = 0; q < queries; q++ )
+		{
+			player.position = where[q];
+			Vec3 center = player.getCenter();
+			Stopwatch sw;
+			hits.clear();
+			hitCount[q] = hash.query( center, player.getRadius(), hits );
+			samples[q] = sw.elapsedUs() * 1000.0;
+			totalHits += hitCount[q];
+		}
+		LatencyStats stats( samples );
+
+		/* A ship flying a straight line, which is what the game actually asks for */
+		Vec3 pos = randomPoint( rnd, side );
+		Stopwatch path;
+		for( int q = 0; q < queries; q++ )
+		{
+			pos.set( fmod( pos.x + 0.31, side ), fmod( pos.y + 0.17, side ), fmod( pos.z + 0.23, side ) );
+			hits.clear();
+			hash.query( pos, player.getRadius(), hits );
+		}
+		double pathNs = path.elapsedUs() * 1000.0 / queries;
+
+		/* The old way, which doubles as a check on the hash's answers */
+		int scans = max( 1, queries / 1000 );
+		Stopwatch scan;
+		long scanHits = 0, hashHits = 0;
+		for( int q = 0; q < scans; q++ )
+		{
+			player.position = where[q];
+			for( int i = 0; i < n; i++ )
+				if( objects[i].checkCollision( player ) )
+					scanHits++;
+			hashHits += hitCount[q];
+		}
+		double scanUs = scan.elapsedUs() / scans;
+
+		if( scanHits != hashHits )
+			fprintf( stderr, "MISMATCH: scan found %ld hits, hash found %ld\n", scanHits, hashHits );
+
+		printf( "%8d %10.2f %14.1f %14.1f %14.1f %10.2f %14.1f\n", n, buildMs, stats.mean, stats.p99,
+			pathNs, (double)totalHits / queries, scanUs );
+	}
+
+	return 0;
+}
+
+int benchMeshLoad( int argc, char **argv )
+{
+	const char *names[] = { "turtle.3vnc", "player.3vnc", "powerUp.3vnc" };
+	int runs = argInt( argc, argv, "--runs", 200 );
+	string dataDir = dataDirArg( argc, argv );
+
+	printf( "%-14s %9s %9s %12s %12s %12s %12s %12s\n", "mesh", "text(B)", "vncb(B)",
+		"text cold", "text warm", "vncb cold", "vncb warm", "load() warm" );
+
+	for( int m = 0; m < 3; m++ )
+	{
+		string src = dataDir + names[m];
+		string bin = VNCMesh::binaryPath( src );
+
+		/* Make sure the cache exists and is fresh */
+		{
+			VNCMesh mesh;
+			if( !mesh.load( src ) )
+			{
+				fprintf( stderr, "Could not load %s, pass --data <Binaries folder>\n", src.c_str() );
+				return 1;
+			}
+		}
+
+		uint64_t textSize = 0, binSize = 0;
+		int64_t t;
+		fileStamp( src, textSize, t );
+		fileStamp( bin, binSize, t );
+
+		double times[5];
+		for( int kind = 0; kind < 5; kind++ )
+		{
+			bool cold = kind == 0 || kind == 2;
+			int n = cold ? 1 : runs;
+			Stopwatch sw;
+			for( int r = 0; r < n; r++ )
+			{
+				if( cold )
+				{
+					dropFileCache( kind == 0 ? src : bin );
+					sw.reset();
+				}
+				VNCMesh mesh;
+				if( kind < 2 )
+					mesh.read( src );
+				else if( kind < 4 )
+					mesh.readBinary( bin );
+				else
+					mesh.load( src );
+			}
+			times[kind] = sw.elapsedUs() / n;
+		}
+
+		printf( "%-14s %9llu %9llu %10.1fus %10.1fus %10.1fus %10.1fus %10.1fus\n", names[m],
+			(unsigned long long)textSize, (unsigned long long)binSize,
+			times[0], times[1], times[2], times[3], times[4] );
+	}
+
+	return 0;
+}
+
+/* What drawing each mesh costs per-face versus as a compiled MeshBatch. This
+   is counting only, no GL; the front end's F2/F3 keys compare the two paths
+   on a real (or Mesa software) context. */
+int benchBatch( int argc, char **argv )
+{
+	const char *names[] = { "turtle.3vnc", "player.3vnc", "powerUp.3vnc" };
+	int runs = argInt( argc, argv, "--runs", 200 );
+	string dataDir = dataDirArg( argc, argv );
+
+	printf( "%-14s %6s | %10s %10s %10s | %10s %10s %10s %10s %10s\n", "mesh", "faces",
+		"imm calls", "imm verts", "gl entries", "draw calls", "verts", "indices", "tris", "build" );
+
+	for( int m = 0; m < 3; m++ )
+	{
+		VNCMesh mesh;
+		if( !mesh.load( dataDir + names[m] ) )
+		{
+			fprintf( stderr, "Could not load %s, pass --data <Binaries folder>\n", names[m] );
+			return 1;
+		}
+
+		/* Per face: glColor, glBegin, glEnd, then glNormal and glVertex per corner */
+		int glEntries = 3 * mesh.getNumFaces() + 2 * mesh.getNumCorners();
+
+		Stopwatch sw;
+		for( int r = 0; r < runs; r++ )
+		{
+			mesh.setOffset( mesh.getOffset() ); /* forces a rebuild */
+			mesh.getBatch();
+		}
+		double buildUs = sw.elapsedUs() / runs;
+		const MeshBatch& batch = mesh.getBatch();
+
+		printf( "%-14s %6d | %10d %10d %10d | %10d %10d %10d %10d %8.1fus\n", names[m],
+			mesh.getNumFaces(), mesh.getNumFaces(), mesh.getNumCorners(), glEntries,
+			1, batch.getNumVertices(), (int)batch.indices.size(), batch.getNumTriangles(), buildUs );
+	}
+
+	return 0;
+}
+
+/* The mesh layout before the .vncb format: a heap block per face for its
+   corners, chased through a pointer. Kept here only to compare against. */
+struct LegacyVertexID
+{
+	int vertIndex, normIndex;
+};
+
+struct LegacyFace
+{
+	int nVerts;
+	LegacyVertexID *vert;
+	float color[3];
+
+	LegacyFace(){ nVerts = 0; vert = NULL; }
+	~LegacyFace(){ delete [] vert; }
+};
+
+struct LegacyMesh
+{
+	int numVerts, numNormals, numFaces;
+	Point3 *pt;
+	Vector3 *norm;
+	LegacyFace *face;
+
+	/* Allocations and bytes the old read() made for this mesh */
+	int blocks;
+	size_t bytes, heapBytes;
+
+	void count( size_t n )
+	{
+		/* glibc style chunks: 8 bytes of header, 16 byte granules, 32 minimum */
+		blocks++;
+		bytes += n;
+		heapBytes += max( (size_t)32, (n + 8 + 15) & ~(size_t)15 );
+	}
+
+	LegacyMesh( VNCMesh& m )
+	{
+		numVerts = m.getNumVerts(); numNormals = m.getNumNormals(); numFaces = m.getNumFaces();
+		blocks = 0; bytes = heapBytes = 0;
+
+		pt = new Point3[numVerts];      count( numVerts * sizeof(Point3) );
+		norm = new Vector3[numNormals]; count( numNormals * sizeof(Vector3) );
+		face = new LegacyFace[numFaces];
+		count( numFaces * sizeof(LegacyFace) + sizeof(size_t) ); /* array cookie for the destructors */
+
+		for( int i = 0; i < numVerts; i++ )
+		{
+			const float *p = m.getPositions() + 3*i;
+			pt[i] = Point3( p[0], p[1], p[2] );
+		}
+		for( int i = 0; i < numNormals; i++ )
+		{
+			Vec3 n = m.getNormal( i );
+			norm[i].set( n.x, n.y, n.z );
+		}
+	}
+
+	/* The per-face part of the old read(), split out so copies can take turns */
+	void readFace( VNCMesh& m, int f )
+	{
+		face[f].nVerts = m.getFaceSize( f );
+		face[f].vert = new LegacyVertexID[face[f].nVerts];
+		count( face[f].nVerts * sizeof(LegacyVertexID) );
+		for( int k = 0; k < face[f].nVerts; k++ )
+		{
+			face[f].vert[k].vertIndex = m.getFaceVertIndex( f, k );
+			face[f].vert[k].normIndex = m.getFaceNormIndex( f, k );
+		}
+		memcpy( face[f].color, m.getFaceColor( f ), sizeof(face[f].color) );
+	}
+
+	~LegacyMesh()
+	{
+		delete [] pt;
+		delete [] norm;
+		delete [] face;
+	}
+
+	/* What draw() touched: every corner's position and normal */
+	double walk()
+	{
+		double sx = 0, sy = 0, sz = 0;
+		for( int f = 0; f < numFaces; f++ )
+		{
+			sx += face[f].color[0];
+			for( int k = 0; k < face[f].nVerts; k++ )
+			{
+				const Point3& p = pt[face[f].vert[k].vertIndex];
+				const Vector3& n = norm[face[f].vert[k].normIndex];
+				sx += p.x + n.x;
+				sy += p.y + n.y;
+				sz += p.z + n.z;
+			}
+		}
+		return sx + sy + sz;
+	}
+};
+
+/* The same walk over VNCMesh's flat arrays */
+double walkFlat( VNCMesh& m )
+{
+	const float *pos = m.getPositions(), *norm = m.getNormals(), *color = m.getFaceColors();
+	const uint32_t *start = m.getFaceStarts(), *vi = m.getVertIndices(), *ni = m.getNormIndices();
+	float sx = 0, sy = 0, sz = 0;
+	for( int f = 0; f < m.getNumFaces(); f++ )
+	{
+		sx += color[3*f];
+		for( uint32_t c = start[f]; c < start[f+1]; c++ )
+		{
+			const float *p = pos + 3*vi[c], *n = norm + 3*ni[c];
+			sx += p[0] + n[0];
+			sy += p[1] + n[1];
+			sz += p[2] + n[2];
+		}
+	}
+	return (double)sx + sy + sz;
+}
+
+/* Memory and iteration cost of the flat mesh arrays against the old
+   block-per-face layout, walking many copies so they don't all sit in cache */
+int benchMeshLayout( int argc, char **argv )
+{
+	const char *names[] = { "turtle.3vnc", "player.3vnc", "powerUp.3vnc" };
+	int copies = argInt( argc, argv, "--copies", 64 );
+	int passes = argInt( argc, argv, "--passes", 200 );
+	bool scatter = argFlag( argc, argv, "--scatter" );
+	string dataDir = dataDirArg( argc, argv );
+
+	printf( "%-14s %7s | %7s %9s %9s %10s | %7s %9s %10s\n", "mesh", "corners",
+		"blocks", "bytes", "heap", "walk", "blocks", "bytes", "walk" );
+	printf( "%-14s %7s | %-38s | %-28s\n", "", "", "legacy Face/VertexID", "flat arrays" );
+
+	for( int m = 0; m < 3; m++ )
+	{
+		vector<VNCMesh*> flat( copies );
+		for( int i = 0; i < copies; i++ )
+		{
+			flat[i] = new VNCMesh;
+			if( !flat[i]->read( dataDir + names[m] ) )
+			{
+				fprintf( stderr, "Could not load %s, pass --data <Binaries folder>\n", names[m] );
+				return 1;
+			}
+		}
+		/* Built one after another on a fresh heap every mesh's face blocks end
+		   up neatly in a row; --scatter interleaves the copies' face blocks
+		   instead, like a heap that has seen some churn */
+		int faces = flat[0]->getNumFaces();
+		vector<LegacyMesh*> legacy( copies );
+		for( int i = 0; i < copies; i++ )
+		{
+			legacy[i] = new LegacyMesh( *flat[i] );
+			for( int f = 0; f < faces && !scatter; f++ )
+				legacy[i]->readFace( *flat[i], f );
+		}
+		for( int f = 0; f < faces && scatter; f++ )
+			for( int i = 0; i < copies; i++ )
+				legacy[i]->readFace( *flat[i], f );
+
+		double check[2] = { 0, 0 }, ns[2];
+		int corners = flat[0]->getNumCorners();
+		for( int kind = 0; kind < 2; kind++ )
+		{
+			Stopwatch sw;
+			for( int p = 0; p < passes; p++ )
+				for( int i = 0; i < copies; i++ )
+					check[kind] += kind ? walkFlat( *flat[i] ) : legacy[i]->walk();
+			ns[kind] = sw.elapsedUs() * 1000.0 / ((double)passes * copies * corners);
+		}
+
+		/* A flat mesh is one .vncb image, a single block (or none when mapped) */
+		MeshFileHeader h;
+		meshLayout( h, flat[0]->getNumVerts(), flat[0]->getNumNormals(), flat[0]->getNumFaces(), corners );
+		size_t image = h.fileSize;
+		printf( "%-14s %7d | %7d %9llu %9llu %8.2fns | %7d %9llu %8.2fns%s\n", names[m], corners,
+			legacy[0]->blocks, (unsigned long long)legacy[0]->bytes, (unsigned long long)legacy[0]->heapBytes,
+			ns[0], 1, (unsigned long long)image, ns[1],
+			fabs( check[0] - check[1] ) > 1e-3 * fabs( check[0] ) ? "  MISMATCH" : "" );
+
+		for( int i = 0; i < copies; i++ )
+		{
+			delete legacy[i];
+			delete flat[i];
+		}
+	}
+	printf( "walk is time per face corner, over %d copies of each mesh\n", copies );
+
+	return 0;
+}
+
+/* Sphere and ray queries against each mesh's BVH versus testing every
+   triangle, on random queries around the mesh. Answers must agree. */
+int benchBVH( int argc, char **argv )
+{
+	const char *names[] = { "turtle.3vnc", "player.3vnc", "powerUp.3vnc" };
+	int queries = argInt( argc, argv, "--queries", 20000 );
+	string dataDir = dataDirArg( argc, argv );
+	Random rnd;
+
+	printf( "%-14s %5s %5s %9s | %9s %9s %9s %9s | %9s %9s %9s %9s | %8s %8s\n", "mesh", "tris", "nodes",
+		"build", "sph bvh", "sph p99", "sph all", "hit %", "ray bvh", "ray p99", "ray all", "hit %", "center", "average" );
+
+	for( int m = 0; m < 3; m++ )
+	{
+		VNCMesh mesh;
+		if( !mesh.load( dataDir + names[m] ) )
+		{
+			fprintf( stderr, "Could not load %s, pass --data <Binaries folder>\n", names[m] );
+			return 1;
+		}
+
+		Stopwatch sw;
+		const MeshBVH& bvh = mesh.getBVH();
+		double buildUs = sw.elapsedUs();
+
+		/* Queries come from a box twice the size of the mesh's */
+		Vec3 lo = mesh.getBoxMin(), hi = mesh.getBoxMax();
+		float size = (float)max( hi.x - lo.x, max( hi.y - lo.y, hi.z - lo.z ) );
+		vector<float> pts( queries * 6 ), radii( queries );
+		for( int q = 0; q < queries; q++ )
+		{
+			for( int k = 0; k < 6; k++ )
+				pts[6*q + k] = (float)((&lo.x)[k % 3] - size/2 + rnd.RandomNum() * ((&hi.x)[k % 3] - (&lo.x)[k % 3] + size));
+			radii[q] = size * (0.02f + 0.1f * (float)rnd.RandomNum());
+		}
+
+		int mismatches = 0, sphereHits = 0, rayHits = 0;
+		vector<double> sphereUs, rayUs;
+		double sphereAll = 0, rayAll = 0;
+		for( int q = 0; q < queries; q++ )
+		{
+			const float *c = &pts[6*q];
+			sw.reset();
+			bool hit = bvh.touchesSphere( c, radii[q] );
+			sphereUs.push_back( sw.elapsedUs() );
+
+			sw.reset();
+			bool all = false;
+			for( int i = 0; i < bvh.getNumTriangles() && !all; i++ )
+			{
+				const BVHTriangle& t = bvh.getTriangle( i );
+				all = sphereTouchesTriangle( c, radii[q], t.v[0], t.v[1], t.v[2] );
+			}
+			sphereAll += sw.elapsedUs();
+			mismatches += hit != all;
+			sphereHits += hit;
+
+			/* Ray from one random point through another */
+			float d[3] = { pts[6*q+3] - c[0], pts[6*q+4] - c[1], pts[6*q+5] - c[2] };
+			float t = 0, tAll = FLT_MAX;
+			int face;
+			sw.reset();
+			hit = bvh.raycast( c, d, FLT_MAX, t, face );
+			rayUs.push_back( sw.elapsedUs() );
+
+			sw.reset();
+			all = false;
+			for( int i = 0; i < bvh.getNumTriangles(); i++ )
+			{
+				const BVHTriangle& tr = bvh.getTriangle( i );
+				float th;
+				if( rayHitsTriangle( c, d, tr.v[0], tr.v[1], tr.v[2], tAll, th ) )
+				{
+					tAll = th;
+					all = true;
+				}
+			}
+			rayAll += sw.elapsedUs();
+			mismatches += hit != all || (hit && fabs( t - tAll ) > 1e-4f * max( 1.0f, tAll ));
+			rayHits += hit;
+		}
+
+		/* getCenter() used to average every vertex on each call */
+		double centerSum = 0, averageSum = 0;
+		sw.reset();
+		for( int q = 0; q < queries; q++ )
+			centerSum += mesh.getCenter().x;
+		double centerNs = sw.elapsedUs() * 1000.0 / queries;
+		sw.reset();
+		for( int q = 0; q < queries; q++ )
+		{
+			double x = 0;
+			for( int i = 0; i < mesh.getNumVerts(); i++ )
+				x += mesh.getVertex( i ).x;
+			averageSum += x / mesh.getNumVerts();
+		}
+		double averageNs = sw.elapsedUs() * 1000.0 / queries;
+
+		LatencyStats sph( sphereUs ), ray( rayUs );
+		printf( "%-14s %5d %5d %7.1fus | %7.3fus %7.3fus %7.3fus %8.1f%% | %7.3fus %7.3fus %7.3fus %8.1f%% | %6.1fns %6.1fns%s\n",
+			names[m], bvh.getNumTriangles(), bvh.getNumNodes(), buildUs,
+			sph.mean, sph.p99, sphereAll / queries, 100.0 * sphereHits / queries,
+			ray.mean, ray.p99, rayAll / queries, 100.0 * rayHits / queries,
+			centerNs, averageNs,
+			mismatches || fabs( centerSum - averageSum ) > 1e-3 * fabs( centerSum ) + 1e-6 ? "  MISMATCH" : "" );
+	}
+	printf( "bvh/p99 are per query latency through the BVH, all is testing every triangle\n" );
+
+	return 0;
+}
+
+/* Vertices (indices) submitted for every bad guy and power up seen by cam
+   through a viewport height pixels tall, at full detail and with LOD */
+void countLODVertices( Universe& universe, Camera& cam, int height, long long& full, long long& lod )
+{
+	float vAng, asp, nearD, farD;
+	cam.getShape( vAng, asp, nearD, farD );
+	float pixelsAtUnit = height / (2.0f * tanf( vAng * (float)RADIANS_PER_DEGREE / 2 ));
+	Vec3 eye = cam.getPosition();
+
+	EntityStore& entities = universe.getEntities();
+	for( int i = 0; i < entities.size(); i++ )
+	{
+		VNCMesh *mesh = entities.getMesh( i );
+		full += mesh->getLOD( 0 ).indices.size();
+		lod += mesh->getLOD( entities.selectLOD( i, eye, pixelsAtUnit, LOD_PIXEL_ERROR ) ).indices.size();
+	}
+}
+
+/* The camera Shazam::drawObjectPov() uses: at the first bad guy, looking at the player */
+Camera povCamera( Simulation& sim )
+{
+	Universe& universe = sim.getUniverse();
+	Camera cam;
+	int badGuy = sim.getWatcher();
+	if( badGuy >= 0 )
+		cam.moveTo( universe.getEntities().position[badGuy] );
+	cam.setLookAt( sim.getPlayer().position );
+	cam.setNearPlane( 2.0f );
+	return cam;
+}
+
+/* The levels of detail each mesh gets, then the mesh vertices a frame
+   submits with and without them along the scripted flight, for the main
+   view and the enemy POV window (Renderer picks levels the same way) */
+int benchLOD( int argc, char **argv )
+{
+	const char *names[] = { "turtle.3vnc", "player.3vnc", "powerUp.3vnc" };
+	vector<int> sizes = argIntList( argc, argv, "--sizes", "100,200,400" );
+	int frames = argInt( argc, argv, "--frames", 2000 );
+	int mainHeight = argInt( argc, argv, "--height", 480 );
+	int povHeight = argInt( argc, argv, "--pov", 150 ); /* ENEMY_POV_WINDOW_HEIGHT in Shazam.h */
+	string dataDir = dataDirArg( argc, argv );
+
+	printf( "%-14s %5s %7s %7s %9s %9s\n", "mesh", "level", "tris", "verts", "error", "build" );
+	for( int m = 0; m < 3; m++ )
+	{
+		VNCMesh mesh;
+		if( !mesh.load( dataDir + names[m] ) )
+		{
+			fprintf( stderr, "Could not load %s, pass --data <Binaries folder>\n", names[m] );
+			return 1;
+		}
+		Stopwatch sw;
+		mesh.buildLODs();
+		double ms = sw.elapsedMs();
+		for( int level = 0; level < mesh.getNumLODs(); level++ )
+		{
+			const MeshBatch& b = mesh.getLOD( level );
+			printf( "%-14s %5d %7d %7d %9.4f", level ? "" : names[m], level, b.getNumTriangles(),
+				b.getNumVertices(), mesh.getLODError( level ) );
+			if( level == 0 )
+				printf( " %7.2fms", ms );
+			printf( "\n" );
+		}
+	}
+
+	printf( "\n%8s %8s | %12s %12s %7s | %12s %12s %7s\n", "size", "objects",
+		"main full", "main lod", "saved", "pov full", "pov lod", "saved" );
+	for( size_t s = 0; s < sizes.size(); s++ )
+	{
+		setUniverseSize( sizes[s] );
+		Simulation sim;
+		if( !sim.load( dataDir ) )
+			return meshesMissing();
+		sim.startGame();
+
+		long long mainFull = 0, mainLod = 0, povFull = 0, povLod = 0;
+		for( int f = 0; f < frames; f++ )
+		{
+			if( sim.isPlayerDead() )
+				sim.revivePlayer();
+			applyScriptedInput( sim, f );
+			sim.updateGame();
+
+			Universe& universe = sim.getUniverse();
+			countLODVertices( universe, sim.getPlayer(), mainHeight, mainFull, mainLod );
+
+			Camera pov = povCamera( sim );
+			countLODVertices( universe, pov, povHeight, povFull, povLod );
+		}
+
+		int objects = NUM_BADGUYS + NUM_POWERUPS;
+		printf( "%8d %8d | %12.0f %12.0f %6.1f%% | %12.0f %12.0f %6.1f%%\n", sizes[s], objects,
+			(double)mainFull / frames, (double)mainLod / frames, 100.0 * (mainFull - mainLod) / max( mainFull, 1LL ),
+			(double)povFull / frames, (double)povLod / frames, 100.0 * (povFull - povLod) / max( povFull, 1LL ) );
+	}
+	printf( "vertices are mesh indices submitted per frame, averaged over %d frames of scripted flight\n", frames );
+
+	return 0;
+}
+
+/* Objects and star blocks cam's frustum keeps, added to the totals */
+void countVisible( Universe& universe, Camera& cam, long long& objects, long long& objectsIn,
+	long long& blocksIn, double& us )
+{
+	Stopwatch sw;
+	Frustum frustum;
+	frustum.set( cam );
+	EntityStore& entities = universe.getEntities();
+	for( int i = 0; i < entities.size(); i++ )
+		if( frustum.sphereVisible( entities.position[i], entities.radius[i] ) )
+			objectsIn++;
+	objects += entities.size();
+	vector<StarBlock>& blocks = universe.getStarBlocks();
+	for( size_t b = 0; b < blocks.size(); b++ )
+		if( frustum.boxVisible( blocks[b].lo, blocks[b].hi ) )
+			blocksIn++;
+	us += sw.elapsedUs();
+}
+
+/* What frustum culling saves along the scripted flight, main view and POV */
+int benchCull( int argc, char **argv )
+{
+	vector<int> sizes = argIntList( argc, argv, "--sizes", "100,200,400" );
+	int frames = argInt( argc, argv, "--frames", 2000 );
+	string dataDir = dataDirArg( argc, argv );
+
+	printf( "%8s %8s %7s | %9s %9s %9s | %9s %9s %9s\n", "size", "objects", "blocks",
+		"main obj", "main blk", "cull(us)", "pov obj", "pov blk", "cull(us)" );
+	for( size_t s = 0; s < sizes.size(); s++ )
+	{
+		setUniverseSize( sizes[s] );
+		Simulation sim;
+		if( !sim.load( dataDir ) )
+			return meshesMissing();
+		sim.startGame();
+
+		long long objects[2] = { 0, 0 }, objectsIn[2] = { 0, 0 }, blocksIn[2] = { 0, 0 };
+		double us[2] = { 0, 0 };
+		for( int f = 0; f < frames; f++ )
+		{
+			if( sim.isPlayerDead() )
+				sim.revivePlayer();
+			applyScriptedInput( sim, f );
+			sim.updateGame();
+
+			Universe& universe = sim.getUniverse();
+			countVisible( universe, sim.getPlayer(), objects[0], objectsIn[0], blocksIn[0], us[0] );
+
+			Camera pov = povCamera( sim );
+			countVisible( universe, pov, objects[1], objectsIn[1], blocksIn[1], us[1] );
+		}
+
+		int blocks = (int)sim.getUniverse().getStarBlocks().size();
+		printf( "%8d %8d %7d | %8.1f%% %8.1f%% %9.2f | %8.1f%% %8.1f%% %9.2f\n", sizes[s], NUM_BADGUYS + NUM_POWERUPS, blocks,
+			100.0 * objectsIn[0] / max( objects[0], 1LL ), 100.0 * blocksIn[0] / max( (long long)blocks * frames, 1LL ), us[0] / frames,
+			100.0 * objectsIn[1] / max( objects[1], 1LL ), 100.0 * blocksIn[1] / max( (long long)blocks * frames, 1LL ), us[1] / frames );
+	}
+	printf( "obj/blk are the share of objects and star blocks in view (drawn), averaged over %d frames\n", frames );
+
+	return 0;
+}
+
+/* Serial load against the registry's worker threads, every run from a
+   fresh registry so nothing is shared between runs */
+int benchRegistry( int argc, char **argv )
+{
+	const char *names[] = { "turtle.3vnc", "player.3vnc", "powerUp.3vnc" };
+	const int NUM_MESHES = 3;
+	vector<int> threads = argIntList( argc, argv, "--threads", "1,2,4" );
+	int runs = argInt( argc, argv, "--runs", 20 );
+	string dataDir = dataDirArg( argc, argv );
+
+	/* Warms the .vncb caches so every run times the same thing */
+	for( int m = 0; m < NUM_MESHES; m++ )
+	{
+		VNCMesh mesh;
+		if( !mesh.load( dataDir + names[m] ) )
+		{
+			fprintf( stderr, "Could not load %s, pass --data <Binaries folder>\n", names[m] );
+			return 1;
+		}
+	}
+
+	double serial = 0;
+	for( int r = 0; r < runs; r++ )
+	{
+		Stopwatch sw;
+		for( int m = 0; m < NUM_MESHES; m++ )
+		{
+			MeshAsset asset( dataDir + names[m], MeshSetup() );
+			asset.load();
+		}
+		serial += sw.elapsedMs();
+	}
+	serial /= runs;
+
+	printf( "%8s %12s %12s %9s\n", "threads", "request(us)", "ready(ms)", "speedup" );
+	printf( "%8s %12s %12.2f %8.2fx\n", "serial", "-", serial, 1.0 );
+	for( size_t t = 0; t < threads.size(); t++ )
+	{
+		double request = 0, ready = 0;
+		for( int r = 0; r < runs; r++ )
+		{
+			MeshRegistry registry( threads[t] );
+			Stopwatch sw;
+			for( int m = 0; m < NUM_MESHES; m++ )
+				registry.request( dataDir + names[m] );
+			request += sw.elapsedMs();
+			if( !registry.waitAll() )
+			{
+				fprintf( stderr, "A mesh failed to load through the registry\n" );
+				return 1;
+			}
+			ready += sw.elapsedMs();
+		}
+		request /= runs;
+		ready /= runs;
+		printf( "%8d %12.1f %12.2f %8.2fx\n", threads[t], request * 1000.0, ready, serial / ready );
+	}
+	printf( "ready is from the first request until every mesh is usable, averaged over %d runs\n", runs );
+
+	return 0;
+}
+
+/* Cross, normalize and dot through the same code for the old double Vector3
+   and the float Vec3 */
+template<class V> double vectorWork( vector<V>& a, vector<V>& b )
+{
+	double sum = 0;
+	for( size_t i = 0; i < a.size(); i++ )
+	{
+		V c = a[i].cross( b[i] );
+		c.normalize();
+		sum += c.dot( a[i] );
+	}
+	return sum;
+}
+
+/* Camera::roll(), pitch() and yaw() on a u, v, n basis held in either type */
+template<class V> void turnBasis( V& u, V& v, V& n, float angle )
+{
+	float cs = cos(PI/180 * angle);
+	float sn = sin(PI/180 * angle);
+	V t = u; /* roll */
+	u.set(cs*t.x + sn*v.x, cs*t.y + sn*v.y, cs*t.z + sn*v.z);
+	v.set(-sn*t.x + cs*v.x, -sn*t.y + cs*v.y, -sn*t.z + cs*v.z);
+	V s = n; /* pitch */
+	n.set(cs*s.x - sn*v.x, cs*s.y - sn*v.y, cs*s.z - sn*v.z);
+	v.set(sn*s.x + cs*v.x, sn*s.y + cs*v.y, sn*s.z + cs*v.z);
+	V r = u; /* yaw */
+	u.set(cs*r.x - sn*n.x, cs*r.y - sn*n.y, cs*r.z - sn*n.z);
+	n.set(sn*r.x + cs*n.x, sn*r.y + cs*n.y, sn*r.z + cs*n.z);
+}
+
+/* Object::getModelMatrix() as it was, in doubles */
+void legacyModelMatrix( Object& obj, float out[16] )
+{
+	double m[9];
+	obj.getRotation( m );
+	double s[3] = { obj.scale.x, obj.scale.y, obj.scale.z }, p[3] = { obj.position.x, obj.position.y, obj.position.z };
+	for( int i = 0; i < 3; i++ )
+	{
+		double t = p[i];
+		for( int j = 0; j < 3; j++ )
+		{
+			out[4*j + i] = (float)(m[3*i + j] * s[j]);
+			t -= 0.5 * m[3*i + j] * s[j];
+		}
+		out[12 + i] = (float)t;
+		out[4*i + 3] = 0.0f;
+	}
+	out[15] = 1.0f;
+}
+
+void printMathRow( const char *name, double oldNs, double newNs, double maxErr )
+{
+	printf( "%-26s %10.2f %10.2f %8.2fx %12.2g\n", name, oldNs, newNs, oldNs / newNs, maxErr );
+}
+
+/* The old Vector3/Point3 against VecMath.h, and VecMath.h's SIMD paths
+   against its own plain versions */
+int benchMath( int argc, char **argv )
+{
+	int count = argInt( argc, argv, "--count", 100000 );
+	int passes = argInt( argc, argv, "--passes", 50 );
+	Random rnd;
+	volatile double sink = 0;
+
+#if defined(VECMATH_AVX)
+	const char *path = "AVX";
+#elif defined(VECMATH_SSE)
+	const char *path = "SSE";
+#else
+	const char *path = "none";
+#endif
+	printf( "SIMD: %s, sizeof Vector3 %d, Vec3 %d, Mat4 %d; trivially copyable Vector3 %s, Vec3 %s\n\n",
+		path, (int)sizeof(Vector3), (int)sizeof(Vec3), (int)sizeof(Mat4),
+		is_trivially_copyable<Vector3>::value ? "yes" : "no", is_trivially_copyable<Vec3>::value ? "yes" : "no" );
+	printf( "%-26s %10s %10s %9s %12s\n", "ns per item", "old", "new", "speedup", "max diff" );
+
+	/* Vectors */
+	vector<Vector3> oa, ob;
+	vector<Vec3> na( count ), nb( count );
+	oa.reserve( count ); ob.reserve( count );
+	for( int i = 0; i < count; i++ )
+	{
+		double r[6];
+		for( int k = 0; k < 6; k++ )
+			r[k] = rnd.RandomNum() * 2 - 1;
+		oa.push_back( Vector3( r[0], r[1], r[2] ) ); ob.push_back( Vector3( r[3], r[4], r[5] ) );
+		na[i] = Vec3( (float)r[0], (float)r[1], (float)r[2] ); nb[i] = Vec3( (float)r[3], (float)r[4], (float)r[5] );
+	}
+	double oldSum = 0, newSum = 0;
+	Stopwatch sw;
+	for( int p = 0; p < passes; p++ )
+		oldSum += vectorWork( oa, ob );
+	double oldNs = sw.elapsedUs() * 1000.0 / ((double)passes * count);
+	sw.reset();
+	for( int p = 0; p < passes; p++ )
+		newSum += vectorWork( na, nb );
+	double newNs = sw.elapsedUs() * 1000.0 / ((double)passes * count);
+	printMathRow( "cross+normalize+dot", oldNs, newNs, fabs( oldSum - newSum ) / passes / count );
+
+	/* Copying arrays of them */
+	vector<Vector3> oc;
+	vector<Vec3> nc;
+	sw.reset();
+	for( int p = 0; p < passes; p++ )
+	{
+		oc = oa;
+		sink = sink + oc[p % count].x;
+	}
+	oldNs = sw.elapsedUs() * 1000.0 / ((double)passes * count);
+	sw.reset();
+	for( int p = 0; p < passes; p++ )
+	{
+		nc = na;
+		sink = sink + nc[p % count].x;
+	}
+	newNs = sw.elapsedUs() * 1000.0 / ((double)passes * count);
+	printMathRow( "array copy", oldNs, newNs, 0 );
+
+	/* Turning camera bases */
+	int bases = count / 3;
+	vector<Vector3> obasis;
+	vector<Vec3> nbasis( 3 * bases );
+	obasis.reserve( 3 * bases );
+	for( int i = 0; i < bases; i++ )
+	{
+		obasis.push_back( Vector3( 1, 0, 0 ) ); obasis.push_back( Vector3( 0, 1, 0 ) ); obasis.push_back( Vector3( 0, 0, 1 ) );
+		nbasis[3*i] = Vec3( 1, 0, 0 ); nbasis[3*i + 1] = Vec3( 0, 1, 0 ); nbasis[3*i + 2] = Vec3( 0, 0, 1 );
+	}
+	sw.reset();
+	for( int p = 0; p < passes; p++ )
+		for( int i = 0; i < bases; i++ )
+			turnBasis( obasis[3*i], obasis[3*i + 1], obasis[3*i + 2], 0.5f + 0.001f * i );
+	oldNs = sw.elapsedUs() * 1000.0 / ((double)passes * bases);
+	sw.reset();
+	for( int p = 0; p < passes; p++ )
+		for( int i = 0; i < bases; i++ )
+			turnBasis( nbasis[3*i], nbasis[3*i + 1], nbasis[3*i + 2], 0.5f + 0.001f * i );
+	newNs = sw.elapsedUs() * 1000.0 / ((double)passes * bases);
+	double maxErr = 0;
+	for( int i = 0; i < 3 * bases; i++ )
+		maxErr = max( maxErr, max( fabs( obasis[i].x - nbasis[i].x ), max( fabs( obasis[i].y - nbasis[i].y ), fabs( obasis[i].z - nbasis[i].z ) ) ) );
+	printMathRow( "camera roll+pitch+yaw", oldNs, newNs, maxErr );
+
+	/* Model matrices, as the instanced path builds them */
+	int objects = count / 10 > 0 ? count / 10 : 1;
+	vector<Object> objs( objects );
+	for( int i = 0; i < objects; i++ )
+	{
+		objs[i].position = Vec3( (float)rnd.RandomNum() * 400, (float)rnd.RandomNum() * 400, (float)rnd.RandomNum() * 400 );
+		objs[i].rotation = Vec3( (float)rnd.RandomNum() * 360, (float)rnd.RandomNum() * 360, (float)rnd.RandomNum() * 360 );
+		objs[i].scale = Vec3( 1, 2, 1 );
+	}
+	vector<Mat4> oldM( objects ), newM( objects );
+	sw.reset();
+	for( int p = 0; p < passes; p++ )
+		for( int i = 0; i < objects; i++ )
+			legacyModelMatrix( objs[i], oldM[i].m );
+	oldNs = sw.elapsedUs() * 1000.0 / ((double)passes * objects);
+	sw.reset();
+	for( int p = 0; p < passes; p++ )
+		for( int i = 0; i < objects; i++ )
+			objs[i].getModelMatrix( newM[i] );
+	newNs = sw.elapsedUs() * 1000.0 / ((double)passes * objects);
+	maxErr = 0;
+	for( int i = 0; i < objects; i++ )
+		for( int k = 0; k < 16; k++ )
+			maxErr = max( maxErr, (double)fabs( oldM[i].m[k] - newM[i].m[k] ) );
+	printMathRow( "model matrix", oldNs, newNs, maxErr );
+
+	/* view * model, as InstanceBatch::add() did it and does it now */
+	Mat4 view;
+	Camera cam;
+	cam.getModelViewMatrix( view.m );
+	vector<Mat4> prod( objects ), prodS( objects );
+	sw.reset();
+	for( int p = 0; p < passes; p++ )
+		for( int i = 0; i < objects; i++ )
+			Mat4::mulScalar( view, newM[i], prodS[i] );
+	oldNs = sw.elapsedUs() * 1000.0 / ((double)passes * objects);
+	sw.reset();
+	for( int p = 0; p < passes; p++ )
+		for( int i = 0; i < objects; i++ )
+			Mat4::mul( view, newM[i], prod[i] );
+	newNs = sw.elapsedUs() * 1000.0 / ((double)passes * objects);
+	maxErr = 0;
+	for( int i = 0; i < objects; i++ )
+		for( int k = 0; k < 16; k++ )
+			maxErr = max( maxErr, (double)fabs( prod[i].m[k] - prodS[i].m[k] ) );
+	printMathRow( "Mat4 multiply", oldNs, newNs, maxErr );
+
+	/* Quaternion products, plain against SIMD */
+	vector<Quat> qs( objects ), qa( objects ), qb( objects );
+	for( int i = 0; i < objects; i++ )
+		qs[i] = Quat::fromAxisAngle( objs[i].position + Vec3( 1, 1, 1 ), objs[i].rotation.x );
+	Quat turn = Quat::fromAxisAngle( Vec3( 1, 2, 3 ), 0.5f );
+	sw.reset();
+	for( int p = 0; p < passes; p++ )
+		for( int i = 0; i < objects; i++ )
+			qa[i] = Quat::mulScalar( turn, qs[i] );
+	oldNs = sw.elapsedUs() * 1000.0 / ((double)passes * objects);
+	sw.reset();
+	for( int p = 0; p < passes; p++ )
+		for( int i = 0; i < objects; i++ )
+			qb[i] = turn * qs[i];
+	newNs = sw.elapsedUs() * 1000.0 / ((double)passes * objects);
+	maxErr = 0;
+	for( int i = 0; i < objects; i++ )
+		maxErr = max( maxErr, (double)max( max( fabsf( qa[i].x - qb[i].x ), fabsf( qa[i].y - qb[i].y ) ),
+			max( fabsf( qa[i].z - qb[i].z ), fabsf( qa[i].w - qb[i].w ) ) ) );
+	printMathRow( "Quat multiply", oldNs, newNs, maxErr );
+
+	printf( "\nold is Vector3 (doubles) except for the Mat4 and Quat rows, where it is the\n"
+		"plain C++ version of the same float math. max diff is between old and new results.\n" );
+	sink = sink + oldSum + newSum;
+	return 0;
+}
+
+/* A bad guy as it used to be kept: a whole Object (Camera basis, mesh
+   handle, bounding radius cache) plus the axis it spins about */
+struct LegacyEntity
+{
+	Object obj;
+	int rotationAxis;
+
+	LegacyEntity( const MeshHandle& h ) : obj( h ), rotationAxis( 0 ) {}
+
+	/* The old Object::doRotation() */
+	void doRotation()
+	{
+		switch( rotationAxis )
+		{
+		case 0:
+			obj.rotation.x += 2.0f;
+			break;
+		case 1:
+			obj.rotation.y += 1.0f;
+			break;
+		case 2:
+			obj.rotation.z += 1.5f;
+			break;
+		case 3:
+			obj.rotation.x += 0.67f;
+			obj.rotation.y += 1.3f;
+			break;
+		case 4:
+			obj.rotation.x += 0.75f;
+			obj.rotation.z += 1.1f;
+			break;
+		case 5:
+			obj.rotation.y += 3.0f;
+			break;
+		default: obj.rotation.x += 1.0f;
+		}
+	}
+};
+
+void printEntityRow( int n, const char *name, double oldNs, double newNs, const char *note )
+{
+	printf( "%8d %-22s %10.2f %10.2f %8.2fx%s\n", n, name, oldNs, newNs, oldNs / newNs, note );
+}
+
+/* The per-tick and per-frame passes over every entity, an Object each
+   against EntityStore's columns */
+int benchEntities( int argc, char **argv )
+{
+	vector<int> counts = argIntList( argc, argv, "--counts", "1000,10000,100000" );
+	int passes = argInt( argc, argv, "--passes", 50 );
+	string dataDir = dataDirArg( argc, argv );
+
+	MeshHandle turtle = loadTurtle( dataDir );
+	if( !turtle.isReady() )
+		return meshesMissing();
+
+	printf( "bytes per entity: Object %d, EntityStore %d\n\n", (int)sizeof(LegacyEntity), EntityStore::bytesPerEntity() );
+	printf( "%8s %-22s %10s %10s %9s\n", "count", "ns per entity", "objects", "store", "speedup" );
+
+	Random rnd;
+	volatile double sink = 0;
+	for( size_t c = 0; c < counts.size(); c++ )
+	{
+		int n = counts[c];
+		vector<Vec3> positions;
+		float side = scatterEntities( n, rnd, positions );
+
+		vector<LegacyEntity> objs( n, LegacyEntity( turtle ) );
+		EntityStore store;
+		int meshId = store.addMesh( turtle );
+		store.reserve( n );
+		for( int i = 0; i < n; i++ )
+		{
+			const Vec3& pos = positions[i];
+			Vec3 rot( (float)rnd.RandomNum() * 360, (float)rnd.RandomNum() * 360, (float)rnd.RandomNum() * 360 );
+			int axis = rnd.RandomInt( 0, NUM_SPINS - 1 );
+			objs[i].obj.position = pos;
+			objs[i].obj.rotation = rot;
+			objs[i].obj.scale = Vec3( 1, 2, 1 );
+			objs[i].rotationAxis = axis;
+			store.add( OBJECT_BADGUY, meshId, pos, rot, Vec3( 1, 2, 1 ), EntityStore::spinFor( axis ) );
+		}
+
+		/* Spinning, every tick */
+		Stopwatch sw;
+		for( int p = 0; p < passes; p++ )
+			for( int i = 0; i < n; i++ )
+				objs[i].doRotation();
+		double oldNs = sw.elapsedUs() * 1000.0 / ((double)passes * n);
+		sw.reset();
+		for( int p = 0; p < passes; p++ )
+			store.updateRotations();
+		double newNs = sw.elapsedUs() * 1000.0 / ((double)passes * n);
+		/* The store keeps its angles within [0, 360), Objects let them grow */
+		bool same = true;
+		for( int i = 0; i < n; i++ )
+		{
+			Vec3 o = objs[i].obj.rotation, r = store.rotation[i];
+			Vec3 d( wrapDegrees( o.x - r.x + 180.0f ), wrapDegrees( o.y - r.y + 180.0f ), wrapDegrees( o.z - r.z + 180.0f ) );
+			same = same && fabsf( d.x - 180.0f ) < 0.01f && fabsf( d.y - 180.0f ) < 0.01f && fabsf( d.z - 180.0f ) < 0.01f;
+			objs[i].obj.rotation = r; /* the same input for the passes below */
+		}
+		printEntityRow( n, "rotate", oldNs, newNs, same ? "" : "  MISMATCH" );
+
+		/* Culling against a sphere per entity, every frame */
+		Camera cam;
+		cam.moveTo( Vec3( (float)side / 2, (float)side / 2, (float)side / 2 ) );
+		Frustum frustum;
+		frustum.set( cam );
+		long oldIn = 0, newIn = 0;
+		sw.reset();
+		for( int p = 0; p < passes; p++ )
+			for( int i = 0; i < n; i++ )
+				if( frustum.sphereVisible( objs[i].obj.position, objs[i].obj.getBoundingRadius() ) )
+					oldIn++;
+		oldNs = sw.elapsedUs() * 1000.0 / ((double)passes * n);
+		sw.reset();
+		for( int p = 0; p < passes; p++ )
+			for( int i = 0; i < n; i++ )
+				if( frustum.sphereVisible( store.position[i], store.radius[i] ) )
+					newIn++;
+		newNs = sw.elapsedUs() * 1000.0 / ((double)passes * n);
+		printEntityRow( n, "cull", oldNs, newNs, oldIn == newIn ? "" : "  MISMATCH" );
+
+		/* Collision spheres near a point, what a hash rebuild or a broad
+		   phase sweep reads */
+		Vec3 probe( (float)side / 2, (float)side / 2, (float)side / 2 );
+		float reach = (float)side / 4;
+		long oldNear = 0, newNear = 0;
+		sw.reset();
+		for( int p = 0; p < passes; p++ )
+			for( int i = 0; i < n; i++ )
+			{
+				float r = reach + objs[i].obj.getRadius();
+				if( distanceSq( objs[i].obj.getCenter(), probe ) <= r * r )
+					oldNear++;
+			}
+		oldNs = sw.elapsedUs() * 1000.0 / ((double)passes * n);
+		sw.reset();
+		for( int p = 0; p < passes; p++ )
+			for( int i = 0; i < n; i++ )
+			{
+				float r = reach + store.getCollisionRadius( i );
+				if( distanceSq( store.getCenter( i ), probe ) <= r * r )
+					newNear++;
+			}
+		newNs = sw.elapsedUs() * 1000.0 / ((double)passes * n);
+		printEntityRow( n, "collision spheres", oldNs, newNs, oldNear == newNear ? "" : "  MISMATCH" );
+
+		/* Model matrices, as the instanced path builds them every frame */
+		vector<Mat4> oldM( n ), newM( n );
+		sw.reset();
+		for( int p = 0; p < passes; p++ )
+			for( int i = 0; i < n; i++ )
+				objs[i].obj.getModelMatrix( oldM[i] );
+		oldNs = sw.elapsedUs() * 1000.0 / ((double)passes * n);
+		sw.reset();
+		for( int p = 0; p < passes; p++ )
+			for( int i = 0; i < n; i++ )
+				store.getModelMatrix( i, newM[i] );
+		newNs = sw.elapsedUs() * 1000.0 / ((double)passes * n);
+		same = true;
+		for( int i = 0; i < n; i++ )
+			for( int k = 0; k < 16; k++ )
+				same = same && oldM[i].m[k] == newM[i].m[k];
+		printEntityRow( n, "model matrices", oldNs, newNs, same ? "" : "  MISMATCH" );
+
+		sink = sink + oldM[n / 2].m[12] + newM[n / 2].m[12];
+	}
+	printf( "\nobjects is a vector of Object (plus spin axis) per entity, store is EntityStore.\n"
+		"Each pass touches every entity %d times.\n", passes );
+	return 0;
+}
+
+/* Spawning and despawning thousands of entities a tick through handles
+   (swap-and-pop), against erasing from a vector<Object> whose later
+   elements all shift down a place, and what happens to references held
+   across the churn under each */
+/* Probes around the given points and at random, each answered by the
+   Universe's queryCollisions() and overlapping() and again by testing every
+   entity in turn. Returns how many probes got a different answer. */
+int wrongCollisionQueries( Universe& universe, const MeshHandle& mesh, const vector<Vec3>& near, float side, Random& rnd, int probes )
+{
+	const float NEAR_PROBE = 4.0f; /* how far from a point its probes land, along each axis */
+	EntityStore& entities = universe.getEntities();
+	Object probe( mesh );
+	vector<int> hits, expect;
+	vector<unsigned> mask;
+	int wrong = 0;
+	for( int p = 0; p < probes; p++ )
+	{
+		if( (p & 1) || near.empty() )
+			probe.position = randomPoint( rnd, side );
+		else
+			probe.position = near[(p / 2) % near.size()] + randomPoint( rnd, 2 * NEAR_PROBE ) - Vec3( NEAR_PROBE, NEAR_PROBE, NEAR_PROBE );
+		Vec3 c = probe.getCenter();
+		float r = probe.getRadius();
+
+		hits.clear();
+		universe.queryCollisions( probe, hits );
+		sort( hits.begin(), hits.end() );
+		universe.overlapping( probe, mask );
+
+		expect.clear();
+		bool same = true;
+		for( int i = 0; i < entities.size(); i++ )
+		{
+			float reach = r + entities.radius[i];
+			if( distanceSq( entities.position[i], c ) < reach * reach && entities.touchesSphere( i, c, r ) )
+				expect.push_back( i );
+			reach = r + entities.getCollisionRadius( i );
+			if( maskBit( mask, i ) != (distanceSq( entities.getCenter( i ), c ) < reach * reach) )
+				same = false;
+		}
+		if( !same || hits != expect )
+			wrong++;
+	}
+	return wrong;
+}
+
+int benchChurn( int argc, char **argv )
+{
+	vector<int> counts = argIntList( argc, argv, "--entities", "10000,100000" );
+	vector<int> churns = argIntList( argc, argv, "--churn", "100,1000,5000" );
+	int ticks = argInt( argc, argv, "--ticks", 200 );
+	int held = argInt( argc, argv, "--held", 1000 );
+	string dataDir = dataDirArg( argc, argv );
+	const int ERASES = 100;      /* erases timed for the old way, it is far too slow to run a tick of */
+	const int PROBES = 500;      /* collision queries checked after moving entities */
+
+	MeshHandle turtle = loadTurtle( dataDir, MeshSetup( Vec3( -.5f,.25f,-.5f ) ) );
+	if( !turtle.isReady() )
+		return meshesMissing();
+
+	printf( "%8s %7s | %10s %10s %12s %7s %6s %6s | %12s %6s\n", "entities", "churn",
+		"tick p50", "tick p99", "ns per pair", "stale", "wrong", "moved", "erase ns", "wrong" );
+
+	Random rnd;
+	for( size_t c = 0; c < counts.size(); c++ )
+		for( size_t k = 0; k < churns.size(); k++ )
+		{
+			int n = counts[c], churn = churns[k];
+			vector<Vec3> positions;
+			float side = scatterEntities( n, rnd, positions );
+
+			Universe universe;
+			universe.loadMeshes( dataDir );
+			if( !universe.finishLoading() )
+				return meshesMissing();
+
+			/* Every live entity's handle, so despawns can pick one at random */
+			vector<EntityHandle> live;
+			for( int i = 0; i < n; i++ )
+				live.push_back( universe.spawn( OBJECT_BADGUY, positions[i], Vec3(), Vec3( 1,2,1 ), EntityStore::spinFor( rnd.RandomInt( 0, NUM_SPINS - 1 ) ) ) );
+
+			/* References held across the churn, like the POV window's */
+			EntityStore& entities = universe.getEntities();
+			int numHeld = min( held, n );
+			vector<EntityHandle> heldHandles( numHeld );
+			vector<Vec3> heldWhere( numHeld );
+			for( int h = 0; h < numHeld; h++ )
+			{
+				heldHandles[h] = live[h];
+				heldWhere[h] = entities.position[entities.indexOf( live[h] )];
+			}
+
+			vector<double> samples( ticks );
+			for( int t = 0; t < ticks; t++ )
+			{
+				Stopwatch sw;
+				for( int j = 0; j < churn; j++ )
+				{
+					int r = rnd.RandomInt( (int)live.size() );
+					universe.despawn( live[r] );
+					live[r] = live.back();
+					live.pop_back();
+				}
+				for( int j = 0; j < churn; j++ )
+					live.push_back( universe.spawn( OBJECT_BADGUY, randomPoint( rnd, side ), Vec3(), Vec3( 1,2,1 ), EntityStore::spinFor( rnd.RandomInt( 0, NUM_SPINS - 1 ) ) ) );
+				samples[t] = sw.elapsedUs();
+			}
+			LatencyStats stats( samples );
+
+			/* A held handle either finds its own entity or knows it is gone */
+			int stale = 0, wrong = 0;
+			for( int h = 0; h < numHeld; h++ )
+			{
+				int i = entities.indexOf( heldHandles[h] );
+				if( i < 0 )
+					stale++;
+				else if( !(entities.position[i] == heldWhere[h]) )
+					wrong++;
+			}
+
+			/* Move half as many survivors as churn and grow as many others,
+			   then the broad phase and the collision spheres must still
+			   agree with testing every entity, around them and at random */
+			vector<Vec3> changed( min( churn, (int)live.size() ) );
+			for( size_t j = 0; j < changed.size(); j++ )
+			{
+				EntityHandle h = live[rnd.RandomInt( (int)live.size() )];
+				if( j & 1 )
+					universe.resize( h, Vec3( 1,2,1 ) * (1 + 2 * rnd.RandomFloat()) );
+				else
+					universe.move( h, randomPoint( rnd, side ) );
+				changed[j] = entities.position[entities.indexOf( h )];
+			}
+			int movedWrong = wrongCollisionQueries( universe, turtle, changed, side, rnd, PROBES );
+
+			/* The old way: erase shifts every later Object and every later id in the hash */
+			scatterEntities( n, rnd, positions );
+			vector<Object> objects( n, Object( turtle ) );
+			SpatialHash hash;
+			hash.clear( n );
+			for( int i = 0; i < n; i++ )
+			{
+				objects[i].position = positions[i];
+				objects[i].scale = Vec3( 1,2,1 );
+				hash.insert( i, objects[i].position, objects[i].getBoundingRadius() );
+			}
+			vector<Vec3> oldWhere( numHeld );
+			for( int h = 0; h < numHeld; h++ )
+				oldWhere[h] = objects[h].position;
+
+			Stopwatch sw;
+			for( int j = 0; j < ERASES; j++ )
+			{
+				int idx = rnd.RandomInt( (int)objects.size() );
+				hash.remove( idx );
+				for( int i = idx + 1; i < (int)objects.size(); i++ )
+					hash.relabel( i, i - 1 );
+				objects.erase( objects.begin() + idx );
+
+				Object o( turtle );
+				o.position = randomPoint( rnd, side );
+				o.scale = Vec3( 1,2,1 );
+				objects.push_back( o );
+				hash.insert( (int)objects.size() - 1, o.position, o.getBoundingRadius() );
+			}
+			double eraseNs = sw.elapsedUs() * 1000.0 / ERASES;
+
+			/* A held index silently lands on some other entity */
+			int oldWrong = 0;
+			for( int h = 0; h < numHeld; h++ )
+				if( !(objects[h].position == oldWhere[h]) )
+					oldWrong++;
+
+			printf( "%8d %7d | %8.1fus %8.1fus %12.1f %7d %6d %6d | %12.1f %6d%s%s\n", n, churn,
+				stats.p50, stats.p99, stats.mean * 1000.0 / churn, stale, wrong, movedWrong, eraseNs, oldWrong,
+				wrong ? "  WRONG HANDLES" : "", movedWrong ? "  WRONG AFTER MOVING" : "" );
+		}
+	printf( "churn entities are despawned and as many spawned each of %d ticks; a pair is one of each.\n"
+		"stale/wrong count %d held handles that report their entity gone or that find another one;\n"
+		"moved counts, of %d collision queries after moving and rescaling churn entities through\n"
+		"Universe::move()/resize(), those that disagree with testing every entity;\n"
+		"the old way is timed over %d erase+push pairs and its held indices are plain ints.\n", ticks, held, PROBES, ERASES );
+	return 0;
+}
+
+/* Every entity's turn for a tick the ways it has been done, in entities
+   per microsecond: the old switch per Object, a switch over a packed axis
+   column, and the spin column added on a float at a time and with SIMD */
+int benchSpin( int argc, char **argv )
+{
+	vector<int> counts = argIntList( argc, argv, "--counts", "1000,10000,100000" );
+	int passes = argInt( argc, argv, "--passes", 200 );
+	string dataDir = dataDirArg( argc, argv );
+
+	MeshHandle turtle = loadTurtle( dataDir );
+	if( !turtle.isReady() )
+		return meshesMissing();
+
+#if defined(VECMATH_AVX)
+	const char *path = "AVX";
+#elif defined(VECMATH_SSE)
+	const char *path = "SSE";
+#else
+	const char *path = "none";
+#endif
+	printf( "SIMD: %s\n\n%8s %14s %14s %14s %14s %10s\n", path, "count", "Object switch",
+		"axis switch", "rates scalar", "rates SIMD", "max diff" );
+
+	Random rnd;
+	for( size_t c = 0; c < counts.size(); c++ )
+	{
+		int n = counts[c];
+		vector<LegacyEntity> objs( n, LegacyEntity( turtle ) );
+		vector<unsigned char> axis( n );
+		vector<Vec3> rotA( n ), rates( n );
+		for( int i = 0; i < n; i++ )
+		{
+			Vec3 rot( (float)rnd.RandomNum() * 360, (float)rnd.RandomNum() * 360, (float)rnd.RandomNum() * 360 );
+			axis[i] = (unsigned char)rnd.RandomInt( 0, NUM_SPINS - 1 );
+			objs[i].obj.rotation = rotA[i] = rot;
+			objs[i].rotationAxis = axis[i];
+			rates[i] = EntityStore::spinFor( axis[i] );
+		}
+		vector<Vec3> rotB( rotA ), rotC( rotA );
+
+		Stopwatch sw;
+		for( int p = 0; p < passes; p++ )
+			for( int i = 0; i < n; i++ )
+				objs[i].doRotation();
+		double objectUs = sw.elapsedUs() / passes;
+
+		/* The same switch, walking only the two columns it needs */
+		sw.reset();
+		for( int p = 0; p < passes; p++ )
+			for( int i = 0; i < n; i++ )
+			{
+				Vec3& r = rotA[i];
+				switch( axis[i] )
+				{
+				case 0: r.x += 2.0f; break;
+				case 1: r.y += 1.0f; break;
+				case 2: r.z += 1.5f; break;
+				case 3: r.x += 0.67f; r.y += 1.3f; break;
+				case 4: r.x += 0.75f; r.z += 1.1f; break;
+				default: r.y += 3.0f;
+				}
+			}
+		double axisUs = sw.elapsedUs() / passes;
+
+		sw.reset();
+		for( int p = 0; p < passes; p++ )
+			addWrapDegreesScalar( &rotB[0].x, &rates[0].x, 3 * n );
+		double scalarUs = sw.elapsedUs() / passes;
+
+		sw.reset();
+		for( int p = 0; p < passes; p++ )
+			addWrapDegrees( &rotC[0].x, &rates[0].x, 3 * n );
+		double simdUs = sw.elapsedUs() / passes;
+
+		/* The wrapped angles against the unwrapped ones, and SIMD against scalar */
+		double maxDiff = 0;
+		for( int i = 0; i < n; i++ )
+			for( int k = 0; k < 3; k++ )
+			{
+				float d = wrapDegrees( (&objs[i].obj.rotation.x)[k] - (&rotC[i].x)[k] + 180.0f ) - 180.0f;
+				maxDiff = max( maxDiff, (double)fabsf( d ) );
+				maxDiff = max( maxDiff, (double)fabsf( (&rotB[i].x)[k] - (&rotC[i].x)[k] ) );
+			}
+
+		printf( "%8d %14.1f %14.1f %14.1f %14.1f %10.2g\n", n, n / objectUs, n / axisUs,
+			n / scalarUs, n / simdUs, maxDiff );
+	}
+	printf( "entities turned per microsecond, over %d ticks; rates are kept within [0, 360), the switches are not.\n"
+		"max diff is in degrees, between the Object switch and the SIMD rates and between scalar and SIMD rates.\n", passes );
+	return 0;
+}
+
+/* The player's sphere and then a volley of projectile spheres against
+   every entity's collision sphere: Object::checkCollision() one pair at a
+   time, the SphereSet kernels plain and SIMD, and SpatialHash queries.
+   Every answer is checked against the plain kernel. */
+int benchOverlap( int argc, char **argv )
+{
+	vector<int> counts = argIntList( argc, argv, "--counts", "1000,10000,100000" );
+	int numProbes = argInt( argc, argv, "--probes", 64 );
+	int queries = argInt( argc, argv, "--queries", 2000 );
+	string dataDir = dataDirArg( argc, argv );
+	const float PROBE_RADIUS = 0.25f;
+
+	MeshHandle turtle = loadTurtle( dataDir );
+	if( !turtle.isReady() )
+		return meshesMissing();
+
+#if defined(VECMATH_AVX)
+	const char *path = "AVX";
+#elif defined(VECMATH_SSE)
+	const char *path = "SSE";
+#else
+	const char *path = "none";
+#endif
+	printf( "SIMD: %s\n\n%8s | %9s %9s %9s %9s %7s | %9s %9s %9s %7s\n", path, "count",
+		"scan", "scalar", "SIMD", "hash", "hits", "scalar", "SIMD", "hash", "hits" );
+
+	Random rnd;
+	for( size_t c = 0; c < counts.size(); c++ )
+	{
+		int n = counts[c];
+		vector<Vec3> positions;
+		float side = scatterEntities( n, rnd, positions );
+
+		EntityStore store;
+		int meshId = store.addMesh( turtle );
+		store.reserve( n );
+		vector<Object> objects( n, Object( turtle ) );
+		SpatialHash hash;
+		hash.clear( n );
+		for( int i = 0; i < n; i++ )
+		{
+			store.add( OBJECT_BADGUY, meshId, positions[i], Vec3(), Vec3( 1,2,1 ) );
+			objects[i].position = positions[i];
+			objects[i].scale = Vec3( 1,2,1 );
+			hash.insert( i, store.getCenter( i ), store.getCollisionRadius( i ) );
+		}
+
+		/* Half the player positions land right on an entity so there is something to find */
+		Object player( turtle );
+		vector<Vec3> where( queries );
+		for( int q = 0; q < queries; q++ )
+			where[q] = (q & 1) ? randomPoint( rnd, side )
+				: store.position[rnd.RandomInt( n )];
+
+		int scans = max( 1, queries / 20 );
+		long scanHits = 0;
+		Stopwatch sw;
+		for( int q = 0; q < scans; q++ )
+		{
+			player.position = where[q];
+			for( int i = 0; i < n; i++ )
+				if( objects[i].checkCollision( player ) )
+					scanHits++;
+		}
+		double scanNs = sw.elapsedUs() * 1000.0 / scans;
+
+		vector< vector<unsigned> > scalarMasks( queries ), simdMasks( queries );
+		vector<int> scalarHits( queries );
+		long totalHits = 0, scanCheck = 0;
+		sw.reset();
+		for( int q = 0; q < queries; q++ )
+		{
+			player.position = where[q];
+			scalarHits[q] = overlapMaskScalar( store.spheres, player.getCenter(), player.getRadius(), scalarMasks[q] );
+		}
+		double scalarNs = sw.elapsedUs() * 1000.0 / queries;
+		sw.reset();
+		for( int q = 0; q < queries; q++ )
+		{
+			player.position = where[q];
+			totalHits += overlapMask( store.spheres, player.getCenter(), player.getRadius(), simdMasks[q] );
+		}
+		double simdNs = sw.elapsedUs() * 1000.0 / queries;
+
+		vector<int> found;
+		vector< vector<int> > hashFound( queries );
+		sw.reset();
+		for( int q = 0; q < queries; q++ )
+		{
+			player.position = where[q];
+			hash.query( player.getCenter(), player.getRadius(), hashFound[q] );
+		}
+		double hashNs = sw.elapsedUs() * 1000.0 / queries;
+
+		bool same = true;
+		for( int q = 0; q < queries; q++ )
+		{
+			same = same && simdMasks[q] == scalarMasks[q] && (int)hashFound[q].size() == scalarHits[q];
+			for( size_t h = 0; h < hashFound[q].size(); h++ )
+				same = same && maskBit( scalarMasks[q], hashFound[q][h] );
+			if( q < scans )
+				scanCheck += scalarHits[q];
+		}
+		same = same && scanCheck == scanHits;
+
+		/* Volleys of projectiles, each all over the place */
+		int volleys = max( 1, queries / 20 );
+		vector<SphereSet> probes( volleys );
+		for( int v = 0; v < volleys; v++ )
+			for( int p = 0; p < numProbes; p++ )
+			{
+				Vec3 at = (p & 1) ? randomPoint( rnd, side )
+					: store.getCenter( rnd.RandomInt( n ) );
+				probes[v].add( at, PROBE_RADIUS );
+			}
+
+		vector< vector<unsigned> > anyScalar( volleys ), anySimd( volleys ), anyHash( volleys );
+		long volleyHits = 0;
+		sw.reset();
+		for( int v = 0; v < volleys; v++ )
+			overlapAnyMaskScalar( store.spheres, probes[v], anyScalar[v] );
+		double anyScalarUs = sw.elapsedUs() / volleys;
+		sw.reset();
+		for( int v = 0; v < volleys; v++ )
+			volleyHits += overlapAnyMask( store.spheres, probes[v], anySimd[v] );
+		double anySimdUs = sw.elapsedUs() / volleys;
+		sw.reset();
+		for( int v = 0; v < volleys; v++ )
+		{
+			anyHash[v].assign( maskWords( n ), 0 );
+			for( int p = 0; p < numProbes; p++ )
+			{
+				found.clear();
+				hash.query( probes[v].getCenter( p ), PROBE_RADIUS, found );
+				for( size_t h = 0; h < found.size(); h++ )
+					anyHash[v][found[h] >> 5] |= 1u << (found[h] & 31);
+			}
+		}
+		double anyHashUs = sw.elapsedUs() / volleys;
+		for( int v = 0; v < volleys; v++ )
+			same = same && anySimd[v] == anyScalar[v] && anyHash[v] == anyScalar[v];
+
+		printf( "%8d | %9.1f %9.1f %9.1f %9.1f %7.2f | %9.1f %9.1f %9.1f %7.2f%s\n", n,
+			scanNs, scalarNs, simdNs, hashNs, (double)totalHits / queries,
+			anyScalarUs, anySimdUs, anyHashUs, (double)volleyHits / volleys, same ? "" : "  MISMATCH" );
+	}
+	printf( "left: ns per player query against every entity (scan is checkCollision() per Object)\n"
+		"right: us per volley of %d projectiles against every entity; hits are entities touched\n", numProbes );
+	return 0;
+}
+
+/* The part of Renderer::drawInstanced() that runs on the pool, without the
+   culling: every entity's modelview */
+void buildTransforms( EntityStore& entities, const Mat4& view, vector<Mat4>& out, JobSystem& jobs )
+{
+	out.resize( entities.size() );
+	jobs.parallelFor( 0, entities.size(), TRANSFORM_GRAIN, [&]( int lo, int hi )
+	{
+		Mat4 model;
+		for( int i = lo; i < hi; i++ )
+		{
+			entities.getModelMatrix( i, model );
+			Mat4::mul( view, model, out[i] );
+		}
+	} );
+}
+
+/* Median microseconds of runs calls to f */
+template<class F> double medianUs( int runs, const F& f )
+{
+	vector<double> samples;
+	for( int r = 0; r < runs; r++ )
+	{
+		Stopwatch sw;
+		f();
+		samples.push_back( sw.elapsedUs() );
+	}
+	return LatencyStats( samples ).p50;
+}
+
+int benchJobs( int argc, char **argv )
+{
+	int size = argInt( argc, argv, "--size", 400000 );
+	int stars = argInt( argc, argv, "--stars", 1000 );
+	int runs = argInt( argc, argv, "--runs", 50 );
+	int numProbes = argInt( argc, argv, "--probes", 64 );
+	string dataDir = dataDirArg( argc, argv );
+
+	int cores = (int)thread::hardware_concurrency();
+	vector<int> threads = argIntList( argc, argv, "--threads", "" );
+	if( threads.empty() )
+		for( int t = 1; t <= max( cores, 1 ); t *= 2 )
+			threads.push_back( t );
+
+	setUniverseSize( size );
+	setNumStars( stars );
+	Simulation sim;
+	if( !sim.load( dataDir ) )
+		return meshesMissing();
+	sim.startGame();
+	Universe& universe = sim.getUniverse();
+	EntityStore& entities = universe.getEntities();
+	Player& player = sim.getPlayer();
+	int n = entities.size();
+	Mat4 view;
+	povCamera( sim ).getModelViewMatrix( view.m );
+	JobSystem serial( 1 );
+	Random rnd;
+
+	printf( "%d entities, %d hardware threads%s\n\n", n, cores,
+		cores <= 1 ? " (more threads than that only take turns, expect no speedup)" : "" );
+	printf( "%8s | %9s %9s %9s %9s %9s %9s | %7s %7s\n", "threads", "rotate", "rebuild", "player",
+		"volley", "xforms", "tick", "speedup", "check" );
+
+	double baseTotal = 0;
+	for( size_t k = 0; k < threads.size(); k++ )
+	{
+		JobSystem jobs( threads[k] );
+		sim.setJobs( jobs );
+		n = entities.size();
+
+		/* A volley of projectiles (half of them on an entity) and the player
+		   on someone, so the queries find something */
+		SphereSet probes;
+		for( int p = 0; p < numProbes; p++ )
+			probes.add( (p & 1) ? entities.getCenter( rnd.RandomInt( n ) )
+				: Vec3( (float)rnd.RandomInt( -size / 2, size / 2 ), (float)rnd.RandomInt( -size / 2, size / 2 ), (float)rnd.RandomInt( -size / 2, size / 2 ) ), 0.25f );
+		player.position = entities.position[rnd.RandomInt( n )];
+
+		/* The serial answers this pool has to match */
+		vector<unsigned> serialMask, serialAnyMask, mask;
+		overlapMask( entities.spheres, player.getCenter(), player.getRadius(), serialMask );
+		overlapAnyMask( entities.spheres, probes, serialAnyMask );
+		vector<int> serialNearby, nearby;
+		universe.queryCollisions( player, serialNearby );
+		sort( serialNearby.begin(), serialNearby.end() );
+
+		vector<Vec3> before( entities.rotation ), spun( entities.rotation );
+		universe.updateRotations( jobs );
+		addWrapDegrees( &spun[0].x, &entities.spin[0].x, 3 * n );
+		bool same = entities.rotation == spun;
+		entities.rotation = before;
+
+		double rotateUs = medianUs( runs, [&](){ universe.updateRotations( jobs ); } );
+		double rebuildUs = medianUs( runs, [&](){ universe.rebuildBroadPhase( jobs ); } );
+		nearby.clear();
+		universe.queryCollisions( player, nearby );
+		sort( nearby.begin(), nearby.end() );
+		same = same && nearby == serialNearby;
+
+		double playerUs = medianUs( runs, [&](){ universe.overlapping( player, mask, jobs ); } );
+		same = same && mask == serialMask;
+		double volleyUs = medianUs( runs, [&](){ universe.overlappingAny( probes, mask, jobs ); } );
+		same = same && mask == serialAnyMask;
+		vector<Mat4> serialTransforms, transforms;
+		buildTransforms( entities, view, serialTransforms, serial );
+		double xformUs = medianUs( runs, [&](){ buildTransforms( entities, view, transforms, jobs ); } );
+		same = same && transforms.size() == serialTransforms.size()
+			&& memcmp( &transforms[0], &serialTransforms[0], n * sizeof(Mat4) ) == 0;
+
+		/* The player sits on someone, the first tick takes them out */
+		double tickUs = medianUs( runs, [&](){ sim.updateGame(); } );
+
+		double total = rotateUs + rebuildUs + playerUs + volleyUs + xformUs + tickUs;
+		if( k == 0 )
+			baseTotal = total;
+		printf( "%8d | %9.1f %9.1f %9.1f %9.1f %9.1f %9.1f | %6.2fx %7s\n", threads[k], rotateUs, rebuildUs,
+			playerUs, volleyUs, xformUs, tickUs, baseTotal / total, same ? "ok" : "MISMATCH" );
+	}
+	sim.setJobs( JobSystem::shared() );
+	printf( "median us per run of each phase (tick is a whole Simulation::updateGame()),\n"
+		"speedup is of their sum against the first row; check compares to the serial answers\n" );
+	return 0;
+}
+
+/* Scripted pilot for real time rather than ticks: thrust pulses at set
+   times and mouse turning in proportion to how long the frame was, as
+   Shazam.cpp's input handlers would see it */
+void applyTimedInput( Simulation& sim, double t, double dt, int& pulses )
+{
+	const double PULSE = 40.0 / TICKS_PER_SECOND;
+	for( ; (pulses + 1) * PULSE <= t; pulses++ )
+		sim.movePlayerForward( pulses % 4 == 2 ? -0.1f : 0.1f );
+	sim.playerYaw( (float)(30.0 * sin( t * 0.6 ) * dt) );
+	sim.playerPitch( (float)(18.0 * cos( t * 0.78 ) * dt) );
+}
+
+/* Mean change in speed from one drawn frame to the next against the mean
+   speed: 0 when a steady flight looks steady */
+double judder( const vector<Vec3>& at, const vector<double>& dt )
+{
+	double change = 0, speed = 0;
+	for( size_t i = 2; i < at.size(); i++ )
+	{
+		double a = (at[i - 1] - at[i - 2]).length() / dt[i - 1], b = (at[i] - at[i - 1]).length() / dt[i];
+		change += fabs( b - a );
+		speed += b;
+	}
+	return speed > 0 ? change / speed : 0;
+}
+
+int benchTimestep( int argc, char **argv )
+{
+	vector<int> rates = argIntList( argc, argv, "--rates", "30,60,144,500" );
+	double seconds = argInt( argc, argv, "--seconds", 20 );
+	int jitter = argInt( argc, argv, "--jitter", 20 );
+	int stallMs = argInt( argc, argv, "--stall", 500 );
+	int size = argInt( argc, argv, "--size", 400 );
+	string dataDir = dataDirArg( argc, argv );
+
+	setUniverseSize( size );
+	printf( "%d s of play, frames +-%d%%, one %d ms stall halfway, %d ticks/s fixed\n\n",
+		(int)seconds, jitter, stallMs, TICKS_PER_SECOND );
+	printf( "%6s %-9s | %8s %9s %7s %6s %8s | %8s %8s\n", "fps", "loop", "ticks/s", "flown",
+		"fuel", "score", "dropped", "judder", "interp" );
+
+	for( int fixed = 0; fixed < 2; fixed++ )
+		for( size_t r = 0; r < rates.size(); r++ )
+		{
+			Simulation sim;
+			if( !sim.load( dataDir ) )
+				return meshesMissing();
+			sim.startGame( 1234 ); /* the same universe for every run */
+			Player& player = sim.getPlayer();
+
+			TickClock clock;
+			Random frameRnd( 99 );  /* and the same frame times for a rate */
+			double t = 0, flown = 0;
+			int pulses = 0;
+			long long ticks = 0;
+			bool stalled = false;
+			Vec3 last = player.position;
+			vector<Vec3> raw, shown;
+			vector<double> frameTimes;
+			while( t < seconds )
+			{
+				double dt = (1.0 + jitter / 100.0 * (2.0 * frameRnd.RandomNum() - 1.0)) / rates[r];
+				if( !stalled && t >= seconds / 2 )
+				{
+					dt += stallMs / 1000.0;
+					stalled = true;
+				}
+				t += dt;
+				applyTimedInput( sim, t, dt, pulses );
+
+				int due = fixed ? clock.advance( dt ) : 1;
+				for( int k = 0; k < due; k++ )
+				{
+					sim.updateGame();
+					flown += (player.position - last).length();
+					last = player.position;
+				}
+				ticks += due;
+
+				/* What a frame would draw: the last tick, or between the last two */
+				frameTimes.push_back( dt );
+				raw.push_back( player.position );
+				shown.push_back( fixed ? sim.getPlayerBetweenTicks( clock.getAlpha() ).position : player.position );
+			}
+
+			printf( "%6d %-9s | %8.1f %9.2f %7.2f %6d %8lld | %7.1f%% ", rates[r],
+				fixed ? "fixed" : "per frame", ticks / t, flown, player.checkFuel(), player.getScore(),
+				clock.getDroppedTicks(), 100 * judder( raw, frameTimes ) );
+			if( fixed )
+				printf( "%7.1f%%\n", 100 * judder( shown, frameTimes ) );
+			else
+				printf( "%8s\n", "-" );
+		}
+	printf( "flown is the distance the ship covered; fuel and score should not depend on the\n"
+		"frame rate. judder is how unevenly the ship's speed looks from frame to frame,\n"
+		"interp is with the fixed loop's interpolation between ticks\n" );
+	return 0;
+}
+
+/* Nanoseconds per pass of body over count passes, taken in runs no longer
+   than a thread's event log so recording never hits the dropped path */
+template<class F> double nsPerPass( int count, bool record, const F& body )
+{
+	Profiler& profiler = Profiler::shared();
+	double us = 0;
+	for( int done = 0; done < count; done += PROFILE_EVENTS )
+	{
+		int n = min( count - done, PROFILE_EVENTS );
+		if( record )
+			profiler.start();
+		Stopwatch sw;
+		for( int i = 0; i < n; i++ )
+			body( i );
+		us += sw.elapsedUs();
+		profiler.stop();
+	}
+	return us * 1000 / count;
+}
+
+/* Ticks a fresh game (the same universe and flight every time) with the
+   profiler recording or not, returning each tick's microseconds */
+bool profiledTicks( const string& dataDir, int ticks, bool record, vector<double>& samples )
+{
+	Simulation sim;
+	if( !sim.load( dataDir ) )
+		return false;
+	sim.startGame( 1234 );
+
+	Profiler& profiler = Profiler::shared();
+	if( record )
+		profiler.start();
+	samples.clear();
+	for( int t = 0; t < ticks; t++ )
+	{
+		if( sim.isPlayerDead() )
+			sim.revivePlayer();
+		applyScriptedInput( sim, t );
+
+		Stopwatch sw;
+		sim.updateGame();
+		samples.push_back( sw.elapsedUs() );
+	}
+	profiler.stop();
+	return true;
+}
+
+int benchProfile( int argc, char **argv )
+{
+	int scopes = argInt( argc, argv, "--scopes", 1000000 );
+	int size = argInt( argc, argv, "--size", 400 );
+	int ticks = argInt( argc, argv, "--ticks", 2000 );
+	string out = argValue( argc, argv, "--out", "" );
+	string dataDir = dataDirArg( argc, argv );
+	Profiler& profiler = Profiler::shared();
+	PROFILE_THREAD( "main" );
+
+#ifdef SHAZAM_NO_PROFILE
+	printf( "built with SHAZAM_NO_PROFILE, scopes are compiled out\n\n" );
+#endif
+
+	/* The loop body stores to a volatile so the empty loop is not optimized away */
+	volatile int sink = 0;
+	double bareNs = nsPerPass( scopes, false, [&]( int i ){ sink = i; } );
+	double offNs = nsPerPass( scopes, false, [&]( int i ){ PROFILE_SCOPE( "bench" ); sink = i; } );
+	double onNs = nsPerPass( scopes, true, [&]( int i ){ PROFILE_SCOPE( "bench" ); sink = i; } );
+	printf( "%-14s %9s %9s\n", "scope", "ns", "overhead" );
+	printf( "%-14s %9.2f %9s\n", "none", bareNs, "-" );
+	printf( "%-14s %9.2f %9.2f\n", "not recording", offNs, offNs - bareNs );
+	printf( "%-14s %9.2f %9.2f\n\n", "recording", onNs, onNs - bareNs );
+
+	setUniverseSize( size );
+	vector<double> off, on;
+	if( !profiledTicks( dataDir, ticks, false, off ) || !profiledTicks( dataDir, ticks, true, on ) )
+		return meshesMissing();
+	int events = profiler.getNumEvents();
+	LatencyStats offStats( off ), onStats( on );
+	printf( "%-14s %9s %9s %9s %12s\n", "ticks", "p50(us)", "p95(us)", "p99(us)", "events/tick" );
+	printf( "%-14s %9.1f %9.1f %9.1f %12s\n", "not recording", offStats.p50, offStats.p95, offStats.p99, "-" );
+	printf( "%-14s %9.1f %9.1f %9.1f %12.1f\n", "recording", onStats.p50, onStats.p95, onStats.p99,
+		(double)events / ticks );
+	if( profiler.getNumDropped() > 0 )
+		printf( "%d events dropped, a thread's log holds %d\n", profiler.getNumDropped(), PROFILE_EVENTS );
+
+	if( !out.empty() )
+	{
+		Stopwatch sw;
+		if( !profiler.write( out ) )
+		{
+			fprintf( stderr, "Could not write %s\n", out.c_str() );
+			return 1;
+		}
+		printf( "\nwrote %d events to %s in %.1f ms\n", events, out.c_str(), sw.elapsedMs() );
+	}
+	printf( "overhead is ns per scope over the same loop without one; the ticks are %d of\n"
+		"the same scripted flight with the profiler off and recording\n", ticks );
+	return 0;
+}
+
+int benchCounters( int argc, char **argv )
+{
+	int adds = argInt( argc, argv, "--adds", 10000000 );
+	int frames = argInt( argc, argv, "--frames", 100000 );
+	int size = argInt( argc, argv, "--size", 400 );
+	int ticks = argInt( argc, argv, "--ticks", 2000 );
+	string dataDir = dataDirArg( argc, argv );
+	Counters& counters = Counters::shared();
+
+	/* The flight first, so that every counter the game has is registered
+	   (and timed) below */
+	setUniverseSize( size );
+	Simulation sim;
+	if( !sim.load( dataDir ) )
+		return meshesMissing();
+	sim.startGame( 1234 );
+	counters.endFrame(); /* loading and generating are not a tick */
+
+	int n = counters.size();
+	vector<double> sum( n, 0 ), peak( n, 0 );
+	for( int t = 0; t < ticks; t++ )
+	{
+		if( sim.isPlayerDead() )
+			sim.revivePlayer();
+		applyScriptedInput( sim, t );
+		sim.updateGame();
+		counters.endFrame();
+		for( int i = 0; i < n; i++ )
+		{
+			double v = (double)counters.getLast( i );
+			sum[i] += v;
+			peak[i] = max( peak[i], v );
+		}
+	}
+
+	Counter bench( "bench" );
+	Stopwatch sw;
+	for( int i = 0; i < adds; i++ )
+		bench.add();
+	double addNs = sw.elapsedUs() * 1000 / adds;
+
+	sw.reset();
+	for( int f = 0; f < frames; f++ )
+		counters.endFrame();
+	double frameNs = sw.elapsedUs() * 1000 / frames;
+
+#ifdef _WIN32
+	const char *nowhere = "NUL";
+#else
+	const char *nowhere = "/dev/null";
+#endif
+	counters.openStream( nowhere, COUNTERS_CSV );
+	sw.reset();
+	for( int f = 0; f < frames; f++ )
+		counters.endFrame();
+	double csvNs = sw.elapsedUs() * 1000 / frames;
+	counters.openStream( nowhere, COUNTERS_JSON );
+	sw.reset();
+	for( int f = 0; f < frames; f++ )
+		counters.endFrame();
+	double jsonNs = sw.elapsedUs() * 1000 / frames;
+	counters.closeStream();
+
+	/* volatile keeps the pair from being optimized away */
+	int * volatile p;
+	sw.reset();
+	for( int i = 0; i < adds / 10; i++ )
+	{
+		p = new int( i );
+		delete p;
+	}
+	double newNs = sw.elapsedUs() * 1000 / (adds / 10);
+
+	printf( "%d counters\n", counters.size() );
+	printf( "%-28s %9.2f ns\n", "Counter::add()", addNs );
+	printf( "%-28s %9.2f ns\n", "endFrame()", frameNs );
+	printf( "%-28s %9.2f ns\n", "endFrame() writing CSV", csvNs );
+	printf( "%-28s %9.2f ns\n", "endFrame() writing JSON", jsonNs );
+#ifdef SHAZAM_NO_ALLOC_COUNT
+	printf( "%-28s %9.2f ns (allocations not counted)\n\n", "new/delete", newNs );
+#else
+	printf( "%-28s %9.2f ns (allocations counted)\n\n", "new/delete", newNs );
+#endif
+
+	printf( "%-24s %12s %12s\n", "per tick", "mean", "peak" );
+	for( int i = 0; i < n; i++ )
+		printf( "%-24s %12.1f %12.0f\n", counters.getName( i ), sum[i] / ticks, peak[i] );
+	printf( "over %d ticks of the scripted flight at size %d; drawing counters stay 0 headless\n", ticks, size );
+	return 0;
+}
+
+int benchOverlay( int argc, char **argv )
+{
+	int frames = argInt( argc, argv, "--frames", 100000 );
+	int size = argInt( argc, argv, "--size", 400 );
+	string dataDir = dataDirArg( argc, argv );
+
+	setUniverseSize( size );
+	Simulation sim;
+	if( !sim.load( dataDir ) )
+		return meshesMissing();
+	sim.startGame( 1234 );
+
+	FrameTimes frameTimes, simTimes, renderTimes;
+	printf( "%-8s %12s %12s %12s %10s\n", "overlay", "tick(us)", "kept(ns)", "shown(ns)", "allocs" );
+	for( int shown = 0; shown < 2; shown++ )
+	{
+		double tickUs = 0, keptNs = 0;
+		long long allocs = heapAllocations.load();
+		volatile float sink = 0;
+		for( int f = 0; f < frames; f++ )
+		{
+			if( sim.isPlayerDead() )
+				sim.revivePlayer();
+			applyScriptedInput( sim, f );
+			Stopwatch tick;
+			sim.updateGame();
+			double us = tick.elapsedUs();
+			tickUs += us;
+
+			/* What Shazam does a frame, with made up frame and drawing times */
+			Stopwatch sw;
+			frameTimes.add( 16.7f + (f % 7) * 0.1f );
+			simTimes.add( (float)(us / 1000) );
+			renderTimes.add( 2.0f + (f % 13) * 0.05f );
+			if( shown )
+				sink = frameTimes.percentile( 0.50f ) + frameTimes.percentile( 0.95f ) + frameTimes.percentile( 0.99f )
+					+ simTimes.percentile( 0.50f ) + simTimes.percentile( 0.95f ) + simTimes.percentile( 0.99f )
+					+ renderTimes.percentile( 0.50f ) + renderTimes.percentile( 0.95f ) + renderTimes.percentile( 0.99f );
+			keptNs += sw.elapsedUs() * 1000;
+		}
+		allocs = heapAllocations.load() - allocs;
+		(void)sink;
+		if( shown )
+			printf( "%-8s %12.2f %12s %12.1f %10lld\n", "shown", tickUs / frames, "-", keptNs / frames, allocs );
+		else
+			printf( "%-8s %12.2f %12.1f %12s %10lld\n", "hidden", tickUs / frames, keptNs / frames, "-", allocs );
+	}
+#ifdef SHAZAM_NO_ALLOC_COUNT
+	printf( "built with SHAZAM_NO_ALLOC_COUNT, allocations are not counted\n" );
+#endif
+	printf( "ns a frame to keep %d frames of frame, tick and drawing times, and with the overlay\n"
+		"shown to work out its nine percentiles; allocs counts the whole loop, ticks included\n", FRAME_WINDOW );
+	return 0;
+}
+
+int benchReplay( int argc, char **argv )
+{
+	string in = argValue( argc, argv, "--in", "" );
+	string out = argValue( argc, argv, "--out", "" );
+	int ticks = argInt( argc, argv, "--ticks", 3600 );
+	int size = argInt( argc, argv, "--size", 400 );
+	unsigned seed = (unsigned)argInt( argc, argv, "--seed", 1234 );
+	vector<int> threads = argIntList( argc, argv, "--threads", "1,2,4" );
+	string dataDir = dataDirArg( argc, argv );
+
+	InputRecording recording;
+	if( !in.empty() )
+	{
+		if( !recording.load( in ) )
+		{
+			fprintf( stderr, "Could not read the recording %s\n", in.c_str() );
+			return 1;
+		}
+		printf( "read %s\n", in.c_str() );
+	}
+	else
+	{
+		setUniverseSize( size );
+		Simulation sim;
+		if( !sim.load( dataDir ) )
+			return meshesMissing();
+		InputRecorder recorder( sim );
+		recorder.record();
+		recorder.startGame( seed );
+		Stopwatch sw;
+		for( int t = 0; t < ticks; t++ )
+		{
+			if( sim.isPlayerDead() )
+				recorder.revivePlayer();
+			applyScriptedInput( recorder, t );
+			recorder.updateGame();
+		}
+		double flyMs = sw.elapsedMs();
+		recording = recorder.finish();
+		printf( "flew and recorded %d ticks in %.1f ms\n", ticks, flyMs );
+		if( !out.empty() )
+		{
+			if( !recording.save( out ) )
+			{
+				fprintf( stderr, "Could not write %s\n", out.c_str() );
+				return 1;
+			}
+			printf( "saved it to %s\n", out.c_str() );
+		}
+	}
+
+	/* Played back from the file image, so the format is checked too */
+	vector<unsigned char> image;
+	recording.encode( image );
+	InputRecording played;
+	if( !played.decode( &image[0], image.size() ) )
+	{
+		fprintf( stderr, "The recording does not read back\n" );
+		return 1;
+	}
+	printf( "seed %u, size %d, %d stars, %u ticks at %d a second\n", played.seed, played.universeSize,
+		played.numStars, played.ticks, played.ticksPerSecond );
+	printf( "%d inputs and %d checkpoints in %d bytes, %.1f bytes a tick\n\n", (int)played.events.size(),
+		(int)played.checkpoints.size(), (int)image.size(), (double)image.size() / max( played.ticks, 1u ) );
+
+	printf( "%8s %12s %9s %9s %9s %9s %9s %10s\n", "threads", "ticks/s", "p50(us)", "p95(us)", "p99(us)",
+		"max(us)", "checked", "mismatched" );
+	bool same = true;
+	double hashUs = 0;
+	for( size_t k = 0; k < threads.size(); k++ )
+	{
+		JobSystem jobs( threads[k] );
+		Simulation sim;
+		sim.setJobs( jobs );
+		if( !sim.load( dataDir ) )
+			return meshesMissing();
+		InputReplayer replay( sim );
+		replay.start( played );
+		while( replay.updateGame() )
+			;
+		LatencyStats st( replay.getTickTimes() );
+		printf( "%8d %12.0f %9.1f %9.1f %9.1f %9.1f %9d %10d", jobs.getNumThreads(),
+			st.total > 0 ? st.count / (st.total / 1e6) : 0.0, st.p50, st.p95, st.p99, st.max,
+			replay.getCheckpointsChecked(), replay.getMismatches() );
+		if( replay.getMismatches() > 0 )
+			printf( "  first at tick %lld", replay.getFirstMismatch() );
+		printf( "\n" );
+		same = same && replay.getMismatches() == 0;
+
+		if( k == 0 )
+		{
+			volatile unsigned long long sink = 0;
+			Stopwatch sw;
+			for( int i = 0; i < 1000; i++ )
+				sink = sink + hashState( sim );
+			hashUs = sw.elapsedUs() / 1000;
+		}
+	}
+	printf( "\na state hash takes %.2f us, one every %d ticks; the ticks are timed without it\n",
+		hashUs, played.checkpointTicks );
+	printf( "%s\n", same ? "every playback matched the recording" : "PLAYBACK DIFFERS FROM THE RECORDING" );
+	return same ? 0 : 1;
+}
+
+/* Random as it was: a window onto rand(), reseeded from time() whenever
+   one was made */
+struct LegacyRandom
+{
+	LegacyRandom(){ srand( (unsigned)time( NULL ) ); rand(); }
+	double RandomNum(){ return rand() / double(RAND_MAX); }
+	int RandomInt( int n ){ return rand() % n; }
+	int RandomInt( int min, int max ){ return min + int(RandomNum() * (max - min + 1)); }
+};
+
+/* How many different values count draws of [0, range) came out as */
+template<class R> int distinctValues( R& rnd, int range, int count )
+{
+	vector<bool> seen( range, false );
+	int distinct = 0;
+	for( int i = 0; i < count; i++ )
+	{
+		int v = rnd.RandomInt( 0, range - 1 );
+		v = v < 0 ? 0 : (v >= range ? range - 1 : v); /* the old one could reach range */
+		if( !seen[v] )
+		{
+			seen[v] = true;
+			distinct++;
+		}
+	}
+	return distinct;
+}
+
+int benchRandom( int argc, char **argv )
+{
+	int count = argInt( argc, argv, "--count", 10000000 );
+	vector<int> sizes = argIntList( argc, argv, "--sizes", "400,4000,40000" );
+	int stars = argInt( argc, argv, "--stars", 0 );
+	string dataDir = dataDirArg( argc, argv );
+
+	LegacyRandom legacy;
+	Random rnd( 1234 );
+	vector<int> ints( count );
+	volatile double sink = 0;
+
+	Stopwatch sw;
+	for( int i = 0; i < count; i++ )
+		ints[i] = legacy.RandomInt( -500, 501 );
+	double legacyIntNs = sw.elapsedUs() * 1000 / count;
+	sw.reset();
+	double sum = 0;
+	for( int i = 0; i < count; i++ )
+		sum += legacy.RandomNum();
+	double legacyNumNs = sw.elapsedUs() * 1000 / count;
+
+	sw.reset();
+	for( int i = 0; i < count; i++ )
+		ints[i] = rnd.RandomInt( -500, 501 );
+	double intNs = sw.elapsedUs() * 1000 / count;
+	sw.reset();
+	for( int i = 0; i < count; i++ )
+		sum += rnd.RandomNum();
+	double numNs = sw.elapsedUs() * 1000 / count;
+	sw.reset();
+	rnd.fill( &ints[0], count, -500, 501 );
+	double fillNs = sw.elapsedUs() * 1000 / count;
+	sink = sum + ints[count / 2];
+	(void)sink;
+
+	int range = 1 << 20;
+	int legacyDistinct = distinctValues( legacy, range, range );
+	int distinct = distinctValues( rnd, range, range );
+
+	printf( "%-22s %12s %12s %12s %16s\n", "generator", "int(ns)", "double(ns)", "fill(ns)", "distinct of 2^20" );
+	printf( "%-22s %12.2f %12.2f %12s %16d\n", "rand() (old Random)", legacyIntNs, legacyNumNs, "-", legacyDistinct );
+	printf( "%-22s %12.2f %12.2f %12.2f %16d\n", "xoshiro256**", intNs, numNs, fillNs, distinct );
+	printf( "RAND_MAX is %d here; %d draws of 2^20 values hit about 63%% of them when every value can come up\n\n",
+		RAND_MAX, range );
+
+	printf( "%8s %8s %8s %10s %10s %10s\n", "size", "entities", "stars", "gen(ms)", "same seed", "streams" );
+	for( size_t k = 0; k < sizes.size(); k++ )
+	{
+		setUniverseSize( sizes[k] );
+		if( stars > 0 )
+			setNumStars( stars );
+		Simulation sim;
+		if( !sim.load( dataDir ) )
+			return meshesMissing();
+		Universe& universe = sim.getUniverse();
+
+		sim.startGame( 1234 ); /* warms the meshes and the allocations */
+		Stopwatch gen;
+		universe.generate( 1234 );
+		double genMs = gen.elapsedMs();
+		unsigned long long first = hashState( sim, true );
+		vector<Vec3> placed = universe.getEntities().position;
+
+		/* The same seed again, after another has been generated in between */
+		universe.generate( 99 );
+		universe.generate( 1234 );
+		bool same = hashState( sim, true ) == first;
+
+		/* Half the stars, drawn from their own stream, move nothing else */
+		int numStars = (int)universe.getStars().size();
+		setNumStars( numStars / 2 );
+		universe.generate( 1234 );
+		bool independent = universe.getEntities().position == placed;
+		setNumStars( numStars );
+
+		printf( "%8d %8d %8d %10.2f %10s %10s\n", sizes[k], (int)placed.size(), numStars, genMs,
+			same ? "yes" : "NO", independent ? "yes" : "NO" );
+		if( !same || !independent )
+			return 1;
+	}
+	printf( "same seed: generating 1234 again gives the same universe, stars and all; streams: with half\n"
+		"the stars the bad guys and power ups stay where they were\n" );
+	return 0;
+}
+
+void usage()
+{
+	printf( "Usage: ShazamBench <benchmark> [options]\n" );
+	printf( "  tick [--sizes 100,200,400] [--ticks 5000] [--warmup 200] [--stars N] [--counters FILE]\n" );
+	printf( "  collide [--counts 1000,10000,100000] [--queries 20000]\n" );
+	printf( "  meshload [--runs 200]\n" );
+	printf( "  batch [--runs 200]\n" );
+	printf( "  meshlayout [--copies 64] [--passes 200] [--scatter]\n" );
+	printf( "  bvh [--queries 20000]\n" );
+	printf( "  lod [--sizes 100,200,400] [--frames 2000] [--height 480] [--pov 150]\n" );
+	printf( "  cull [--sizes 100,200,400] [--frames 2000]\n" );
+	printf( "  registry [--threads 1,2,4] [--runs 20]\n" );
+	printf( "  math [--count 100000] [--passes 50]\n" );
+	printf( "  entities [--counts 1000,10000,100000] [--passes 50]\n" );
+	printf( "  spin [--counts 1000,10000,100000] [--passes 200]\n" );
+	printf( "  overlap [--counts 1000,10000,100000] [--probes 64] [--queries 2000]\n" );
+	printf( "  churn [--entities 10000,100000] [--churn 100,1000,5000] [--ticks 200] [--held 1000]\n" );
+	printf( "  jobs [--size 400000] [--stars 1000] [--threads 1,2,4] [--runs 50] [--probes 64]\n" );
+	printf( "  timestep [--rates 30,60,144,500] [--seconds 20] [--jitter 20] [--stall 500] [--size 400]\n" );
+	printf( "  profile [--scopes 1000000] [--size 400] [--ticks 2000] [--out FILE]\n" );
+	printf( "  counters [--adds 10000000] [--frames 100000] [--size 400] [--ticks 2000]\n" );
+	printf( "  overlay [--frames 100000] [--size 400]\n" );
+	printf( "  replay [--in FILE] [--out FILE] [--ticks 3600] [--size 400] [--seed 1234] [--threads 1,2,4]\n" );
+	printf( "  random [--count 10000000] [--sizes 400,4000,40000] [--stars N]\n" );
+	printf( "Common options: --data <folder with .3vnc meshes>\n" );
+}
+
+int main( int argc, char **argv )
+{
+	if( argc < 2 )
+	{
+		usage();
+		return 1;
+	}
+
+	string which = argv[1];
+	if( which == "tick" )
+		return benchTick( argc, argv );
+	if( which == "collide" )
+		return benchCollide( argc, argv );
+	if( which == "meshload" )
+		return benchMeshLoad( argc, argv );
+	if( which == "batch" )
+		return benchBatch( argc, argv );
+	if( which == "meshlayout" )
+		return benchMeshLayout( argc, argv );
+	if( which == "bvh" )
+		return benchBVH( argc, argv );
+	if( which == "lod" )
+		return benchLOD( argc, argv );
+	if( which == "cull" )
+		return benchCull( argc, argv );
+	if( which == "registry" )
+		return benchRegistry( argc, argv );
+	if( which == "math" )
+		return benchMath( argc, argv );
+	if( which == "entities" )
+		return benchEntities( argc, argv );
+	if( which == "spin" )
+		return benchSpin( argc, argv );
+	if( which == "overlap" )
+		return benchOverlap( argc, argv );
+	if( which == "churn" )
+		return benchChurn( argc, argv );
+	if( which == "jobs" )
+		return benchJobs( argc, argv );
+	if( which == "timestep" )
+		return benchTimestep( argc, argv );
+	if( which == "profile" )
+		return benchProfile( argc, argv );
+	if( which == "counters" )
+		return benchCounters( argc, argv );
+	if( which == "overlay" )
+		return benchOverlay( argc, argv );
+	if( which == "replay" )
+		return benchReplay( argc, argv );
+	if( which == "random" )
+		return benchRandom( argc, argv );
+
+	usage();
+	return 1;
+}
@@ -0,0 +1,292 @@
+/* Simulation.h
+ * The headless core of the game: the universe, the player and the rules that
+ * tie them together. Nothing in here touches GLUT or OpenGL, so a tick can be
+ * run (and timed) on a machine without a display. The GLUT front end in
+ * Shazam.h is just one client of this class, ShazamBench.cpp is another.
+ *
+ * A tick is a small TaskGraph on a JobSystem (the shared one unless
+ * setJobs() says otherwise): the rules first, since they remove what the
+ * player hits, then turning the entities (split across the pool) alongside
+ * flying the ship. Whatever touches the same data still runs in the old
+ * serial order, so the results do not depend on the thread count.
+ */
+
+#pragma once
+
+#include "Player.h"
+
+Counter countTicks( "ticks" ); /* run in the frame, 0 to MAX_CATCH_UP_TICKS in the game */
+
+enum ShazamMode { MAIN_MENU = 0, PLAYING }; /* Not used currently */
+
+#define NUM_PLAYERS					1 /* We want multiplayer support later eh? :) */
+
+#define STARTING_FUEL				100
+#define TARGET_RANGE				500.0f /* how far the crosshair looks for a target */
+#define UNIVERSE_SEED				1234   /* the universe startGame() generates until told another */
+
+class Simulation
+{
+private:
+	ShazamMode mode;
+	Universe universe; /* Create the universe */
+	Player player;
+	bool oob;     /* out of bounds (out of gray box) */
+	bool playerDead;
+	bool won;
+
+	/* What is under the crosshair, worked out on request once per tick */
+	bool targetValid, targeted;
+	OBJECT_TYPE targetType;
+	EntityHandle target;
+	float targetDistance;
+
+	EntityHandle watcher; /* the bad guy whose view the enemy POV window shows */
+
+	JobSystem *jobs;
+	TaskGraph tick; /* updateGame()'s phases, built once */
+
+	Camera lastPlayerView; /* where the player was before the last tick, for drawing between ticks */
+	unsigned seed;         /* the universe of the last startGame() */
+
+	/* Collisions, fuel and winning or losing */
+	void applyRules()
+	{
+		PROFILE_SCOPE( "Simulation::applyRules" );
+		int badGuysHit, powerUpsHit;
+		universe.collide( player, badGuysHit, powerUpsHit );
+		countBadGuysHit.add( badGuysHit );
+		countPowerUpsTaken.add( powerUpsHit );
+		if( badGuysHit > 0 )
+			player.increaseScore( 10 * badGuysHit );
+
+		if( powerUpsHit > 0 )
+		{
+			player.increaseFuel( 40 * powerUpsHit );
+		}
+
+		if( universe.checkOOB( player ) )
+		{
+			if( universe.checkDeadZone( player ) )
+			{
+				if( !playerDead )
+					player.increaseFuel( -10 ); /* lose fuel FAST */
+			}
+			oob = true;
+		}
+		else
+		{
+			oob = false;
+		}
+
+		if( player.checkFuel() <= 0.0f )
+			killPlayer();
+
+		/* Travelling faster uses more fuel! */
+		if( !playerDead && !won)
+			player.increaseFuel( abs(player.getVelocity()) * -0.1f - 0.015f );
+
+		if( universe.getNumBadGuys() <= 0 && !playerDead )
+			winGame();
+	}
+
+	void findTarget()
+	{
+		if( targetValid )
+			return;
+		int index;
+		targeted = universe.raycast( player.position, player.getLookDirection(), TARGET_RANGE,
+			targetType, index, targetDistance );
+		target = targeted ? universe.getEntities().getHandle( index ) : EntityHandle();
+		targetValid = true;
+	}
+
+public:
+	Simulation()
+	{
+		won = oob = playerDead = targeted = targetValid = false;
+		targetDistance = 0;
+		targetType = OBJECT_BADGUY;
+		mode = MAIN_MENU;
+		player.resetScore();
+		jobs = &JobSystem::shared();
+		seed = UNIVERSE_SEED;
+
+		int rules = tick.add( [this](){ applyRules(); } );
+		int spin = tick.add( [this](){ universe.updateRotations( *jobs ); } );
+		int fly = tick.add( [this](){ player.update(); } ); /* this used to happen as a side effect of drawing it */
+		tick.precede( rules, spin );
+		tick.precede( rules, fly );
+	}
+
+	/* The pool ticks run on from now on */
+	void setJobs( JobSystem& js ){ jobs = &js; }
+	JobSystem& getJobs(){ return *jobs; }
+
+	/* Starts loading every mesh the game needs from dataDir (empty =>
+	   working dir) on the mesh registry's worker threads and returns */
+	void loadAsync( const string& dataDir = "" )
+	{
+		universe.loadMeshes( dataDir );
+		player.loadMesh( dataDir );
+	}
+
+	/* Waits for loadAsync() to finish, false if any mesh could not be read */
+	bool finishLoading()
+	{
+		bool universeOk = universe.finishLoading();
+		bool playerOk = player.getMeshHandle().wait();
+		return universeOk && playerOk;
+	}
+
+	/* loadAsync() and finishLoading() in one */
+	bool load( const string& dataDir = "" )
+	{
+		loadAsync( dataDir );
+		return finishLoading();
+	}
+
+	ShazamMode getMode(){ return mode; }
+
+	Universe& getUniverse(){ return universe; }
+	Player& getPlayer(){ return player; }
+
+	bool isOOB(){ return oob; }
+
+	bool isPlayerDead()
+	{
+		return playerDead;
+	}
+
+	void killPlayer()
+	{
+		won = false;
+		playerDead = true;
+		player.stopMoving();
+	}
+
+	void revivePlayer()
+	{
+		won = false;
+		playerDead = false;
+		player.setFuel( STARTING_FUEL );
+	}
+
+	/* Starts a game in the universe generated from s, the same seed always
+	   generating the same universe */
+	void startGame( unsigned s )
+	{
+		seed = s;
+		player.resetScore();
+		oob = false;
+		revivePlayer();
+		mode = PLAYING;
+
+		/* The hashes need every mesh's bounds */
+		finishLoading();
+		universe.generate( seed );
+		player.setDefault();
+		lastPlayerView = player;
+		targetValid = false;
+	}
+
+	/* Starts the last game's universe over, UNIVERSE_SEED's at first */
+	void startGame(){ startGame( seed ); }
+	unsigned getSeed(){ return seed; }
+
+	void goToMainMenu()
+	{
+		mode = MAIN_MENU;
+	}
+
+	void winGame()
+	{
+		won = true;
+		player.stopMoving();
+	}
+
+	/* Advances the game by one tick, a fixed step of time (see TickClock.h) */
+	void updateGame()
+	{
+		PROFILE_SCOPE( "Simulation::updateGame" );
+		countTicks.add();
+		lastPlayerView = player;
+		tick.run( *jobs );
+		//player.addRotation( 0, 0, player.getLookVelocity().x );
+
+		targetValid = false;
+	}
+
+	bool hasWon(){ return won; }
+
+	/* The player alpha of the way (0 to 1) from where the tick before the
+	   last left them to where the last one did, to draw between ticks */
+	Player getPlayerBetweenTicks( float alpha )
+	{
+		Player p = player;
+		p.setBetween( lastPlayerView, player, alpha );
+		return p;
+	}
+
+	/* True if the crosshair is on a bad guy or power up, which one and how far */
+	bool hasTarget(){ findTarget(); return targeted; }
+	bool getTarget( OBJECT_TYPE& type, EntityHandle& handle, float& distance )
+	{
+		findTarget();
+		type = targetType;
+		handle = target;
+		distance = targetDistance;
+		return targeted;
+	}
+
+	/* Index of the bad guy the enemy POV window watches from, -1 once they
+	   are all gone. It sticks with one until that one is destroyed. */
+	int getWatcher()
+	{
+		int i = universe.getEntities().indexOf( watcher );
+		if( i < 0 )
+		{
+			i = universe.getFirstBadGuy();
+			watcher = i >= 0 ? universe.getEntities().getHandle( i ) : EntityHandle();
+		}
+		return i;
+	}
+
+	void playerYaw( float amt )
+	{
+		//player.addRotation( 0.0f, amt, 0.0f );
+		player.yaw(amt);
+	}
+	void playerPitch( float amt )
+	{
+		//player.addRotation( amt, 0.0f, 0.0f );
+		player.pitch( amt );
+	}
+
+	void playerRoll( float amt )
+	{
+		player.accelRoll( amt );
+	}
+
+	void playerRoll2( float amt )
+	{
+		player.roll( amt );
+	}
+
+	void movePlayerForward( float amt )
+	{
+		if( !playerDead && !won)
+			player.accelForward( amt );
+	}
+	void movePlayerRight( float amt )
+	{
+		if( !playerDead && !won )
+			player.moveRight( amt );
+	}
+
+	void toggleHitBoxes()
+	{
+		universe.toggleHitBoxVisible();
+	}
+
+};
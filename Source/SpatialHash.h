@@ -0,0 +1,306 @@
+/* SpatialHash.h
+ * Broad phase for sphere collision queries. Space is cut into a uniform grid
+ * of cubic cells and every cell is hashed into a fixed table of buckets, so
+ * the grid has no bounds and costs memory only for occupied buckets.
+ *
+ * Entities are identified by the int id their owner uses (Universe uses the
+ * index into its vector). Each bucket keeps a float copy of its entities'
+ * centers and radii, so a query never touches the owner's objects, reads one
+ * contiguous block per bucket and returns only exact sphere overlaps.
+ *
+ * Keep it up to date with insert(), move(), remove() and relabel(); relabel()
+ * is what an owner calls after moving its last element into a hole. When
+ * most entities move at once rebuild() starts it over, spread across a
+ * JobSystem.
+ */
+
+#pragma once
+
+#include <vector>
+#include <cmath>
+#include "VecMath.h"
+#include "JobSystem.h"
+
+using namespace std;
+
+#define REBUILD_GRAIN 8192 /* fewest entities (or buckets) a rebuild() job takes */
+
+class SpatialHash
+{
+private:
+	static const int SMALL_QUERY = 27; /* a 3x3x3 block of cells */
+
+	struct Entry
+	{
+		float x, y, z, r;
+		int id;
+	};
+
+	float invCellSize;
+	float maxRadius;   /* biggest radius ever inserted, widens each query */
+	unsigned mask;     /* buckets.size() - 1 */
+	int count;
+
+	vector< vector<Entry> > buckets;
+	vector<unsigned> stamp;  /* query id that last visited each bucket */
+	unsigned queryStamp;
+
+	vector<int> bucketOf;    /* indexed by id, -1 => id not in the hash */
+	vector<int> placeOf;     /* rebuild() scratch, where in its bucket each id goes */
+	vector<int> bucketSize;  /* rebuild() scratch */
+
+	int cellCoord( float v ){ return (int)floor( v * invCellSize ); }
+
+	unsigned hashCell( int ix, int iy, int iz )
+	{
+		return ( (unsigned)ix * 73856093u ^ (unsigned)iy * 19349663u ^ (unsigned)iz * 83492791u ) & mask;
+	}
+
+	unsigned bucketFor( float x, float y, float z )
+	{
+		return hashCell( cellCoord(x), cellCoord(y), cellCoord(z) );
+	}
+
+	Entry *find( int id )
+	{
+		vector<Entry>& b = buckets[bucketOf[id]];
+		for( unsigned i = 0; i < b.size(); i++ )
+			if( b[i].id == id )
+				return &b[i];
+		return NULL;
+	}
+
+	/* Takes id out of its bucket and returns its entry */
+	Entry unlink( int id )
+	{
+		vector<Entry>& b = buckets[bucketOf[id]];
+		Entry *e = find( id );
+		Entry old = *e;
+		*e = b.back();
+		b.pop_back();
+		bucketOf[id] = -1;
+		return old;
+	}
+
+	void link( const Entry& e )
+	{
+		unsigned b = bucketFor( e.x, e.y, e.z );
+		buckets[b].push_back( e );
+		bucketOf[e.id] = b;
+	}
+
+	/* Narrow phase over one bucket */
+	int scanBucket( unsigned b, float x, float y, float z, float r, vector<int>& hits )
+	{
+		vector<Entry>& bucket = buckets[b];
+		int found = 0;
+		for( unsigned i = 0; i < bucket.size(); i++ )
+		{
+			const Entry& e = bucket[i];
+			float dx = e.x - x, dy = e.y - y, dz = e.z - z;
+			float rr = r + e.r;
+			if( dx*dx + dy*dy + dz*dz < rr*rr )
+			{
+				hits.push_back( e.id );
+				found++;
+			}
+		}
+		return found;
+	}
+
+	/* Resizes the bucket table and redistributes every entity */
+	void rehash( unsigned numBuckets )
+	{
+		vector< vector<Entry> > old;
+		old.swap( buckets );
+		buckets.assign( numBuckets, vector<Entry>() );
+		stamp.assign( numBuckets, 0 );
+		mask = numBuckets - 1;
+		for( unsigned b = 0; b < old.size(); b++ )
+			for( unsigned i = 0; i < old[b].size(); i++ )
+				link( old[b][i] );
+	}
+
+public:
+	/* cellSize should be a few times the diameter of a typical entity */
+	SpatialHash( float cellSize = 8.0f )
+	{
+		invCellSize = 1.0f / cellSize;
+		queryStamp = 0;
+		clear( 64 );
+	}
+
+	/* Empties the hash and sizes it for about expectedCount entities */
+	void clear( int expectedCount )
+	{
+		unsigned numBuckets = 64;
+		while( numBuckets < 2u * (unsigned)expectedCount )
+			numBuckets <<= 1;
+
+		buckets.assign( numBuckets, vector<Entry>() );
+		stamp.assign( numBuckets, 0 );
+		mask = numBuckets - 1;
+		count = 0;
+		maxRadius = 0;
+		bucketOf.clear();
+	}
+
+	int size(){ return count; }
+
+	bool contains( int id ){ return id >= 0 && id < (int)bucketOf.size() && bucketOf[id] >= 0; }
+
+	void insert( int id, const Vec3& center, float r )
+	{
+		if( id >= (int)bucketOf.size() )
+			bucketOf.resize( id + 1, -1 );
+		if( bucketOf[id] >= 0 )
+			unlink( id );
+		else
+			count++;
+
+		if( r > maxRadius )
+			maxRadius = r;
+		if( (unsigned)count > 2 * buckets.size() )
+			rehash( (unsigned)buckets.size() * 2 );
+
+		Entry e = { (float)center.x, (float)center.y, (float)center.z, r, id };
+		link( e );
+	}
+
+	/* Empties the hash and fills it with ids 0 to n-1, id i at center[i] with
+	   radius[i]. The buckets come out as n insert()s in id order would leave
+	   them, but only the counting is serial: the hashing, the bucket sizing
+	   and the copying in are split across jobs. */
+	void rebuild( int n, const Vec3 *center, const float *radius, JobSystem& jobs )
+	{
+		clear( n );
+		if( n <= 0 )
+			return;
+		bucketOf.resize( n );
+		placeOf.resize( n );
+		bucketSize.assign( buckets.size(), 0 );
+
+		jobs.parallelFor( 0, n, REBUILD_GRAIN, [&]( int lo, int hi )
+		{
+			for( int i = lo; i < hi; i++ )
+				bucketOf[i] = (int)bucketFor( center[i].x, center[i].y, center[i].z );
+		} );
+
+		for( int i = 0; i < n; i++ )
+		{
+			placeOf[i] = bucketSize[bucketOf[i]]++;
+			if( radius[i] > maxRadius )
+				maxRadius = radius[i];
+		}
+		count = n;
+
+		jobs.parallelFor( 0, (int)buckets.size(), REBUILD_GRAIN, [&]( int lo, int hi )
+		{
+			for( int b = lo; b < hi; b++ )
+				buckets[b].resize( bucketSize[b] );
+		} );
+
+		jobs.parallelFor( 0, n, REBUILD_GRAIN, [&]( int lo, int hi )
+		{
+			for( int i = lo; i < hi; i++ )
+			{
+				Entry e = { center[i].x, center[i].y, center[i].z, radius[i], i };
+				buckets[bucketOf[i]][placeOf[i]] = e;
+			}
+		} );
+	}
+
+	/* Updates an entity's center, only touching buckets if it changed cell */
+	void move( int id, const Vec3& center )
+	{
+		Entry *e = find( id );
+		e->x = center.x; e->y = center.y; e->z = center.z;
+
+		if( (int)bucketFor( e->x, e->y, e->z ) != bucketOf[id] )
+			link( unlink( id ) );
+	}
+
+	void remove( int id )
+	{
+		if( !contains(id) )
+			return;
+		unlink( id );
+		count--;
+	}
+
+	/* The owner moved entity "from" into slot "to" (swap-and-pop), follow it */
+	void relabel( int from, int to )
+	{
+		if( !contains(from) )
+			return;
+		if( to >= (int)bucketOf.size() )
+			bucketOf.resize( to + 1, -1 );
+		remove( to );
+
+		find( from )->id = to;
+		bucketOf[to] = bucketOf[from];
+		bucketOf[from] = -1;
+	}
+
+	/* Appends the id of every entity whose sphere overlaps the sphere (center, r)
+	   to hits and returns how many were appended. */
+	int query( const Vec3& center, float r, vector<int>& hits )
+	{
+		float x = center.x, y = center.y, z = center.z;
+		float reach = r + maxRadius;
+		int x0 = cellCoord( x - reach ), x1 = cellCoord( x + reach );
+		int y0 = cellCoord( y - reach ), y1 = cellCoord( y + reach );
+		int z0 = cellCoord( z - reach ), z1 = cellCoord( z + reach );
+		int found = 0;
+
+		/* A query wider than the table is cheaper as a walk over every bucket */
+		double cells = double(x1 - x0 + 1) * (y1 - y0 + 1) * (z1 - z0 + 1);
+		if( cells >= buckets.size() )
+		{
+			for( unsigned b = 0; b < buckets.size(); b++ )
+				found += scanBucket( b, x, y, z, r, hits );
+			return found;
+		}
+
+		/* Different cells can share a bucket, only scan each bucket once. The
+		   usual few-cell query remembers them on the stack, big ones use stamps. */
+		if( cells <= SMALL_QUERY )
+		{
+			unsigned seen[SMALL_QUERY];
+			int numSeen = 0;
+			for( int ix = x0; ix <= x1; ix++ )
+				for( int iy = y0; iy <= y1; iy++ )
+					for( int iz = z0; iz <= z1; iz++ )
+					{
+						unsigned b = hashCell( ix, iy, iz );
+						bool dup = false;
+						for( int i = 0; i < numSeen && !dup; i++ )
+							dup = seen[i] == b;
+						if( dup )
+							continue;
+						seen[numSeen++] = b;
+						found += scanBucket( b, x, y, z, r, hits );
+					}
+			return found;
+		}
+
+		if( ++queryStamp == 0 )
+		{
+			stamp.assign( stamp.size(), 0 );
+			queryStamp = 1;
+		}
+
+		for( int ix = x0; ix <= x1; ix++ )
+			for( int iy = y0; iy <= y1; iy++ )
+				for( int iz = z0; iz <= z1; iz++ )
+				{
+					unsigned b = hashCell( ix, iy, iz );
+					if( stamp[b] == queryStamp )
+						continue;
+					stamp[b] = queryStamp;
+					found += scanBucket( b, x, y, z, r, hits );
+				}
+
+		return found;
+	}
+};
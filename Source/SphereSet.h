@@ -0,0 +1,226 @@
+/* SphereSet.h
+ * Spheres kept as four packed float arrays, the centers' x, y and z and the
+ * radii, so that overlap tests can run down them several spheres at a time.
+ * The kernels compare squared distances against squared radius sums (no
+ * sqrt) and report through a hit mask, bit i%32 of word i/32 for sphere i.
+ *
+ * overlapMask() and overlapAnyMask() use AVX when the compiler targets it,
+ * SSE otherwise (any x64 build) and plain C++ under SHAZAM_NO_SIMD, see
+ * VecMath.h. The ...Scalar() versions are the plain ones, for checking them.
+ * The ...Block() versions fill in part of a mask, so that jobs handed runs
+ * of whole mask words can share one (see Universe::overlapping()).
+ * Touching means strictly closer than the sum of the radii, as in
+ * Object::checkCollision() and SpatialHash.
+ */
+
+#pragma once
+
+#include <vector>
+#include "VecMath.h"
+
+using namespace std;
+
+class SphereSet
+{
+public:
+	vector<float> x, y, z, r;
+
+	int size() const { return (int)x.size(); }
+
+	void clear(){ x.clear(); y.clear(); z.clear(); r.clear(); }
+	void reserve( int n ){ x.reserve( n ); y.reserve( n ); z.reserve( n ); r.reserve( n ); }
+
+	void add( const Vec3& c, float radius )
+	{
+		x.push_back( c.x ); y.push_back( c.y ); z.push_back( c.z ); r.push_back( radius );
+	}
+
+	void set( int i, const Vec3& c, float radius )
+	{
+		x[i] = c.x; y[i] = c.y; z[i] = c.z; r[i] = radius;
+	}
+
+	/* Swap-and-pop, like EntityStore::remove() */
+	void remove( int i )
+	{
+		int last = size() - 1;
+		if( i != last )
+			set( i, getCenter( last ), r[last] );
+		x.pop_back(); y.pop_back(); z.pop_back(); r.pop_back();
+	}
+
+	Vec3 getCenter( int i ) const { return Vec3( x[i], y[i], z[i] ); }
+};
+
+/* Words a hit mask over n spheres takes */
+inline int maskWords( int n ){ return (n + 31) / 32; }
+
+inline bool maskBit( const vector<unsigned>& mask, int i ){ return (mask[i >> 5] >> (i & 31)) & 1; }
+
+/* Set bits in a SIMD compare's movemask */
+inline int countBits( unsigned bits )
+{
+	int n = 0;
+	for( ; bits; bits &= bits - 1 )
+		n++;
+	return n;
+}
+
+/* Bit i for each sphere i of set in [first, last) that touches (c, radius) */
+inline int overlapMaskRange( const SphereSet& set, int first, int last, const Vec3& c, float radius, vector<unsigned>& mask )
+{
+	int hits = 0;
+	for( int i = first; i < last; i++ )
+	{
+		float dx = set.x[i] - c.x, dy = set.y[i] - c.y, dz = set.z[i] - c.z;
+		float rr = set.r[i] + radius;
+		if( dx*dx + dy*dy + dz*dz < rr*rr )
+		{
+			mask[i >> 5] |= 1u << (i & 31);
+			hits++;
+		}
+	}
+	return hits;
+}
+
+/* Clears mask to set's size, then sets the bit of every sphere of set that
+   touches (c, radius). Returns how many do. */
+inline int overlapMaskScalar( const SphereSet& set, const Vec3& c, float radius, vector<unsigned>& mask )
+{
+	mask.assign( maskWords( set.size() ), 0 );
+	return overlapMaskRange( set, 0, set.size(), c, radius, mask );
+}
+
+/* overlapMaskRange() several spheres at a time, first a multiple of 32.
+   The mask should be sized and those bits clear. */
+inline int overlapMaskBlock( const SphereSet& set, int first, int last, const Vec3& c, float radius, vector<unsigned>& mask )
+{
+	int i = first, hits = 0;
+#if defined(VECMATH_AVX)
+	const __m256 cx = _mm256_set1_ps( c.x ), cy = _mm256_set1_ps( c.y ), cz = _mm256_set1_ps( c.z ), cr = _mm256_set1_ps( radius );
+	for( ; i + 8 <= last; i += 8 )
+	{
+		__m256 dx = _mm256_sub_ps( _mm256_loadu_ps( &set.x[i] ), cx );
+		__m256 dy = _mm256_sub_ps( _mm256_loadu_ps( &set.y[i] ), cy );
+		__m256 dz = _mm256_sub_ps( _mm256_loadu_ps( &set.z[i] ), cz );
+		__m256 rr = _mm256_add_ps( _mm256_loadu_ps( &set.r[i] ), cr );
+		__m256 dd = _mm256_add_ps( _mm256_add_ps( _mm256_mul_ps( dx, dx ), _mm256_mul_ps( dy, dy ) ), _mm256_mul_ps( dz, dz ) );
+		unsigned bits = (unsigned)_mm256_movemask_ps( _mm256_cmp_ps( dd, _mm256_mul_ps( rr, rr ), _CMP_LT_OQ ) );
+		if( bits )
+		{
+			mask[i >> 5] |= bits << (i & 31);
+			hits += countBits( bits );
+		}
+	}
+#elif defined(VECMATH_SSE)
+	const __m128 cx = _mm_set1_ps( c.x ), cy = _mm_set1_ps( c.y ), cz = _mm_set1_ps( c.z ), cr = _mm_set1_ps( radius );
+	for( ; i + 4 <= last; i += 4 )
+	{
+		__m128 dx = _mm_sub_ps( _mm_loadu_ps( &set.x[i] ), cx );
+		__m128 dy = _mm_sub_ps( _mm_loadu_ps( &set.y[i] ), cy );
+		__m128 dz = _mm_sub_ps( _mm_loadu_ps( &set.z[i] ), cz );
+		__m128 rr = _mm_add_ps( _mm_loadu_ps( &set.r[i] ), cr );
+		__m128 dd = _mm_add_ps( _mm_add_ps( _mm_mul_ps( dx, dx ), _mm_mul_ps( dy, dy ) ), _mm_mul_ps( dz, dz ) );
+		unsigned bits = (unsigned)_mm_movemask_ps( _mm_cmplt_ps( dd, _mm_mul_ps( rr, rr ) ) );
+		if( bits )
+		{
+			mask[i >> 5] |= bits << (i & 31);
+			hits += countBits( bits );
+		}
+	}
+#endif
+	return hits + overlapMaskRange( set, i, last, c, radius, mask );
+}
+
+inline int overlapMask( const SphereSet& set, const Vec3& c, float radius, vector<unsigned>& mask )
+{
+	mask.assign( maskWords( set.size() ), 0 );
+	return overlapMaskBlock( set, 0, set.size(), c, radius, mask );
+}
+
+/* Bit i for each sphere i of set in [first, last) that touches any probe */
+inline int overlapAnyMaskRange( const SphereSet& set, int first, int last, const SphereSet& probes, vector<unsigned>& mask )
+{
+	int hits = 0;
+	for( int i = first; i < last; i++ )
+		for( int p = 0; p < probes.size(); p++ )
+		{
+			float dx = set.x[i] - probes.x[p], dy = set.y[i] - probes.y[p], dz = set.z[i] - probes.z[p];
+			float rr = set.r[i] + probes.r[p];
+			if( dx*dx + dy*dy + dz*dz < rr*rr )
+			{
+				mask[i >> 5] |= 1u << (i & 31);
+				hits++;
+				break;
+			}
+		}
+	return hits;
+}
+
+/* overlapMask() for a whole set of probes (projectiles, say) in one pass
+   over set: the bit of every sphere of set that touches any probe. */
+inline int overlapAnyMaskScalar( const SphereSet& set, const SphereSet& probes, vector<unsigned>& mask )
+{
+	mask.assign( maskWords( set.size() ), 0 );
+	return overlapAnyMaskRange( set, 0, set.size(), probes, mask );
+}
+
+/* overlapAnyMaskRange() several spheres at a time, as overlapMaskBlock() */
+inline int overlapAnyMaskBlock( const SphereSet& set, int first, int last, const SphereSet& probes, vector<unsigned>& mask )
+{
+	int i = first, hits = 0;
+#if defined(VECMATH_AVX)
+	const int numProbes = probes.size();
+	for( ; i + 8 <= last; i += 8 )
+	{
+		__m256 sx = _mm256_loadu_ps( &set.x[i] ), sy = _mm256_loadu_ps( &set.y[i] ), sz = _mm256_loadu_ps( &set.z[i] );
+		__m256 sr = _mm256_loadu_ps( &set.r[i] );
+		__m256 any = _mm256_setzero_ps();
+		for( int p = 0; p < numProbes; p++ )
+		{
+			__m256 dx = _mm256_sub_ps( sx, _mm256_set1_ps( probes.x[p] ) );
+			__m256 dy = _mm256_sub_ps( sy, _mm256_set1_ps( probes.y[p] ) );
+			__m256 dz = _mm256_sub_ps( sz, _mm256_set1_ps( probes.z[p] ) );
+			__m256 rr = _mm256_add_ps( sr, _mm256_set1_ps( probes.r[p] ) );
+			__m256 dd = _mm256_add_ps( _mm256_add_ps( _mm256_mul_ps( dx, dx ), _mm256_mul_ps( dy, dy ) ), _mm256_mul_ps( dz, dz ) );
+			any = _mm256_or_ps( any, _mm256_cmp_ps( dd, _mm256_mul_ps( rr, rr ), _CMP_LT_OQ ) );
+		}
+		unsigned bits = (unsigned)_mm256_movemask_ps( any );
+		if( bits )
+		{
+			mask[i >> 5] |= bits << (i & 31);
+			hits += countBits( bits );
+		}
+	}
+#elif defined(VECMATH_SSE)
+	const int numProbes = probes.size();
+	for( ; i + 4 <= last; i += 4 )
+	{
+		__m128 sx = _mm_loadu_ps( &set.x[i] ), sy = _mm_loadu_ps( &set.y[i] ), sz = _mm_loadu_ps( &set.z[i] );
+		__m128 sr = _mm_loadu_ps( &set.r[i] );
+		__m128 any = _mm_setzero_ps();
+		for( int p = 0; p < numProbes; p++ )
+		{
+			__m128 dx = _mm_sub_ps( sx, _mm_set1_ps( probes.x[p] ) );
+			__m128 dy = _mm_sub_ps( sy, _mm_set1_ps( probes.y[p] ) );
+			__m128 dz = _mm_sub_ps( sz, _mm_set1_ps( probes.z[p] ) );
+			__m128 rr = _mm_add_ps( sr, _mm_set1_ps( probes.r[p] ) );
+			__m128 dd = _mm_add_ps( _mm_add_ps( _mm_mul_ps( dx, dx ), _mm_mul_ps( dy, dy ) ), _mm_mul_ps( dz, dz ) );
+			any = _mm_or_ps( any, _mm_cmplt_ps( dd, _mm_mul_ps( rr, rr ) ) );
+		}
+		unsigned bits = (unsigned)_mm_movemask_ps( any );
+		if( bits )
+		{
+			mask[i >> 5] |= bits << (i & 31);
+			hits += countBits( bits );
+		}
+	}
+#endif
+	return hits + overlapAnyMaskRange( set, i, last, probes, mask );
+}
+
+inline int overlapAnyMask( const SphereSet& set, const SphereSet& probes, vector<unsigned>& mask )
+{
+	mask.assign( maskWords( set.size() ), 0 );
+	return overlapAnyMaskBlock( set, 0, set.size(), probes, mask );
+}
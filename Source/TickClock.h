@@ -0,0 +1,74 @@
+/* TickClock.h
+ * Turns however much real time went by into a whole number of fixed length
+ * simulation ticks. Time is banked in an accumulator and spent a tick at a
+ * time, so the game moves at the same speed whether frames come at 30 Hz
+ * or 500 Hz; what is left over says how far the next tick has got, for
+ * drawing between the last two.
+ *
+ * After a stall (a slow frame, a window drag, a breakpoint) at most
+ * maxCatchUp ticks are run and the rest of the backlog is dropped, rather
+ * than letting the game spend ever longer catching up.
+ *
+ * No clock of its own: the caller measures frames (a Stopwatch in the
+ * game, made up times in ShazamBench) and hands them to advance().
+ */
+
+#pragma once
+
+#define TICKS_PER_SECOND	60 /* the rate the game's per tick numbers were tuned at */
+#define MAX_CATCH_UP_TICKS	5  /* most ticks one frame runs before dropping time */
+
+class TickClock
+{
+private:
+	double tickSeconds;
+	double accumulator; /* real time not yet spent on ticks */
+	int maxCatchUp;
+	long long ticks, droppedTicks;
+
+public:
+	TickClock( double ticksPerSecond = TICKS_PER_SECOND, int maxTicksPerFrame = MAX_CATCH_UP_TICKS )
+	{
+		tickSeconds = 1.0 / ticksPerSecond;
+		maxCatchUp = maxTicksPerFrame < 1 ? 1 : maxTicksPerFrame;
+		reset();
+	}
+
+	/* Forgets the time banked, for after a load or a pause */
+	void reset()
+	{
+		accumulator = 0;
+		ticks = droppedTicks = 0;
+	}
+
+	/* Banks seconds of real time and returns how many ticks to run for it,
+	   at most the catch-up cap */
+	int advance( double seconds )
+	{
+		if( seconds > 0 )
+			accumulator += seconds;
+
+		int due = (int)(accumulator / tickSeconds);
+		if( due > maxCatchUp )
+		{
+			droppedTicks += due - maxCatchUp;
+			accumulator -= (due - maxCatchUp) * tickSeconds;
+			due = maxCatchUp;
+		}
+		accumulator -= due * tickSeconds;
+		ticks += due;
+		return due;
+	}
+
+	/* How far (0 to 1) the time banked has got towards the next tick, the
+	   weight of the last tick's state against the one before it */
+	float getAlpha()
+	{
+		float a = (float)(accumulator / tickSeconds);
+		return a < 0 ? 0 : (a > 1 ? 1 : a);
+	}
+
+	double getTickSeconds(){ return tickSeconds; }
+	long long getTicks(){ return ticks; }
+	long long getDroppedTicks(){ return droppedTicks; }
+};
@@ -4,40 +4,193 @@
  * November 16, 2008
  * Phillip Napieralski
  * - Wrote the code
+ *
+ * Drawing lives in Renderer.h so the universe can be simulated headless.
  */
 
-#include "Object.h"
+#pragma once
+
+#include "EntityStore.h"
+#include "SpatialHash.h"
+#include "Random.h"
 #include <vector>
+#include <algorithm>
 
 static int UNIVERSE_SIZE = 100;
 static int DEAD_ZONE = 75;
 static int NUM_BADGUYS = UNIVERSE_SIZE / 5;
 static int NUM_POWERUPS = NUM_BADGUYS / 4;
 
-#define NUM_STARS UNIVERSE_SIZE*25
+static int NUM_STARS = UNIVERSE_SIZE*25;
+
+/* What the collision checks did each frame, see Counters.h */
+Counter countPairsTested( "collision pairs tested" );
+Counter countCollisionHits( "collision hits" );
+Counter countEntities( "entities", true );
+
+/* Fewest entities one job takes when a phase is split across a JobSystem,
+   enough that handing it out costs little next to the work */
+#define ROTATION_GRAIN 8192
+#define OVERLAP_GRAIN 4096 /* a multiple of 32, jobs own whole mask words */
+#define TRANSFORM_GRAIN 1024 /* Renderer::drawInstanced(), a matrix or two each */
+
+/* Below this many entities one SIMD pass over every bounding sphere finds
+   the collision candidates sooner than the hash does (ShazamBench overlap
+   puts the crossover near 128 with SSE). The plain C++ pass never wins. */
+#ifdef VECMATH_SSE
+#define SCAN_BROAD_PHASE_MAX 128
+#else
+#define SCAN_BROAD_PHASE_MAX 0
+#endif
+
+/* Resizes the universe and the populations derived from it, call before generate() */
+void setUniverseSize( int size )
+{
+	UNIVERSE_SIZE = size;
+	NUM_BADGUYS = UNIVERSE_SIZE / 5;
+	NUM_POWERUPS = NUM_BADGUYS / 4;
+	NUM_STARS = UNIVERSE_SIZE*25;
+}
+
+/* Overrides the star count setUniverseSize() picked, for stress testing the starfield */
+void setNumStars( int count )
+{
+	NUM_STARS = count;
+}
+
+/* The streams of a seed's random numbers generate() draws from, one for
+   each thing it places so that how many of one there are leaves the rest
+   where they were */
+enum UniverseStream { STREAM_BADGUYS = 0, STREAM_POWERUPS, STREAM_STARS };
+
+#define STAR_BATCH 256 /* stars generate() draws the numbers for at once */
 
-class Star
+/* Packed the way Renderer hands stars to GL: 16 bytes, a float position
+   and an 8 bit gray color (the fourth byte only pads) */
+struct Star
 {
-public:
-	Star(Point3 pos, Point3 col)
-	{
-		position = pos;
-		color = col;
-	}
-	Point3 position;
-	Point3 color;
+	float position[3];
+	unsigned char color[4];
+};
+
+#define STAR_BLOCKS 4 /* per axis, stars are sorted into STAR_BLOCKS^3 blocks for culling */
+
+/* A run of stars that lie in one block of space, and the box they fill */
+struct StarBlock
+{
+	float lo[3], hi[3];
+	int first, count;
 };
 
 class Universe
 {
 private:
-	vector<Object> powerUps;
-	vector<Object> badGuys;
+	EntityStore entities; /* the bad guys and power ups */
 	vector<Star> stars;
-	VNCMesh powerUpMesh;
-	VNCMesh badGuyMesh;
+	vector<StarBlock> starBlocks;
+	unsigned starsVersion; /* changes every time generate() places new stars */
+	MeshHandle powerUpMesh;
+	MeshHandle badGuyMesh;
+
+	/* Broad phase, ids are entity indices */
+	SpatialHash entityHash;
+	vector<int> hits; /* scratch for collision queries */
+	vector<unsigned> scanMask; /* scratch for the scanned broad phase */
+
+	unsigned long long seed; /* what the last generate() drew from */
+
+	/* Groups the stars (which lie within +-extent) by block and works out
+	   each block's box, so a renderer can skip whole blocks off screen */
+	void sortStars( float extent )
+	{
+		const int B = STAR_BLOCKS;
+		vector<int> block( stars.size() ), start( B*B*B + 1, 0 );
+		for( size_t i = 0; i < stars.size(); i++ )
+		{
+			int cell[3];
+			for( int k = 0; k < 3; k++ )
+			{
+				cell[k] = (int)((stars[i].position[k] + extent) / (2 * extent) * B);
+				cell[k] = cell[k] < 0 ? 0 : (cell[k] >= B ? B - 1 : cell[k]);
+			}
+			block[i] = (cell[2] * B + cell[1]) * B + cell[0];
+			start[block[i] + 1]++;
+		}
+		for( int b = 0; b < B*B*B; b++ )
+			start[b + 1] += start[b];
+
+		vector<Star> sorted( stars.size() );
+		vector<int> next( start.begin(), start.end() - 1 );
+		for( size_t i = 0; i < stars.size(); i++ )
+			sorted[next[block[i]]++] = stars[i];
+		stars.swap( sorted );
+
+		starBlocks.clear();
+		for( int b = 0; b < B*B*B; b++ )
+		{
+			if( start[b] == start[b + 1] )
+				continue;
+			StarBlock sb;
+			sb.first = start[b];
+			sb.count = start[b + 1] - start[b];
+			for( int k = 0; k < 3; k++ )
+				sb.lo[k] = sb.hi[k] = stars[sb.first].position[k];
+			for( int i = sb.first + 1; i < sb.first + sb.count; i++ )
+				for( int k = 0; k < 3; k++ )
+				{
+					sb.lo[k] = min( sb.lo[k], stars[i].position[k] );
+					sb.hi[k] = max( sb.hi[k], stars[i].position[k] );
+				}
+			starBlocks.push_back( sb );
+		}
+	}
+
+	/* Broad phase, then the exact sphere against mesh test. Appends the
+	   survivors to out and returns how many there were. The broad phase is
+	   the hash, or for a small universe (the game's usual few dozen
+	   entities) overlapMask() over the bounding spheres; both make the same
+	   test against the same spheres, so they find the same candidates. */
+	int touching( Vec3 center, float radius, vector<int>& out )
+	{
+		size_t first = out.size();
+		if( entities.size() < SCAN_BROAD_PHASE_MAX )
+		{
+			overlapMask( entities.bounds, center, radius, scanMask );
+			for( int i = 0; i < entities.size(); i++ )
+				if( maskBit( scanMask, i ) )
+					out.push_back( i );
+		}
+		else
+			entityHash.query( center, radius, out );
+
+		size_t kept = first;
+		for( size_t i = first; i < out.size(); i++ )
+			if( entities.touchesSphere( out[i], center, radius ) )
+				out[kept++] = out[i];
+		countPairsTested.add( out.size() - first );
+		countCollisionHits.add( kept - first );
+		out.resize( kept );
+		return (int)(kept - first);
+	}
 
-	Random rnd;
+	/* Swap-and-pop removal of entity idx, keeping the hash in step */
+	void removeAt( int idx )
+	{
+		int last = entities.size() - 1;
+		entityHash.remove( idx );
+		if( idx != last )
+			entityHash.relabel( last, idx );
+		entities.remove( idx );
+	}
+
+	/* removeAt() every entity in hits */
+	void removeHits()
+	{
+		/* Highest index first so that the entity swapped in is never a pending hit */
+		sort( hits.begin(), hits.end() );
+		for( int i = (int)hits.size() - 1; i >= 0; i-- )
+			removeAt( hits[i] );
+	}
 
 	bool failed; /* true if something goes wrong */
 	void fail(){ failed = true; }
@@ -47,38 +200,48 @@ public:
 	Universe()
 	{
 		failed = false;
-		badGuyMesh.read("turtle.3vnc");
-		//badGuyMesh.setOffset( Vector3(-1,0,-1) ); /* for badguy.3vnc */
-		badGuyMesh.setOffset( Vector3( -.5f,.25f,-.5f ) ); /* for turtle.3vnc */
-		badGuyMesh.applyOffset();
-
-		powerUpMesh.read("powerUp.3vnc");
-		//powerUpMesh.setOffset( Vector3(0,0,-.5f) );
-		//powerUpMesh.applyOffset();
+		starsVersion = 0;
+		seed = 0;
+	}
+
+	/* Starts loading the turtle and power up meshes from dataDir (empty =>
+	   working dir) in the background, see finishLoading() */
+	void loadMeshes( const string& dataDir = "" )
+	{
+		//badGuyMesh = MeshRegistry::shared().request( dataDir + "badguy.3vnc", MeshSetup( Vec3(-1,0,-1) ) );
+		badGuyMesh = MeshRegistry::shared().request( dataDir + "turtle.3vnc", MeshSetup( Vec3( -.5f,.25f,-.5f ) ) );
+		powerUpMesh = MeshRegistry::shared().request( dataDir + "powerUp.3vnc" );
+		//powerUpMesh = MeshRegistry::shared().request( dataDir + "powerUp.3vnc", MeshSetup( Vec3(0,0,-.5f) ) );
+	}
+
+	/* Waits for the meshes loadMeshes() asked for, false if one failed */
+	bool finishLoading()
+	{
+		if( !badGuyMesh.wait() )
+			fail();
+		if( !powerUpMesh.wait() )
+			fail();
+		return !failed;
 	}
 
-	void generate(bool d = false)
+	/* Places the bad guys, power ups and stars at random, the same seed
+	   always placing them the same */
+	void generate( unsigned long long universeSeed, bool d = false )
 	{
 		unsigned k = 0;
 		float universeSize = UNIVERSE_SIZE / 2.0f; /* bounds of universe */
+		seed = universeSeed;
+		Random rnd( seed, STREAM_BADGUYS );
 
 		if(d)
 			cout << "Generating universe..." << endl;
 
 		/* Start fresh */
-		badGuys.clear();
-		powerUps.clear();
-		stars.clear();
-		/* Create good objects =) */
-		for( unsigned i = 0; i < NUM_POWERUPS; i++ )
-			powerUps.push_back(Object(powerUpMesh));
-
-		/* Create bad objects =( */ 
-		for( unsigned i = 0; i < NUM_BADGUYS; i++ )
-			badGuys.push_back(Object(badGuyMesh));
-
-		for( unsigned i = 0; i < NUM_STARS; i++ )
-			stars.push_back(Star(Point3(0,0,0),Point3(1,1,1)));
+		entities.clear();
+		entities.reserve( NUM_BADGUYS + NUM_POWERUPS );
+		entityHash.clear( NUM_BADGUYS + NUM_POWERUPS );
+		VNCMesh *badGuy = badGuyMesh.get();
+		Vec3 badGuyCenter = badGuy ? badGuy->getCenter() : Vec3();
 
 		if( d )
 			cout << "Spawning bad guys..." << endl; 
@@ -88,6 +251,7 @@ public:
 		{
 			bool okay = false; /* Okay to place there? */
 			int ttl = 0;
+			Vec3 position, rotation;
 
 			while( !okay )
 			{
@@ -98,38 +262,26 @@ public:
 				int ry = rnd.RandomInt(0,360);
 				int rz = rnd.RandomInt(0,360);
 
-				badGuys[k].rotation = Vector3(rx, ry, rz);
-				badGuys[k].position = Point3(tx, ty, tz);
-
-				badGuys[k].scale = Vector3(25, .5, .5);	
-				/* Currently, checkCollision (in the object class) finds the radius of the sphere by merely using scale.x
-				   So, to increase the spacing between objects, we do some number in the first position
-				   and reset it later, kind of a hack, I know :p */
-
+				rotation = Vec3(rx, ry, rz);
+				position = Vec3(tx, ty, tz);
 
-				/* Make sure no collision w/ other objects occurs */
-				for( int i = 0; i < k; i++ )
-				{
-					if( !badGuys[i].checkCollision( badGuys[k] ) )
-					{
-						//badGuys[k].scale = Vector3( 1, .5, .5 );
-						badGuys[k].scale = Vector3( 1,2,1);
-						okay = true;
-					}
-				}
+				/* Keep a sphere of radius 25 around each one clear of the
+				   others, to space them out */
+				hits.clear();
+				if( entityHash.query( position + badGuyCenter, 25, hits ) == 0 )
+					okay = true;
 
 			/* Ok, we tried x times to get a non-colliding pos... Give up!*/
 				if( ++ttl > 500 )
-				{
 					okay = true;
-					//badGuys[k].scale = Vector3( 1, .5, .5 );
-					badGuys[k].scale = Vector3( 1,2,1);
-				}
 			}
+
+			spawn( OBJECT_BADGUY, position, rotation, Vec3( 1,2,1 ), EntityStore::spinFor( rnd.RandomInt(0, NUM_SPINS - 1) ) );
 		}
 
 		if(d)
 			cout << "Spawning power ups..." << endl;
+		rnd.Seed( seed, STREAM_POWERUPS );
 		for ( k = 0; k < NUM_POWERUPS; k++ )
 		{
 			int tx = rnd.RandomInt(-universeSize, universeSize+1);
@@ -138,156 +290,236 @@ public:
 			int rx = rnd.RandomInt(0,360);
 			int ry = rnd.RandomInt(0,360);
 			int rz = rnd.RandomInt(0,360);
-			double s = 0.2 + rnd.RandomNum() * 0.8;
-			powerUps[k].rotation = Vector3(rx, ry, rz);
-			powerUps[k].position = Point3(tx, ty, tz);
-			powerUps[k].scale = Vector3(s, s, s);
+			float s = 0.2f + (float)rnd.RandomNum() * 0.8f;
+			spawn( OBJECT_POWERUP, Vec3(tx, ty, tz), Vec3(rx, ry, rz), Vec3(s, s, s), EntityStore::spinFor( rnd.RandomInt(0, NUM_SPINS - 1) ) );
 		}
 	
 		/* Make the stars span a little bit more area than the objects */
 		universeSize = UNIVERSE_SIZE + DEAD_ZONE;
 			
-		/* Generate stars */
-		for( k = 0; k < NUM_STARS; k++ )
+		/* Generate stars, they never move after this. There can be millions,
+		   so their numbers are drawn a batch at a time. */
+		stars.resize( NUM_STARS );
+		rnd.Seed( seed, STREAM_STARS );
+		int coords[3 * STAR_BATCH], shades[STAR_BATCH];
+		for( int first = 0; first < NUM_STARS; first += STAR_BATCH )
 		{
-			/* Our stars color */
-			float c = rnd.RandomInt(100, 255);
+			int n = min( STAR_BATCH, NUM_STARS - first );
+			rnd.fill( coords, 3 * n, (int)-universeSize, (int)universeSize + 1 );
+			rnd.fill( shades, n, 100, 255 ); /* Our stars color */
+			for( int i = 0; i < n; i++ )
+			{
+				Star& star = stars[first + i];
+				star.position[0] = (float)coords[3*i];
+				star.position[1] = (float)coords[3*i + 1];
+				star.position[2] = (float)coords[3*i + 2];
+				star.color[0] = star.color[1] = star.color[2] = (unsigned char)shades[i];
+				star.color[3] = 255;
+			}
+		}
 
-			/* make it between 0.0f and 1.0f */
-			c /= 255;
+		sortStars( universeSize );
 
-			int tx = rnd.RandomInt(-universeSize, universeSize+1);
-			int ty = rnd.RandomInt(-universeSize, universeSize+1);
-			int tz = rnd.RandomInt(-universeSize, universeSize+1);
-			stars[k].position.set( tx, ty, tz );
-			stars[k].color.set( c, c, c );
-		}
+		/* Unique across universes so a renderer never mistakes one's stars for another's */
+		static unsigned lastStarsVersion = 0;
+		starsVersion = ++lastStarsVersion;
 
 	}
 
-	/* Draw a simple grid defining our boundaries */
-	void drawOOBGrid3D( int size )
+	bool hasFailed(){ return failed; }
+
+	/* Adds a bad guy or power up (with its mesh) and returns a handle to it */
+	EntityHandle spawn( OBJECT_TYPE type, const Vec3& position, const Vec3& rotation, const Vec3& scale, const Vec3& spin )
 	{
-		Point3 start(-size,-size,-size);
-		Point3 end(size,size,size);
-		const float SPACING = 25.0f;
+		int meshId = entities.addMesh( type == OBJECT_POWERUP ? powerUpMesh : badGuyMesh );
+		int e = entities.add( type, meshId, position, rotation, scale, spin );
+		entityHash.insert( e, position, entities.radius[e] );
+		return entities.getHandle( e );
+	}
 
+	/* Removes h's entity in constant time, false if it was already gone */
+	bool despawn( EntityHandle h )
+	{
+		int idx = entities.indexOf( h );
+		if( idx < 0 )
+			return false;
+		removeAt( idx );
+		return true;
+	}
 
-		for( int k = 0; k < 4; k++)
-		{
-		glRotatef( 90*k, 1, 0, 0 );
-			glPushMatrix();
-			glBegin( GL_LINES );
-				for( int i = 0; i <= 2*size; i+= SPACING )
-				{
-					glVertex3f( start.x + i, start.y + 2*size, start.z ); /* xz plane */
-					glVertex3f( start.x + i, start.y, start.z );
-					glVertex3f( start.x + 2*size, start.y + i, start.z);
-					glVertex3f( start.x, start.y + i, start.z);
-				}
-			glEnd();
-			glPopMatrix();
-		}
+	/* Moves h's entity to position, in the broad phase too. False if it is gone. */
+	bool move( EntityHandle h, const Vec3& position )
+	{
+		int idx = entities.indexOf( h );
+		if( idx < 0 )
+			return false;
+		entities.setPosition( idx, position );
+		entityHash.move( idx, position );
+		return true;
+	}
 
-		glPushMatrix();
-		glBegin( GL_LINES );
-			for( int i = 0; i <= 2*size; i+= SPACING )
-			{
-					glVertex3f( start.x , start.y + 2*size, start.z + i );
-					glVertex3f( start.x, start.y, start.z + i );
-					glVertex3f( start.x , start.y + i, start.z + 2*size );
-					glVertex3f( start.x, start.y + i, start.z );
-
-					glVertex3f( start.x+2*size, start.y + 2*size, start.z + i );
-					glVertex3f( start.x+2*size, start.y, start.z + i );
-					glVertex3f( start.x+2*size, start.y + i, start.z + 2*size );
-					glVertex3f( start.x+2*size, start.y + i, start.z );
-			}
-		glEnd();
-		glPopMatrix();
+	/* Rescales h's entity; its bounding radius changes, so it goes back into
+	   the broad phase with the new one. False if it is gone. */
+	bool resize( EntityHandle h, const Vec3& scale )
+	{
+		int idx = entities.indexOf( h );
+		if( idx < 0 )
+			return false;
+		entities.setScale( idx, scale );
+		entityHash.insert( idx, entities.position[idx], entities.radius[idx] );
+		return true;
 	}
 
+	/* Appends the index of every entity whose mesh obj's sphere touches to
+	   hits (nothing is removed). Returns how many there were. */
+	int queryCollisions( Object& obj, vector<int>& out )
+	{
+		return touching( obj.getCenter(), obj.getRadius(), out );
+	}
 
-	bool hasFailed(){ return failed; }
+	/* Sets the bit (see SphereSet.h) of every entity whose collision sphere
+	   touches obj's, the old Object::checkCollision() test, in one SIMD pass
+	   over all of them. Returns how many there were. */
+	int overlapping( Object& obj, vector<unsigned>& mask )
+	{
+		int hits = overlapMask( entities.spheres, obj.getCenter(), obj.getRadius(), mask );
+		countPairsTested.add( entities.spheres.size() );
+		countCollisionHits.add( hits );
+		return hits;
+	}
 
-	/* Draw stars */
-	void drawStars( )
+	/* overlapping() for a whole set of spheres (projectiles, say) in the one
+	   pass: the bit of every entity that touches any of them */
+	int overlappingAny( const SphereSet& probes, vector<unsigned>& mask )
 	{
-		glPushMatrix();
-			glBegin( GL_POINTS );
-				for( unsigned i = 0; i < stars.size(); i++ )
-				{
-					glColor3f( stars[i].color.x, stars[i].color.y, stars[i].color.z );
-					glVertex3f(stars[i].position.x, stars[i].position.y, stars[i].position.z );
-				}
-			glEnd();
-		glPopMatrix();
+		int hits = overlapAnyMask( entities.spheres, probes, mask );
+		countPairsTested.add( (long long)entities.spheres.size() * probes.size() );
+		countCollisionHits.add( hits );
+		return hits;
 	}
 
-	void draw()
+	/* overlapping() and overlappingAny() with the entities split across jobs */
+	int overlapping( Object& obj, vector<unsigned>& mask, JobSystem& jobs )
 	{
-		glPushMatrix();
-		for( unsigned i = 0; i < powerUps.size(); i++ )
+		PROFILE_SCOPE( "Universe::overlapping" );
+		const SphereSet& set = entities.spheres;
+		Vec3 c = obj.getCenter();
+		float r = obj.getRadius();
+		int n = set.size();
+		atomic<int> hits( 0 );
+		mask.assign( maskWords( n ), 0 );
+		jobs.parallelFor( 0, n, OVERLAP_GRAIN, [&]( int lo, int hi )
 		{
-			/* Pass it a (0,1,0) color vector */
-			powerUps[i].draw( Vector3(0,1.0f,0) );
-		}
-		glPopMatrix();
+			hits += overlapMaskBlock( set, lo, hi, c, r, mask );
+		} );
+		countPairsTested.add( n );
+		countCollisionHits.add( hits );
+		return hits;
+	}
 
-	
-		glPushMatrix();
-		for( unsigned i = 0; i < badGuys.size(); i++ )
+	int overlappingAny( const SphereSet& probes, vector<unsigned>& mask, JobSystem& jobs )
+	{
+		PROFILE_SCOPE( "Universe::overlappingAny" );
+		const SphereSet& set = entities.spheres;
+		int n = set.size();
+		atomic<int> hits( 0 );
+		mask.assign( maskWords( n ), 0 );
+		jobs.parallelFor( 0, n, OVERLAP_GRAIN, [&]( int lo, int hi )
 		{
-			badGuys[i].draw();
-		}
-		glPopMatrix();
-
-		glColor3f( 0.2f, 0.2f, 0.2f );
-		drawOOBGrid3D( UNIVERSE_SIZE );
+			hits += overlapAnyMaskBlock( set, lo, hi, probes, mask );
+		} );
+		countPairsTested.add( (long long)n * probes.size() );
+		countCollisionHits.add( hits );
+		return hits;
 	}
 
-	/* returns the index of which badguy we collided with */
-	int checkCollisionBadGuys( Object obj )
+	/* Removes every bad guy and power up obj is touching and says how many
+	   of each there were. touching() picks the hash or the SIMD scan. */
+	void collide( Object& obj, int& badGuysHit, int& powerUpsHit )
 	{
-		for( unsigned i = 0; i < badGuys.size(); i++ )
-			if( badGuys[i].checkCollision( obj ) )
-			{
-				badGuys.erase( badGuys.begin() + i); /* remove the badguy */
-				return i;
-			}
-		return -1;
+		PROFILE_SCOPE( "Universe::collide" );
+		badGuysHit = powerUpsHit = 0;
+		hits.clear();
+		countEntities.set( entities.size() );
+		if( touching( obj.getCenter(), obj.getRadius(), hits ) == 0 )
+			return;
+		for( size_t i = 0; i < hits.size(); i++ )
+		{
+			if( entities.type[hits[i]] == OBJECT_BADGUY )
+				badGuysHit++;
+			else if( entities.type[hits[i]] == OBJECT_POWERUP )
+				powerUpsHit++;
+		}
+		removeHits();
 	}
 
-	
-	int checkCollisionPowerUps( Object obj )
+	/* Nearest entity along the ray origin + t*dir, t in (0, maxT). Sets
+	   what it hit (OBJECT_BADGUY or OBJECT_POWERUP), its index and t. */
+	bool raycast( Vec3 origin, Vec3 dir, float maxT, OBJECT_TYPE& type, int& index, float& t )
 	{
-		for( unsigned i = 0; i < powerUps.size(); i++ )
-			if( powerUps[i].checkCollision( obj ) )
+		PROFILE_SCOPE( "Universe::raycast" );
+		bool hit = false;
+		t = maxT;
+		float dd = dir.lengthSq();
+		if( dd <= 0 )
+			return false;
+
+		float len = sqrtf( dd );
+		const Vec3 *pos = entities.position.empty() ? NULL : &entities.position[0];
+		const float *radius = entities.radius.empty() ? NULL : &entities.radius[0];
+		for( int i = 0; i < entities.size(); i++ )
+		{
+			/* Skip anything whose bounding sphere the ray misses or reaches too late */
+			Vec3 o = pos[i] - origin;
+			float r = radius[i];
+			float along = o.dot( dir ) / dd;
+			if( (o - along * dir).lengthSq() > r*r || along - r / len >= t )
+				continue;
+
+			float th;
+			if( entities.raycast( i, origin, dir, t, th ) )
 			{
-				powerUps.erase( powerUps.begin() + i );
-				return i;
+				t = th;
+				index = i;
+				type = (OBJECT_TYPE)entities.type[i];
+				hit = true;
 			}
-		return -1;
+		}
+		return hit;
 	}
 	
 	void updateRotations()
 	{
-		for( unsigned i = 0; i < powerUps.size(); i++ )
-			powerUps[i].doRotation();
-	
-		for( unsigned i = 0; i < badGuys.size(); i++ )
-			badGuys[i].doRotation();
+		entities.updateRotations();
+	}
+
+	/* updateRotations() with the entities split across jobs */
+	void updateRotations( JobSystem& jobs )
+	{
+		jobs.parallelFor( 0, entities.size(), ROTATION_GRAIN, [this]( int lo, int hi )
+		{
+			PROFILE_SCOPE( "Universe::updateRotations" );
+			entities.updateRotations( lo, hi );
+		} );
+	}
+
+	/* Starts the broad phase over from the position and radius columns,
+	   for after a change that moves most entities at once. Entities never
+	   move by themselves, so a tick does not need this. */
+	void rebuildBroadPhase( JobSystem& jobs )
+	{
+		if( entities.size() == 0 )
+			entityHash.clear( 0 );
+		else
+			entityHash.rebuild( entities.size(), &entities.position[0], &entities.radius[0], jobs );
 	}
 
 	void toggleHitBoxVisible()
 	{
-		for( unsigned i = 0; i < badGuys.size(); i++ )
-			badGuys[i].toggleHitBoxVisible();
-		for( unsigned i = 0; i < powerUps.size(); i++ )
-			powerUps[i].toggleHitBoxVisible();
+		entities.toggleHitBoxes();
 	}
 
-	bool checkOOB( Object obj )
+	bool checkOOB( Object& obj )
 	{
 		if( obj.position.x < UNIVERSE_SIZE && obj.position.x > -UNIVERSE_SIZE &&
 			obj.position.y < UNIVERSE_SIZE && obj.position.y > -UNIVERSE_SIZE &&
@@ -296,7 +528,7 @@ public:
 		return true;
 	}
 
-	bool checkDeadZone( Object obj )
+	bool checkDeadZone( Object& obj )
 	{
 		if( obj.position.x < UNIVERSE_SIZE+DEAD_ZONE && obj.position.x > -UNIVERSE_SIZE-DEAD_ZONE &&
 			obj.position.y < UNIVERSE_SIZE+DEAD_ZONE && obj.position.y > -UNIVERSE_SIZE-DEAD_ZONE &&
@@ -305,7 +537,7 @@ public:
 		return true;
 	}
 
-	bool checkBounds( Object obj, int dist )
+	bool checkBounds( Object& obj, int dist )
 	{
 		if( obj.position.x < dist && obj.position.x > -dist &&
 			obj.position.y < dist && obj.position.y > -dist &&
@@ -314,13 +546,15 @@ public:
 		return true;
 	}
 
-	int getNumBadGuys(){ return badGuys.size(); }
+	int getNumBadGuys(){ return entities.count( OBJECT_BADGUY ); }
 
-	Object getFirstBadGuy()
-	{
-		if( !badGuys.empty() )
-			return badGuys[0];
-		return Object(badGuyMesh); /* Merely a placeholder */
-	}
+	EntityStore& getEntities(){ return entities; }
+	vector<Star>& getStars(){ return stars; }
+	vector<StarBlock>& getStarBlocks(){ return starBlocks; }
+	unsigned getStarsVersion(){ return starsVersion; }
+	unsigned long long getSeed(){ return seed; }
+
+	/* Index of the first bad guy, -1 if none are left */
+	int getFirstBadGuy(){ return entities.first( OBJECT_BADGUY ); }
 
-};
\ No newline at end of file
+};
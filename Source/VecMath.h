@@ -0,0 +1,388 @@
+/* VecMath.h
+ * The game's vector math, in floats. Vec3 is a plain 12 byte point or
+ * direction that the compiler keeps in registers; Vec4, Mat4 and Quat are
+ * 16 byte aligned and use SSE when the compiler targets it (any x64 build),
+ * AVX for Mat4 products when it targets that (-mavx, /arch:AVX), and plain
+ * C++ otherwise. Define SHAZAM_NO_SIMD to force the plain versions.
+ *
+ * Everything here is trivially copyable, nothing prints, throws or
+ * allocates. Matrices are column major, as glLoadMatrixf() wants them, and
+ * angles are in degrees like glRotatef() unless a name says otherwise.
+ */
+
+#pragma once
+
+#include <cmath>
+
+#if !defined(SHAZAM_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define VECMATH_SSE
+#include <emmintrin.h>
+#if defined(__AVX__)
+#define VECMATH_AVX
+#include <immintrin.h>
+#endif
+#endif
+
+const double PI = atan(1.0) * 4.0,
+			 TWO_PI = 2.0 * PI,
+			 RADIANS_PER_DEGREE = PI / 180.0,
+			 DEGREES_PER_RADIAN = 180.0 / PI;
+
+/* alignas() and constexpr need VS2015, the project builds with VS2012 */
+#ifdef _MSC_VER
+#define VECMATH_ALIGN16 __declspec(align(16))
+#else
+#define VECMATH_ALIGN16 __attribute__((aligned(16)))
+#endif
+
+/* Below this squared length a vector is treated as zero */
+#define VECMATH_EPSILON_SQ 1e-12f
+
+/* A point or a direction */
+struct Vec3
+{
+	float x, y, z;
+
+	Vec3() : x(0), y(0), z(0) {}
+	Vec3( float xx, float yy, float zz ) : x(xx), y(yy), z(zz) {}
+
+	void set( float xx, float yy, float zz ){ x = xx; y = yy; z = zz; }
+	void set( const Vec3& v ){ x = v.x; y = v.y; z = v.z; }
+	void flip(){ x = -x; y = -y; z = -z; }
+
+	/* This becomes a - b */
+	void setDiff( const Vec3& a, const Vec3& b ){ x = a.x - b.x; y = a.y - b.y; z = a.z - b.z; }
+
+	float dot( const Vec3& b ) const { return x*b.x + y*b.y + z*b.z; }
+	Vec3 cross( const Vec3& b ) const { return Vec3( y*b.z - z*b.y, z*b.x - x*b.z, x*b.y - y*b.x ); }
+	float lengthSq() const { return x*x + y*y + z*z; }
+	float length() const { return sqrtf( lengthSq() ); }
+
+	/* Makes this unit length. Zero vectors are left alone. */
+	void normalize()
+	{
+		float sq = lengthSq();
+		if( sq < VECMATH_EPSILON_SQ )
+			return;
+		float s = 1.0f / sqrtf( sq );
+		x *= s; y *= s; z *= s;
+	}
+
+	Vec3 normalized() const { Vec3 v = *this; v.normalize(); return v; }
+
+	/* Radians, 0 if either is zero */
+	static float angleBetween( const Vec3& a, const Vec3& b )
+	{
+		float d = sqrtf( a.lengthSq() * b.lengthSq() );
+		if( d < VECMATH_EPSILON_SQ )
+			return 0;
+		float c = a.dot( b ) / d;
+		return acosf( c > 1 ? 1 : (c < -1 ? -1 : c) );
+	}
+
+	Vec3& operator+=( const Vec3& v ){ x += v.x; y += v.y; z += v.z; return *this; }
+	Vec3& operator-=( const Vec3& v ){ x -= v.x; y -= v.y; z -= v.z; return *this; }
+	Vec3& operator*=( float s ){ x *= s; y *= s; z *= s; return *this; }
+
+	friend Vec3 operator+( const Vec3& a, const Vec3& b ){ return Vec3( a.x + b.x, a.y + b.y, a.z + b.z ); }
+	friend Vec3 operator-( const Vec3& a, const Vec3& b ){ return Vec3( a.x - b.x, a.y - b.y, a.z - b.z ); }
+	friend Vec3 operator-( const Vec3& v ){ return Vec3( -v.x, -v.y, -v.z ); }
+	friend Vec3 operator*( float s, const Vec3& v ){ return Vec3( s*v.x, s*v.y, s*v.z ); }
+	friend Vec3 operator*( const Vec3& v, float s ){ return Vec3( s*v.x, s*v.y, s*v.z ); }
+	friend bool operator==( const Vec3& a, const Vec3& b ){ return a.x == b.x && a.y == b.y && a.z == b.z; }
+	friend bool operator!=( const Vec3& a, const Vec3& b ){ return !(a == b); }
+};
+
+inline float dot( const Vec3& a, const Vec3& b ){ return a.dot( b ); }
+inline Vec3 cross( const Vec3& a, const Vec3& b ){ return a.cross( b ); }
+
+/* Squared distance, for comparing against a squared radius without the sqrt */
+inline float distanceSq( const Vec3& a, const Vec3& b )
+{
+	return (a.x - b.x)*(a.x - b.x) + (a.y - b.y)*(a.y - b.y) + (a.z - b.z)*(a.z - b.z);
+}
+
+inline float distance( const Vec3& a, const Vec3& b ){ return sqrtf( distanceSq( a, b ) ); }
+
+struct VECMATH_ALIGN16 Vec4
+{
+	float x, y, z, w;
+
+	Vec4() : x(0), y(0), z(0), w(0) {}
+	Vec4( float xx, float yy, float zz, float ww ) : x(xx), y(yy), z(zz), w(ww) {}
+	Vec4( const Vec3& v, float ww ) : x(v.x), y(v.y), z(v.z), w(ww) {}
+
+	Vec3 xyz() const { return Vec3( x, y, z ); }
+
+#ifdef VECMATH_SSE
+	__m128 load() const { return _mm_loadu_ps( &x ); }
+	void store( __m128 v ){ _mm_storeu_ps( &x, v ); }
+	static Vec4 from( __m128 v ){ Vec4 r; r.store( v ); return r; }
+
+	float dot( const Vec4& b ) const
+	{
+		__m128 p = _mm_mul_ps( load(), b.load() );
+		p = _mm_add_ps( p, _mm_shuffle_ps( p, p, _MM_SHUFFLE(2,3,0,1) ) );
+		p = _mm_add_ss( p, _mm_movehl_ps( p, p ) );
+		return _mm_cvtss_f32( p );
+	}
+
+	friend Vec4 operator+( const Vec4& a, const Vec4& b ){ return from( _mm_add_ps( a.load(), b.load() ) ); }
+	friend Vec4 operator-( const Vec4& a, const Vec4& b ){ return from( _mm_sub_ps( a.load(), b.load() ) ); }
+	friend Vec4 operator*( const Vec4& a, const Vec4& b ){ return from( _mm_mul_ps( a.load(), b.load() ) ); }
+	friend Vec4 operator*( float s, const Vec4& v ){ return from( _mm_mul_ps( _mm_set1_ps( s ), v.load() ) ); }
+#else
+	float dot( const Vec4& b ) const { return x*b.x + y*b.y + z*b.z + w*b.w; }
+
+	friend Vec4 operator+( const Vec4& a, const Vec4& b ){ return Vec4( a.x + b.x, a.y + b.y, a.z + b.z, a.w + b.w ); }
+	friend Vec4 operator-( const Vec4& a, const Vec4& b ){ return Vec4( a.x - b.x, a.y - b.y, a.z - b.z, a.w - b.w ); }
+	friend Vec4 operator*( const Vec4& a, const Vec4& b ){ return Vec4( a.x*b.x, a.y*b.y, a.z*b.z, a.w*b.w ); }
+	friend Vec4 operator*( float s, const Vec4& v ){ return Vec4( s*v.x, s*v.y, s*v.z, s*v.w ); }
+#endif
+
+	friend Vec4 operator*( const Vec4& v, float s ){ return s * v; }
+};
+
+/* 4x4 matrix, column major: m[4*column + row] */
+struct VECMATH_ALIGN16 Mat4
+{
+	float m[16];
+
+	static Mat4 identity()
+	{
+		Mat4 r;
+		for( int i = 0; i < 16; i++ )
+			r.m[i] = (i % 5) == 0 ? 1.0f : 0.0f;
+		return r;
+	}
+
+	static Mat4 fromArray( const float a[16] )
+	{
+		Mat4 r;
+		for( int i = 0; i < 16; i++ )
+			r.m[i] = a[i];
+		return r;
+	}
+
+	static Mat4 translation( const Vec3& t )
+	{
+		Mat4 r = identity();
+		r.m[12] = t.x; r.m[13] = t.y; r.m[14] = t.z;
+		return r;
+	}
+
+	static Mat4 scaling( const Vec3& s )
+	{
+		Mat4 r = identity();
+		r.m[0] = s.x; r.m[5] = s.y; r.m[10] = s.z;
+		return r;
+	}
+
+	/* glRotatef( x, 1,0,0 ); glRotatef( y, 0,1,0 ); glRotatef( z, 0,0,1 ) */
+	static Mat4 rotationXYZ( const Vec3& degrees )
+	{
+		float a = degrees.x * (float)RADIANS_PER_DEGREE, b = degrees.y * (float)RADIANS_PER_DEGREE, c = degrees.z * (float)RADIANS_PER_DEGREE;
+		float ca = cosf(a), sa = sinf(a), cb = cosf(b), sb = sinf(b), cc = cosf(c), sc = sinf(c);
+		Mat4 r = identity();
+		r.m[0] = cb*cc;              r.m[4] = -cb*sc;             r.m[8]  = sb;
+		r.m[1] = sa*sb*cc + ca*sc;   r.m[5] = -sa*sb*sc + ca*cc;  r.m[9]  = -sa*cb;
+		r.m[2] = -ca*sb*cc + sa*sc;  r.m[6] = ca*sb*sc + sa*cc;   r.m[10] = ca*cb;
+		return r;
+	}
+
+	float& at( int row, int col ){ return m[4*col + row]; }
+	float at( int row, int col ) const { return m[4*col + row]; }
+	const float *data() const { return m; }
+
+	/* a * b without SIMD, also what the SIMD versions are checked against */
+	static void mulScalar( const Mat4& a, const Mat4& b, Mat4& out )
+	{
+		for( int c = 0; c < 4; c++ )
+			for( int r = 0; r < 4; r++ )
+				out.m[4*c + r] = a.m[r]*b.m[4*c] + a.m[4 + r]*b.m[4*c + 1]
+					+ a.m[8 + r]*b.m[4*c + 2] + a.m[12 + r]*b.m[4*c + 3];
+	}
+
+	/* out = a * b; out may not be a or b */
+	static void mul( const Mat4& a, const Mat4& b, Mat4& out )
+	{
+#if defined(VECMATH_AVX)
+		/* Two columns of the result per pass: each is a's columns weighted
+		   by one column of b */
+		__m256 a0 = _mm256_broadcast_ps( (const __m128*)&a.m[0] );
+		__m256 a1 = _mm256_broadcast_ps( (const __m128*)&a.m[4] );
+		__m256 a2 = _mm256_broadcast_ps( (const __m128*)&a.m[8] );
+		__m256 a3 = _mm256_broadcast_ps( (const __m128*)&a.m[12] );
+		for( int c = 0; c < 4; c += 2 )
+		{
+			const float *bc = &b.m[4*c];
+			__m256 r = _mm256_mul_ps( a0, _mm256_setr_ps( bc[0], bc[0], bc[0], bc[0], bc[4], bc[4], bc[4], bc[4] ) );
+			r = _mm256_add_ps( r, _mm256_mul_ps( a1, _mm256_setr_ps( bc[1], bc[1], bc[1], bc[1], bc[5], bc[5], bc[5], bc[5] ) ) );
+			r = _mm256_add_ps( r, _mm256_mul_ps( a2, _mm256_setr_ps( bc[2], bc[2], bc[2], bc[2], bc[6], bc[6], bc[6], bc[6] ) ) );
+			r = _mm256_add_ps( r, _mm256_mul_ps( a3, _mm256_setr_ps( bc[3], bc[3], bc[3], bc[3], bc[7], bc[7], bc[7], bc[7] ) ) );
+			_mm256_storeu_ps( &out.m[4*c], r );
+		}
+#elif defined(VECMATH_SSE)
+		__m128 a0 = _mm_loadu_ps( &a.m[0] ), a1 = _mm_loadu_ps( &a.m[4] ), a2 = _mm_loadu_ps( &a.m[8] ), a3 = _mm_loadu_ps( &a.m[12] );
+		for( int c = 0; c < 4; c++ )
+		{
+			const float *bc = &b.m[4*c];
+			__m128 r = _mm_mul_ps( a0, _mm_set1_ps( bc[0] ) );
+			r = _mm_add_ps( r, _mm_mul_ps( a1, _mm_set1_ps( bc[1] ) ) );
+			r = _mm_add_ps( r, _mm_mul_ps( a2, _mm_set1_ps( bc[2] ) ) );
+			r = _mm_add_ps( r, _mm_mul_ps( a3, _mm_set1_ps( bc[3] ) ) );
+			_mm_storeu_ps( &out.m[4*c], r );
+		}
+#else
+		mulScalar( a, b, out );
+#endif
+	}
+
+	friend Mat4 operator*( const Mat4& a, const Mat4& b ){ Mat4 r; mul( a, b, r ); return r; }
+
+	Vec4 transform( const Vec4& v ) const
+	{
+#ifdef VECMATH_SSE
+		__m128 r = _mm_mul_ps( _mm_loadu_ps( &m[0] ), _mm_set1_ps( v.x ) );
+		r = _mm_add_ps( r, _mm_mul_ps( _mm_loadu_ps( &m[4] ), _mm_set1_ps( v.y ) ) );
+		r = _mm_add_ps( r, _mm_mul_ps( _mm_loadu_ps( &m[8] ), _mm_set1_ps( v.z ) ) );
+		r = _mm_add_ps( r, _mm_mul_ps( _mm_loadu_ps( &m[12] ), _mm_set1_ps( v.w ) ) );
+		return Vec4::from( r );
+#else
+		return Vec4( m[0]*v.x + m[4]*v.y + m[8]*v.z + m[12]*v.w,
+			m[1]*v.x + m[5]*v.y + m[9]*v.z + m[13]*v.w,
+			m[2]*v.x + m[6]*v.y + m[10]*v.z + m[14]*v.w,
+			m[3]*v.x + m[7]*v.y + m[11]*v.z + m[15]*v.w );
+#endif
+	}
+
+	/* The point p (w = 1) and the direction d (w = 0) moved by this matrix */
+	Vec3 transformPoint( const Vec3& p ) const { return transform( Vec4( p, 1.0f ) ).xyz(); }
+	Vec3 transformDir( const Vec3& d ) const { return transform( Vec4( d, 0.0f ) ).xyz(); }
+};
+
+/* Unit quaternion for a rotation, (x, y, z) the axis part and w the angle part */
+struct VECMATH_ALIGN16 Quat
+{
+	float x, y, z, w;
+
+	Quat() : x(0), y(0), z(0), w(1) {}
+	Quat( float xx, float yy, float zz, float ww ) : x(xx), y(yy), z(zz), w(ww) {}
+
+	/* Turns by degrees about axis (any length but zero) */
+	static Quat fromAxisAngle( const Vec3& axis, float degrees )
+	{
+		Vec3 a = axis.normalized();
+		float h = degrees * (float)RADIANS_PER_DEGREE * 0.5f, s = sinf(h);
+		return Quat( a.x*s, a.y*s, a.z*s, cosf(h) );
+	}
+
+	Quat conjugate() const { return Quat( -x, -y, -z, w ); }
+	float dot( const Quat& q ) const { return x*q.x + y*q.y + z*q.z + w*q.w; }
+
+	void normalize()
+	{
+		float sq = dot( *this );
+		if( sq < VECMATH_EPSILON_SQ )
+		{
+			*this = Quat();
+			return;
+		}
+		float s = 1.0f / sqrtf( sq );
+		x *= s; y *= s; z *= s; w *= s;
+	}
+
+	/* a * b turns by b, then by a */
+	static Quat mulScalar( const Quat& a, const Quat& b )
+	{
+		return Quat( a.w*b.x + a.x*b.w + a.y*b.z - a.z*b.y,
+			a.w*b.y - a.x*b.z + a.y*b.w + a.z*b.x,
+			a.w*b.z + a.x*b.y - a.y*b.x + a.z*b.w,
+			a.w*b.w - a.x*b.x - a.y*b.y - a.z*b.z );
+	}
+
+	friend Quat operator*( const Quat& a, const Quat& b )
+	{
+#ifdef VECMATH_SSE
+		/* a.w*b plus a.x, a.y and a.z times b's components swizzled and signed */
+		__m128 bv = _mm_loadu_ps( &b.x );
+		__m128 r = _mm_mul_ps( _mm_set1_ps( a.w ), bv );
+		r = _mm_add_ps( r, _mm_mul_ps( _mm_set1_ps( a.x ),
+			_mm_mul_ps( _mm_shuffle_ps( bv, bv, _MM_SHUFFLE(0,1,2,3) ), _mm_setr_ps( 1, -1, 1, -1 ) ) ) );
+		r = _mm_add_ps( r, _mm_mul_ps( _mm_set1_ps( a.y ),
+			_mm_mul_ps( _mm_shuffle_ps( bv, bv, _MM_SHUFFLE(1,0,3,2) ), _mm_setr_ps( 1, 1, -1, -1 ) ) ) );
+		r = _mm_add_ps( r, _mm_mul_ps( _mm_set1_ps( a.z ),
+			_mm_mul_ps( _mm_shuffle_ps( bv, bv, _MM_SHUFFLE(2,3,0,1) ), _mm_setr_ps( -1, 1, 1, -1 ) ) ) );
+		Quat q;
+		_mm_storeu_ps( &q.x, r );
+		return q;
+#else
+		return mulScalar( a, b );
+#endif
+	}
+
+	/* v turned by this rotation */
+	Vec3 rotate( const Vec3& v ) const
+	{
+		/* v + 2w(q x v) + 2 q x (q x v) */
+		Vec3 q( x, y, z );
+		Vec3 t = 2.0f * q.cross( v );
+		return v + w * t + q.cross( t );
+	}
+
+	Mat4 toMat4() const
+	{
+		Mat4 r = Mat4::identity();
+		r.m[0] = 1 - 2*(y*y + z*z);  r.m[4] = 2*(x*y - z*w);      r.m[8]  = 2*(x*z + y*w);
+		r.m[1] = 2*(x*y + z*w);      r.m[5] = 1 - 2*(x*x + z*z);  r.m[9]  = 2*(y*z - x*w);
+		r.m[2] = 2*(x*z - y*w);      r.m[6] = 2*(y*z + x*w);      r.m[10] = 1 - 2*(x*x + y*y);
+		return r;
+	}
+};
+
+/* a in degrees, brought into [0, 360). Multiplying by 1/360 can round a
+   hair under 360 up to a whole turn, which would land a hair under 0, so
+   the result is clamped there. */
+inline float wrapDegrees( float a )
+{
+	float r = a - 360.0f * floorf( a * (1.0f / 360.0f) );
+	return r < 0 ? 0 : r;
+}
+
+/* angles[i] = wrapDegrees( angles[i] + rates[i] ) for i < count, one float
+   at a time. addWrapDegrees() is the same, several at a time. */
+inline void addWrapDegreesScalar( float *angles, const float *rates, int count )
+{
+	for( int i = 0; i < count; i++ )
+		angles[i] = wrapDegrees( angles[i] + rates[i] );
+}
+
+inline void addWrapDegrees( float *angles, const float *rates, int count )
+{
+	int i = 0;
+#if defined(VECMATH_AVX)
+	const __m256 full8 = _mm256_set1_ps( 360.0f ), inv8 = _mm256_set1_ps( 1.0f / 360.0f );
+	for( ; i + 8 <= count; i += 8 )
+	{
+		__m256 a = _mm256_add_ps( _mm256_loadu_ps( angles + i ), _mm256_loadu_ps( rates + i ) );
+		__m256 turns = _mm256_round_ps( _mm256_mul_ps( a, inv8 ), _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC );
+		a = _mm256_sub_ps( a, _mm256_mul_ps( full8, turns ) );
+		_mm256_storeu_ps( angles + i, _mm256_max_ps( a, _mm256_setzero_ps() ) );
+	}
+#endif
+#ifdef VECMATH_SSE
+	const __m128 full = _mm_set1_ps( 360.0f ), inv = _mm_set1_ps( 1.0f / 360.0f ), one = _mm_set1_ps( 1.0f );
+	for( ; i + 4 <= count; i += 4 )
+	{
+		__m128 a = _mm_add_ps( _mm_loadu_ps( angles + i ), _mm_loadu_ps( rates + i ) );
+
+		/* floor() without SSE4: truncate, then step down where that rounded up */
+		__m128 q = _mm_mul_ps( a, inv );
+		__m128 turns = _mm_cvtepi32_ps( _mm_cvttps_epi32( q ) );
+		turns = _mm_sub_ps( turns, _mm_and_ps( _mm_cmpgt_ps( turns, q ), one ) );
+		a = _mm_sub_ps( a, _mm_mul_ps( full, turns ) );
+		_mm_storeu_ps( angles + i, _mm_max_ps( a, _mm_setzero_ps() ) );
+	}
+#endif
+	addWrapDegreesScalar( angles + i, rates + i, count - i );
+}
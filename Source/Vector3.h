@@ -1,15 +1,16 @@
-/** @file support3d.h
- *  @description Defines constants and classes used to support 3D graphics.
+/** @file Vector3.h
+ *  @description The double precision point and vector the game used before
+ *  VecMath.h. Nothing in the game uses them any more; they are kept as they
+ *  were so ShazamBench's math benchmark has something to compare against.
 */
 #ifndef __VECTOR3_H_
 #define __VECTOR3_H_
 
 #include <cmath>
+#include <iostream>
+using namespace std;
 
-const double PI = atan(1.0) * 4.0, 
-			 TWO_PI = 2.0 * PI,
-			 RADIANS_PER_DEGREE = PI / 180.0,
-			 DEGREES_PER_RADIAN = 180.0 / PI;
+#include "VecMath.h" /* PI and friends */
 
 class Point3
 { 
@@ -5,13 +5,18 @@
 
 	Class
 	---------
-	VertexID ... vertex
-	Face ....... planar face (polygon)
 	Mesh ....... polygonal mesh
 
 	METHODS
-    read ........ read mesh from a file
-	draw ........ draw the mesh
+    read ........ read mesh from a .3vnc text file
+    readBinary .. map a compiled .vncb file (see MeshFile.h)
+    writeBinary . save the mesh as a .vncb file
+    load ........ read a .3vnc through its .vncb cache
+    getBatch .... the mesh triangulated for drawing (see MeshBatch.h)
+    getBVH ...... triangle hierarchy for hit tests and raycasts (see MeshBVH.h)
+    buildLODs ... simplified copies for drawing at a distance (see MeshSimplify.h)
+
+	Drawing lives in Renderer.h so that the mesh can be loaded without OpenGL.
 
 	Phillip Napieralski
 	November 26, 2008
@@ -24,39 +29,32 @@
 
 #include <iostream>
 #include <fstream>
+#include <sstream>
 #include <cmath>
 #include <cassert>
+#include <cstdio>
+#include <cstddef>
 #include <string>
+#include <vector>
+#include <algorithm>
 using namespace std;
 
-#include "Vector3.h"
-
-/*                                                           ________________
-**__________________________________________________________/ VertexID Class \__
-*/
+#include "VecMath.h"
+#include "Profiler.h"
+#include "Counters.h"
+#include "MeshFile.h"
+#include "MeshBatch.h"
+#include "MeshBVH.h"
+#include "MeshSimplify.h"
 
-class VertexID
-{
-public:
-   int vertIndex; // index of this vert in the vertex list
-   int normIndex; // index of this vertex's normal
-};
+/* Mesh loading, see Counters.h */
+Counter countMeshesParsed( "meshes parsed" );
+Counter countMeshesMapped( "meshes mapped" );
+Counter countMeshBytes( "mesh bytes read" );
 
-/*                                                               ____________
-**______________________________________________________________/ Face Class \__
-*/
-
-class Face
-{
-public: 
-   int      nVerts;     // number of vertices in this face
-   VertexID *vert;      // the list of vertex and normal indices
-   float    color[3];   // RGB face color
-
-   Face(){ nVerts = 0; vert = NULL; }    // constructor
-
-	~Face(){ delete[] vert; nVerts = 0; } // destructor
-};
+#define LOD_MAX_LEVELS   4      /* simplified levels below the full mesh */
+#define LOD_MAX_ERROR    0.5f   /* no level may stray further than this, as a fraction of the bounding radius */
+#define LOD_PIXEL_ERROR  1.0f   /* a level is drawn once its error covers no more than this many pixels */
 
 /*                                                                ___________
 **_______________________________________________________________/ Mesh class\__
@@ -67,142 +65,520 @@ class Mesh {
 };
 
 
+/* A VNCMesh is always one .vncb image (MeshFile.h): either a mapped file used
+   in place, or the same bytes built in memory from .3vnc text. Faces are
+   stored flat, face f's corners are faceStart[f] .. faceStart[f+1]-1 in
+   vertIndex/normIndex. */
 class VNCMesh {
 private:
    int numVerts;	// number of vertices in the mesh
-   Point3  *pt;	    // array of 3D vertices
-
    int numNormals;  // number of normal vectors for the mesh
-   Vector3 *norm;   // array of normals 
-
    int numFaces; 	  // number of faces in the mesh
-   Face *face;	     // array of face data
+   int numCorners;  // total vertices over all faces
+
+   const char *image;   // the whole .vncb image, everything below points into it
+   char *owned;         // image built from text (NULL when mapped)
+   MappedFile mapping;  // image mapped from a .vncb file
 
-   Vector3 offset;
+   const float    *pos;        // numVerts xyz triples
+   const float    *norm;       // numNormals xyz triples
+   const uint32_t *faceStart;  // numFaces + 1 corner offsets
+   const uint32_t *vertIndex;  // numCorners vertex indices
+   const uint32_t *normIndex;  // numCorners normal indices
+   const float    *faceColor;  // numFaces RGB triples
+
+   Vec3 offset;
+
+   MeshBatch batch;   // built on first use, offset included
+   bool batchValid;
+
+   MeshBVH bvh;       // likewise
+   bool bvhValid;
+
+   vector<MeshBatch> lods;  // level 1 and up, see buildLODs()
+   vector<float> lodError;  // how far each level strays from the mesh
+
+   // Worked out once when the mesh is attached, without the offset
+   Vec3 centroid, boxMin, boxMax, sphereCenter;
+   float sphereRadius;
+   void computeBounds();
+
+   VNCMesh( const VNCMesh& );
+   VNCMesh& operator=( const VNCMesh& );
+
+   void attach( const char *img );
+   void release();
+   bool restamp( const string& fname, uint64_t size, int64_t time );
 
 public:
    VNCMesh(); 	// constructor
    ~VNCMesh(); // destructor
 
-   void read(const string& fname);  // reads data for this mesh from a file
-   void draw(bool filled = false);  // draws this mesh
-   void setOffset( Vector3 off ){ offset = off; }
-   void applyOffset()
+   bool read(const string& fname);  // reads data for this mesh from a file
+   bool readBinary(const string& fname, bool verifyChecksum = true);
+   bool writeBinary(const string& fname);
+   bool load(const string& fname);
+
+   /* Where load() keeps the compiled copy of a .3vnc file */
+   static string binaryPath(const string& fname);
+
+   /* Shifts every vertex by off (applied on access, the image is read-only) */
+   void setOffset( Vec3 off ){ offset = off; batchValid = bvhValid = false; lods.clear(); lodError.clear(); }
+   Vec3 getOffset(){ return offset; }
+
+   bool isMapped(){ return mapping.isOpen(); }
+
+   /* Triangulated, interleaved copy of the mesh for the renderer */
+   const MeshBatch& getBatch();
+
+   /* Triangles of the mesh in a hierarchy, offset included */
+   const MeshBVH& getBVH();
+
+   /* Simplifies the mesh into up to maxLevels coarser batches, each with
+      about half the triangles of the one before, for as long as the error
+      stays under LOD_MAX_ERROR. Call after setOffset(). Returns the number
+      of levels made. */
+   int buildLODs( int maxLevels = LOD_MAX_LEVELS );
+
+   /* Level 0 is the full mesh (getBatch()) */
+   int getNumLODs(){ return 1 + (int)lods.size(); }
+   const MeshBatch& getLOD( int level ){ return level <= 0 ? getBatch() : lods[min(level, (int)lods.size()) - 1]; }
+
+   /* Furthest any point of the level sits from the full mesh, in mesh units */
+   float getLODError( int level ){ return level <= 0 ? 0.0f : lodError[min(level, (int)lodError.size()) - 1]; }
+
+   /* Box and sphere around every vertex, offset included */
+   Vec3 getBoxMin(){ return Vec3( boxMin.x + offset.x, boxMin.y + offset.y, boxMin.z + offset.z ); }
+   Vec3 getBoxMax(){ return Vec3( boxMax.x + offset.x, boxMax.y + offset.y, boxMax.z + offset.z ); }
+   Vec3 getSphereCenter(){ return Vec3( sphereCenter.x + offset.x, sphereCenter.y + offset.y, sphereCenter.z + offset.z ); }
+   float getSphereRadius(){ return sphereRadius; }
+
+   /* Average of the vertices. Preconditions: read() */
+   Vec3 getCenter(){ return Vec3( centroid.x + offset.x, centroid.y + offset.y, centroid.z + offset.z ); }
+
+   int getNumVerts(){ return numVerts; }
+   int getNumNormals(){ return numNormals; }
+   int getNumFaces(){ return numFaces; }
+   int getNumCorners(){ return numCorners; }
+
+   Vec3 getVertex( int i )
    {
-	   for( int i = 0; i < numVerts; i++ )
-		   pt[i].set( pt[i].x+offset.x, pt[i].y+offset.y, pt[i].z+offset.z );
+      return Vec3( pos[3*i] + offset.x, pos[3*i+1] + offset.y, pos[3*i+2] + offset.z );
    }
-
-   /* Preconditions: read() */
-   Point3 getCenter();
-};	
+   Vec3 getNormal( int i ){ return Vec3( norm[3*i], norm[3*i+1], norm[3*i+2] ); }
+
+   int getFaceSize( int f ){ return faceStart[f+1] - faceStart[f]; }
+   int getFaceVertIndex( int f, int k ){ return vertIndex[faceStart[f] + k]; }
+   int getFaceNormIndex( int f, int k ){ return normIndex[faceStart[f] + k]; }
+   const float *getFaceColor( int f ){ return faceColor + 3*f; }
+
+   /* Raw arrays, positions are without the offset */
+   const float *getPositions(){ return pos; }
+   const float *getNormals(){ return norm; }
+   const uint32_t *getFaceStarts(){ return faceStart; }
+   const uint32_t *getVertIndices(){ return vertIndex; }
+   const uint32_t *getNormIndices(){ return normIndex; }
+   const float *getFaceColors(){ return faceColor; }
+};
 
 VNCMesh::VNCMesh()
 { // Construct an empty mesh.
-   numVerts = numFaces = numNormals = 0; 
-   pt = NULL;  norm =NULL;  face = NULL;
-   offset = Vector3(0,0,0);
+   image = NULL; owned = NULL;
+   batchValid = bvhValid = false;
+   release();
+   offset = Vec3(0,0,0);
 }
 
 VNCMesh::~VNCMesh()
 { // Free up memory used by this VNCMesh.
-   delete [] pt;    
-   delete [] norm;  
-   for(int f = 0; f < numFaces; f++)
-	   face[f].~Face();
-      //delete[] face[f].vert; 
+   release();
 }
 
-void VNCMesh::read(const string& fname)
+void VNCMesh::release()
 {
-   fstream inStream;
+   delete [] owned;
+   owned = NULL;
+   mapping.close();
+   image = NULL;
+   numVerts = numFaces = numNormals = numCorners = 0;
+   pos = norm = faceColor = NULL;
+   faceStart = vertIndex = normIndex = NULL;
+   batch.clear();
+   bvh.clear();
+   lods.clear();
+   lodError.clear();
+   batchValid = bvhValid = false;
+   computeBounds();
+}
 
-   inStream.open(fname.c_str(), ios::in);
-	if(inStream.fail() || inStream.eof()) 
-	{
-      std::cerr << "Can't open file or file is empty: " << fname << endl; 
+void VNCMesh::attach( const char *img )
+{
+   // The sections are found from the counts, never from offsets in the file
+   const MeshFileHeader *h = (const MeshFileHeader *)img;
+   MeshFileHeader layout;
+   meshLayout(layout, h->numVerts, h->numNormals, h->numFaces, h->numCorners);
+   image = img;
+   numVerts = layout.numVerts;
+   numNormals = layout.numNormals;
+   numFaces = layout.numFaces;
+   numCorners = layout.numCorners;
+   pos = (const float *)(img + layout.positionOffset);
+   norm = (const float *)(img + layout.normalOffset);
+   faceStart = (const uint32_t *)(img + layout.faceStartOffset);
+   vertIndex = (const uint32_t *)(img + layout.vertIndexOffset);
+   normIndex = (const uint32_t *)(img + layout.normIndexOffset);
+   faceColor = (const float *)(img + layout.faceColorOffset);
+   computeBounds();
+}
+
+void VNCMesh::computeBounds()
+{
+   centroid = boxMin = boxMax = sphereCenter = Vec3(0,0,0);
+   sphereRadius = 0;
+   if(numVerts == 0)
       return;
+
+   double sum[3] = { 0, 0, 0 };
+   float lo[3] = { pos[0], pos[1], pos[2] }, hi[3] = { pos[0], pos[1], pos[2] };
+   for(int i = 0; i < numVerts; i++)
+      for(int k = 0; k < 3; k++)
+      {
+         float v = pos[3*i+k];
+         sum[k] += v;
+         lo[k] = min(lo[k], v);
+         hi[k] = max(hi[k], v);
+      }
+   centroid = Vec3(sum[0] / numVerts, sum[1] / numVerts, sum[2] / numVerts);
+   boxMin = Vec3(lo[0], lo[1], lo[2]);
+   boxMax = Vec3(hi[0], hi[1], hi[2]);
+
+   // Centered on the box, which is never far from the smallest sphere
+   sphereCenter = Vec3((lo[0] + hi[0]) / 2, (lo[1] + hi[1]) / 2, (lo[2] + hi[2]) / 2);
+   double r2 = 0;
+   for(int i = 0; i < numVerts; i++)
+   {
+      double dx = pos[3*i] - sphereCenter.x, dy = pos[3*i+1] - sphereCenter.y, dz = pos[3*i+2] - sphereCenter.z;
+      r2 = max(r2, dx*dx + dy*dy + dz*dz);
+   }
+   sphereRadius = (float)sqrt(r2);
+}
+
+bool VNCMesh::read(const string& fname)
+{
+   PROFILE_SCOPE("VNCMesh::read");
+   ifstream file(fname.c_str(), ios::in | ios::binary);
+	if(file.fail() || file.peek() == EOF)
+	{
+      std::cerr << "Can't open file or file is empty: " << fname << endl;
+      return false;
 	}
 
-   inStream >> numVerts >> numNormals >> numFaces;
+   /* Keep the raw text around so the cache can tell if it ever changes */
+   ostringstream raw;
+   raw << file.rdbuf();
+   string text = raw.str();
+   istringstream inStream(text);
+
+   int nv = 0, nn = 0, nf = 0;
+   inStream >> nv >> nn >> nf;
    inStream.ignore(256, '\n');
 
-	// Make arrays for vertices, normals, and faces
-   pt = new Point3[numVerts];        assert(pt != NULL);
-   norm = new Vector3[numNormals];   assert(norm != NULL);
-   face = new Face[numFaces];        assert(face != NULL);
+   vector<float> pts(nv * 3), nrms(nn * 3), colors(nf * 3);
+   vector<uint32_t> starts(nf + 1), verts, normals;
 
    // Read the vertices.
-   for(int i = 0; i < numVerts; i++)
+   for(int i = 0; i < nv; i++)
    {
-		inStream >> pt[i].x >> pt[i].y >> pt[i].z;
+		inStream >> pts[3*i] >> pts[3*i+1] >> pts[3*i+2];
       inStream.ignore(256, '\n');
    }
 
    // Read the normals.
-	for(int i = 0; i < numNormals; i++) 
+	for(int i = 0; i < nn; i++)
    {
-		inStream >> norm[i].x >> norm[i].y >> norm[i].z;
+		inStream >> nrms[3*i] >> nrms[3*i+1] >> nrms[3*i+2];
       inStream.ignore(256, '\n');
    }
 
    // Read face data.
-   for(int f = 0; f < numFaces; f++)       
-   {  
-      inStream >> face[f].nVerts;
+   for(int f = 0; f < nf; f++)
+   {
+      int n = 0;
+      inStream >> n;
       inStream.ignore(256, '\n');
-      int n = face[f].nVerts;
-      face[f].vert = new VertexID[n]; 
-      assert(face[f].vert != NULL);
+      starts[f] = (uint32_t)verts.size();
       // Read vertex indices for this face.
-		for(int k = 0; k < n; k++)  
-			inStream >> face[f].vert[k].vertIndex;
+		for(int k = 0; k < n; k++)
+      {
+         uint32_t iv = 0;
+			inStream >> iv;
+         verts.push_back(iv);
+      }
       inStream.ignore(256, '\n');
       // Read normal indices for this face.
-		for(int kk = 0; kk < n; kk++) 
-			inStream >> face[f].vert[kk].normIndex;
+		for(int kk = 0; kk < n; kk++)
+      {
+         uint32_t in = 0;
+			inStream >> in;
+         normals.push_back(in);
+      }
       inStream.ignore(256, '\n');
       // Read RGB color for this face
-		for(int j = 0; j < 3; j++) 
-		  	inStream >> face[f].color[j];
+		for(int j = 0; j < 3; j++)
+		  	inStream >> colors[3*f+j];
       inStream.ignore(256, '\n');
 	}
+   starts[nf] = (uint32_t)verts.size();
 
-	inStream.close();
-} 
+   if(inStream.fail())
+   {
+      std::cerr << "Mesh file is truncated or malformed: " << fname << endl;
+      return false;
+   }
 
-void VNCMesh::draw(bool filled) 
-{          
-   for(int f = 0; f < numFaces; f++) 
-	{  // Draw each face.
-      if (filled) glColor3fv(face[f].color);
-      glBegin(filled ? GL_POLYGON : GL_LINE_LOOP);
-         for(int v = 0; v < face[f].nVerts; v++) 
-         {
-            int in = face[f].vert[v].normIndex ;
-            int iv =  face[f].vert[v].vertIndex ;
-            glNormal3f(norm[in].x, norm[in].y, norm[in].z);
-            glVertex3f(pt[iv].x, pt[iv].y, pt[iv].z);
-         }
-      glEnd();
+   // Lay it all out as a .vncb image in one block
+   MeshFileHeader h;
+   meshLayout(h, nv, nn, nf, (uint32_t)verts.size());
+   char *img = new char[h.fileSize];
+   memset(img, 0, h.fileSize);
+   if(nv) memcpy(img + h.positionOffset, &pts[0], pts.size() * sizeof(float));
+   if(nn) memcpy(img + h.normalOffset, &nrms[0], nrms.size() * sizeof(float));
+   memcpy(img + h.faceStartOffset, &starts[0], starts.size() * sizeof(uint32_t));
+   if(!verts.empty())
+   {
+      memcpy(img + h.vertIndexOffset, &verts[0], verts.size() * sizeof(uint32_t));
+      memcpy(img + h.normIndexOffset, &normals[0], normals.size() * sizeof(uint32_t));
+   }
+   if(nf) memcpy(img + h.faceColorOffset, &colors[0], colors.size() * sizeof(float));
+   fileStamp(fname, h.sourceSize, h.sourceTime);
+   h.sourceHash = meshChecksum(text.data(), text.size());
+   memcpy(img, &h, sizeof(h));
+   h.checksum = meshImageChecksum(img);
+   memcpy(img, &h, sizeof(h));
+
+   // The text is held to the same rules as a .vncb, indices in range included
+   if(!meshImageValid(img, h.fileSize, false))
+   {
+      std::cerr << "Mesh file has faces that don't fit its vertices: " << fname << endl;
+      delete [] img;
+      return false;
    }
+
+   release();
+   owned = img;
+   attach(owned);
+   countMeshesParsed.add();
+   countMeshBytes.add(text.size());
+   return true;
 }
 
-Point3 VNCMesh::getCenter()
+bool VNCMesh::readBinary(const string& fname, bool verifyChecksum)
 {
-	Point3 center(0,0,0);
+   PROFILE_SCOPE("VNCMesh::readBinary");
+   release();
+   if(!mapping.open(fname))
+      return false;
 
-	for( int i = 0; i < numVerts; i++ )
-	{
-		center.x += pt[i].x;
-		center.y += pt[i].y;
-		center.z += pt[i].z;
-	}
-	center.x /= numVerts;
-	center.y /= numVerts;
-	center.z /= numVerts;
+   if(!meshImageValid(mapping.data(), mapping.size(), verifyChecksum))
+   {
+      std::cerr << "Ignoring bad or out of date mesh file: " << fname << endl;
+      release();
+      return false;
+   }
+
+   attach(mapping.data());
+   countMeshesMapped.add();
+   countMeshBytes.add(mapping.size());
+   return true;
+}
+
+bool VNCMesh::writeBinary(const string& fname)
+{
+   if(!image)
+      return false;
+
+   /* Write next to it and swap in, so a reader never sees half a file */
+   string tmp = fname + ".tmp";
+   ofstream out(tmp.c_str(), ios::out | ios::binary | ios::trunc);
+   if(out.fail())
+      return false;
+   out.write(image, ((const MeshFileHeader *)image)->fileSize);
+   out.close();
+   if(out.fail())
+   {
+      remove(tmp.c_str());
+      return false;
+   }
+
+   remove(fname.c_str());
+   return rename(tmp.c_str(), fname.c_str()) == 0;
+}
+
+/* Records a new source timestamp in an existing .vncb without touching the data */
+bool VNCMesh::restamp(const string& fname, uint64_t size, int64_t time)
+{
+   fstream out(fname.c_str(), ios::in | ios::out | ios::binary);
+   if(out.fail())
+      return false;
+   out.seekp(offsetof(MeshFileHeader, sourceSize));
+   out.write((const char *)&size, sizeof(size));
+   out.write((const char *)&time, sizeof(time));
+   return !out.fail();
+}
+
+string VNCMesh::binaryPath(const string& fname)
+{
+   size_t dot = fname.find_last_of('.');
+   size_t slash = fname.find_last_of("/\\");
+   if(dot == string::npos || (slash != string::npos && dot < slash))
+      return fname + ".vncb";
+   return fname.substr(0, dot) + ".vncb";
+}
+
+bool VNCMesh::load(const string& fname)
+{
+   string bin = binaryPath(fname);
+   uint64_t size = 0;
+   int64_t time = 0;
+   bool haveSource = fileStamp(fname, size, time);
+
+   if(readBinary(bin))
+   {
+      const MeshFileHeader *h = (const MeshFileHeader *)image;
+
+      /* A shipped .vncb with no text next to it is used as is */
+      if(!haveSource || (h->sourceSize == size && h->sourceTime == time))
+         return true;
+
+      /* The text was touched, only rebuild if its contents really changed */
+      ifstream file(fname.c_str(), ios::in | ios::binary);
+      ostringstream raw;
+      raw << file.rdbuf();
+      string text = raw.str();
+      if(meshChecksum(text.data(), text.size()) == h->sourceHash)
+      {
+         uint32_t hash = h->sourceHash;
+         release();
+         restamp(bin, size, time);
+         return readBinary(bin) && ((const MeshFileHeader *)image)->sourceHash == hash;
+      }
+      release();
+   }
+
+   if(!read(fname))
+      return false;
 
-	return center;
+   if(!writeBinary(bin))
+      std::cerr << "Couldn't write mesh cache " << bin << ", using the text mesh" << endl;
+   return true;
+}
+
+const MeshBatch& VNCMesh::getBatch()
+{
+   if(batchValid)
+      return batch;
+
+   batch.clear();
+   batch.indices.reserve(3 * (numCorners - 2 * numFaces > 0 ? numCorners - 2 * numFaces : 0));
+   vector<uint32_t> corner;
+   for(int f = 0; f < numFaces; f++)
+   {
+      // Every corner of the face, shared with earlier faces where possible
+      corner.clear();
+      for(uint32_t c = faceStart[f]; c < faceStart[f+1]; c++)
+      {
+         const float *v = pos + 3*vertIndex[c];
+         float p[3] = { v[0] + (float)offset.x, v[1] + (float)offset.y, v[2] + (float)offset.z };
+         corner.push_back(batch.addCorner(p, norm + 3*normIndex[c], vertIndex[c], normIndex[c], faceColor + 3*f));
+      }
+
+      // Faces are convex polygons, so a fan from the first corner covers them
+      for(size_t k = 1; k + 1 < corner.size(); k++)
+      {
+         batch.indices.push_back(corner[0]);
+         batch.indices.push_back(corner[k]);
+         batch.indices.push_back(corner[k+1]);
+      }
+   }
+   batch.finish();
+   batchValid = true;
+   return batch;
+}
+
+int VNCMesh::buildLODs( int maxLevels )
+{
+   lods.clear();
+   lodError.clear();
+   if(numFaces == 0)
+      return 0;
+
+   // Welded triangles: corners refer to the shared vertex list, offset applied
+   vector<float> p(numVerts * 3);
+   for(int i = 0; i < numVerts; i++)
+   {
+      p[3*i] = pos[3*i] + (float)offset.x;
+      p[3*i+1] = pos[3*i+1] + (float)offset.y;
+      p[3*i+2] = pos[3*i+2] + (float)offset.z;
+   }
+   vector<uint32_t> tri;
+   vector<float> color;
+   for(int f = 0; f < numFaces; f++)
+      for(uint32_t c = faceStart[f] + 1; c + 1 < faceStart[f+1]; c++)
+      {
+         tri.push_back(vertIndex[faceStart[f]]);
+         tri.push_back(vertIndex[c]);
+         tri.push_back(vertIndex[c+1]);
+         color.insert(color.end(), faceColor + 3*f, faceColor + 3*f + 3);
+      }
+
+   MeshSimplifier simplifier;
+   simplifier.setMesh(&p[0], numVerts, tri, color);
+
+   int count = simplifier.getNumTriangles();
+   for(int level = 1; level <= maxLevels; level++)
+   {
+      int left = simplifier.simplify(count / 2, LOD_MAX_ERROR * sphereRadius);
+
+      // Not worth a level unless it saves a good share of what is left
+      if(left > count * 0.8 || left < 4)
+         break;
+      count = left;
+
+      lods.push_back(MeshBatch());
+      simplifier.writeBatch(lods.back());
+      lodError.push_back(MeshSimplifier::batchDistance(getBatch(), lods.back()));
+   }
+   return (int)lods.size();
+}
+
+const MeshBVH& VNCMesh::getBVH()
+{
+   if(bvhValid)
+      return bvh;
+
+   bvh.clear();
+   float off[3] = { (float)offset.x, (float)offset.y, (float)offset.z };
+   for(int f = 0; f < numFaces; f++)
+   {
+      // Same fan as getBatch(), so both see the same triangles
+      if(faceStart[f+1] - faceStart[f] < 3)
+         continue;
+      float tri[3][3];
+      for(int k = 0; k < 3; k++)
+         tri[0][k] = pos[3*vertIndex[faceStart[f]] + k] + off[k];
+      for(uint32_t c = faceStart[f] + 1; c + 1 < faceStart[f+1]; c++)
+      {
+         for(int k = 0; k < 3; k++)
+         {
+            tri[1][k] = pos[3*vertIndex[c] + k] + off[k];
+            tri[2][k] = pos[3*vertIndex[c+1] + k] + off[k];
+         }
+         bvh.addTriangle(tri[0], tri[1], tri[2], f);
+      }
+   }
+   bvh.build();
+   bvhValid = true;
+   return bvh;
 }
 
 #endif